@@ -0,0 +1,84 @@
+/*
+ * Benchmark of the logging thread's cost in async_logger.h.
+ *
+ * Each measurement logs short bursts of records into a warm ring, starting
+ * just after the background thread has drained it and gone to sleep, so the
+ * time covers only the logging thread and not formatting or writing. Output
+ * goes to /dev/null. The median nanoseconds per call over many bursts is
+ * reported, alongside the cost of reading the clocks a record could be
+ * timestamped with.
+ *
+ * Usage: BenchAsyncLogger [ring_bytes]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "async_logger.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+template <typename F>
+static double bench(async_logger& logger, int calls, F f) {
+    const int BURSTS = 200;
+    std::vector<double> samples(BURSTS);
+    for (int burst = 0; burst < BURSTS; burst++) {
+        logger.flush();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        const bench_clock::time_point start = bench_clock::now();
+        for (int i = 0; i < calls; i++) {
+            f(i);
+        }
+        samples[burst] = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / calls;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[BURSTS / 2];
+}
+
+int main(int argc, char** argv) {
+    const std::size_t ring_bytes = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 1 << 16;
+    // Half a ring of the largest records below, so no burst is dropped.
+    const int calls = static_cast<int>(ring_bytes / 2 / 64);
+    const int fd = open("/dev/null", O_WRONLY);
+    if (fd < 0) {
+        std::perror("open");
+        return 1;
+    }
+    std::int64_t sink = 0;
+    {
+        async_logger logger(fd, ring_bytes, overflow_policy::drop, std::chrono::milliseconds(5));
+        const std::string text = "a short string";
+        std::printf("%zu byte ring, %d calls per burst\n", ring_bytes, calls);
+        std::printf("%-24s %6.1f ns\n", "no arguments", bench(logger, calls, [&](int) {
+            logger.log("hello");
+        }));
+        std::printf("%-24s %6.1f ns\n", "int, double", bench(logger, calls, [&](int i) {
+            logger.log("value %d %f", i, 1.5);
+        }));
+        std::printf("%-24s %6.1f ns\n", "four ints", bench(logger, calls, [&](int i) {
+            logger.log("%d %d %d %d", i, i + 1, i + 2, i + 3);
+        }));
+        std::printf("%-24s %6.1f ns\n", "int, std::string", bench(logger, calls, [&](int i) {
+            logger.log("%d %s", i, text);
+        }));
+        std::printf("%-24s %6.1f ns\n", "system_clock::now()", bench(logger, calls, [&](int) {
+            sink += std::chrono::system_clock::now().time_since_epoch().count();
+        }));
+#if defined(__x86_64__) || defined(__i386__)
+        std::printf("%-24s %6.1f ns\n", "__rdtsc()", bench(logger, calls, [&](int) {
+            sink += static_cast<std::int64_t>(__rdtsc());
+        }));
+#endif
+        if (logger.dropped() != 0) {
+            std::printf("warning: %zu records dropped\n", logger.dropped());
+        }
+    }
+    close(fd);
+    return sink == 42 ? 2 : 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Benchmark of the wait strategies in wait_strategy.h, showing the trade-off
+ * each makes between latency and CPU use.
+ *
+ * For each strategy it measures:
+ *  - latency: round trips of a message between two threads over a pair of
+ *    spsc_queues, with both threads waiting using the strategy.
+ *  - idle CPU: the CPU time used by a consumer waiting for messages which
+ *    arrive every 200us, as a percentage of the elapsed time.
+ *
+ * Usage: BenchWaitStrategy [round_trips]
+ * Run with at least two free cores; busy_spin in particular degrades badly
+ * when the two threads share one.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include "spsc_queue.h"
+#include "wait_strategy.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static double thread_cpu_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+template <typename WAIT>
+static void bench(const char* name, int round_trips) {
+    // Latency: the echo thread returns every message it receives.
+    spsc_queue<int, 64, WAIT> ping;
+    spsc_queue<int, 64, WAIT> pong;
+    std::thread echo([&]() {
+        for (int i = 0; i < round_trips; i++) {
+            pong.push(ping.pop());
+        }
+    });
+    std::vector<double> samples(round_trips);
+    for (int i = 0; i < round_trips; i++) {
+        const bench_clock::time_point start = bench_clock::now();
+        ping.push(i);
+        pong.pop();
+        samples[i] = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+    }
+    echo.join();
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double s : samples) {
+        total += s;
+    }
+
+    // Idle CPU: the consumer spends most of its time waiting.
+    const int MESSAGES = 2000;
+    spsc_queue<int, 64, WAIT> queue;
+    double consumer_cpu = 0;
+    std::thread consumer([&]() {
+        const double start = thread_cpu_seconds();
+        for (int i = 0; i < MESSAGES; i++) {
+            queue.pop();
+        }
+        consumer_cpu = thread_cpu_seconds() - start;
+    });
+    const bench_clock::time_point start = bench_clock::now();
+    for (int i = 0; i < MESSAGES; i++) {
+        std::this_thread::sleep_until(start + std::chrono::microseconds(200 * (i + 1)));
+        queue.push(i);
+    }
+    consumer.join();
+    const double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    std::printf("%-22s %12.0f %12.0f %12.0f %11.1f%%\n", name, total / round_trips,
+                samples[round_trips / 2], samples[round_trips * 99 / 100],
+                100.0 * consumer_cpu / elapsed);
+}
+
+int main(int argc, char** argv) {
+    const int round_trips = argc > 1 ? std::max(1, std::atoi(argv[1])) : 100000;
+    std::printf("%-22s %12s %12s %12s %12s\n", "strategy", "mean rtt ns", "p50 rtt ns",
+                "p99 rtt ns", "idle cpu");
+    bench<busy_spin>("busy_spin", round_trips);
+    bench<spin_then_yield<0>>("spin_then_yield<0>", round_trips);
+    bench<spin_then_yield<>>("spin_then_yield<>", round_trips);
+    bench<futex_park<0>>("futex_park<0>", round_trips);
+    bench<futex_park<>>("futex_park<>", round_trips);
+    bench<futex_park<16384>>("futex_park<16384>", round_trips);
+    return 0;
+}
@@ -0,0 +1,306 @@
+/**
+ * \file   FrozenSet.h
+ * \author Jonathan Simmonds
+ * \brief  Read-only set with a cache-friendly layout for fast lookups.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_FROZENSET_H
+#define _COMMON_FROZENSET_H
+
+#include <algorithm>    // sort, unique, min
+#include <cstdint>      // uintptr_t
+#include <functional>   // less
+#include <type_traits>  // is_nothrow_move_constructible, is_nothrow_move_assignable
+#include <utility>      // move
+#include <vector>       // vector
+
+#include "SimpleSet.h"
+
+
+/**
+ * \brief   Read-only ordered set laid out for fast lookups in large data.
+ *
+ * The elements are stored in Eytzinger (breadth-first binary tree) order
+ * rather than sorted order. A lookup walks down the implicit tree touching
+ * elements which are close together in memory near the root, and prefetches
+ * the cache line holding the descendants several levels below the current
+ * node, hiding most of the memory latency binary search over a sorted array
+ * incurs at each level. The descent itself is branch-free.
+ * Lookups are O(log n). The set cannot be modified once built.
+ *
+ * \param T     The type stored in this set. Must be default constructible and
+ *              copyable.
+ * \param Compare   The strict weak ordering used to order the elements.
+ */
+template <class T, class Compare = std::less<T>>
+class FrozenSet
+{
+private:
+    /** The size of a cache line in bytes. */
+    static const size_t CACHE_LINE = 64;
+
+    /** The number of elements in a cache line. Since the 2^d descendants
+     *  d levels below node k are contiguous (starting at k * 2^d), prefetching
+     *  this far ahead fetches a whole cache line of future nodes at once. */
+    static const size_t BLOCK =
+            sizeof(T) >= CACHE_LINE ? 1 : CACHE_LINE / sizeof(T);
+
+    /** The backing storage, over-allocated so the tree can be aligned. */
+    std::vector<T> storage;
+
+    /** The tree, 1-indexed (tree[0] is unused) and pointing into storage. */
+    T* tree;
+
+    /** The number of elements in the set. */
+    size_t count;
+
+    /** The ordering of the elements. */
+    Compare comp;
+
+public:
+    /**
+     * \brief   FrozenSet Constructor, building the set from a range of
+     *          (possibly repeated) elements.
+     * \param   first   Iterator to the first element of the input range.
+     * \param   last    Iterator to past the end of the input range.
+     * \param   comp    The ordering of the elements.
+     */
+    template <class InputIt>
+    FrozenSet(InputIt first, InputIt last, const Compare& comp = Compare())
+            : storage(), tree(nullptr), count(0), comp(comp)
+    {
+        std::vector<T> sorted(first, last);
+        build(sorted);
+    }
+
+    /**
+     * \brief   FrozenSet Constructor, freezing the contents of a SimpleSet.
+     * \param   set     The set to copy the elements from.
+     * \param   comp    The ordering of the elements.
+     */
+    template <class Allocator>
+    explicit FrozenSet(const SimpleSet<T, Allocator>& set,
+                       const Compare& comp = Compare())
+            : storage(), tree(nullptr), count(0), comp(comp)
+    {
+        std::vector<T> sorted(set.begin(), set.end());
+        build(sorted);
+    }
+
+    /**
+     * \brief   FrozenSet copy constructor.
+     * \param   other   The set to copy.
+     */
+    FrozenSet(const FrozenSet& other)
+            : storage(other.storage), tree(other.rebased_tree(storage)),
+              count(other.count), comp(other.comp)
+    {
+    }
+
+    /**
+     * \brief   FrozenSet move constructor. Moving the storage keeps its
+     *          address, so the tree pointer remains valid. The moved-from set
+     *          is left empty.
+     * \param   other   The set to move from.
+     */
+    FrozenSet(FrozenSet&& other)
+            noexcept(std::is_nothrow_move_constructible<Compare>::value)
+            : storage(std::move(other.storage)), tree(other.tree),
+              count(other.count), comp(std::move(other.comp))
+    {
+        other.tree = nullptr;
+        other.count = 0;
+    }
+
+    /**
+     * \brief   FrozenSet copy assignment.
+     * \param   other   The set to copy.
+     * \return  This set.
+     */
+    FrozenSet& operator=(const FrozenSet& other)
+    {
+        if (this != &other)
+        {
+            storage = other.storage;
+            tree = other.rebased_tree(storage);
+            count = other.count;
+            comp = other.comp;
+        }
+        return *this;
+    }
+
+    /**
+     * \brief   FrozenSet move assignment. The moved-from set is left empty.
+     * \param   other   The set to move from.
+     * \return  This set.
+     */
+    FrozenSet& operator=(FrozenSet&& other)
+            noexcept(std::is_nothrow_move_assignable<Compare>::value)
+    {
+        if (this != &other)
+        {
+            storage = std::move(other.storage);
+            tree = other.tree;
+            count = other.count;
+            comp = std::move(other.comp);
+            other.tree = nullptr;
+            other.count = 0;
+        }
+        return *this;
+    }
+
+    /**
+     * \brief   FrozenSet Destructor.
+     */
+    virtual ~FrozenSet(void) {}
+
+    /**
+     * \brief   Queries whether the set contains the given element.
+     * \param   elem    The element to check for (equivalence is determined
+     *                  with Compare).
+     * \return  true if the element is in the set, false otherwise.
+     */
+    inline bool contains(const T& elem) const noexcept
+    {
+        size_t k = lower_bound_index(elem);
+        return k != 0 && !comp(elem, tree[k]);
+    }
+
+    /**
+     * \brief   Queries whether the set is empty (i.e. size 0).
+     * \return  true if empty, false otherwise.
+     */
+    inline bool empty(void) const noexcept
+    {
+        return count == 0;
+    }
+
+    /**
+     * \brief   Determines the set size.
+     * \return  Number of elements in the set.
+     */
+    inline size_t size(void) const noexcept
+    {
+        return count;
+    }
+
+private:
+    /**
+     * \brief   Finds where this set's tree would be in a copy of its storage.
+     * \param   copy    The copy of the storage.
+     * \return  The tree pointer for the copy, or nullptr if this set has no
+     *          tree (having been moved from).
+     */
+    T* rebased_tree(std::vector<T>& copy) const noexcept
+    {
+        return tree == nullptr ? nullptr : copy.data() + (tree - storage.data());
+    }
+
+    /**
+     * \brief   Finds the tree index of the first element not less than the
+     *          given element.
+     * \param   elem    The element to search for.
+     * \return  The 1-based tree index, or 0 if every element is less than
+     *          elem.
+     */
+    inline size_t lower_bound_index(const T& elem) const noexcept
+    {
+        size_t k = 1;
+        while (k <= count)
+        {
+#if defined(__GNUC__)
+            __builtin_prefetch(tree + std::min(k * BLOCK, count));
+#endif
+            k = 2 * k + static_cast<size_t>(comp(tree[k], elem));
+        }
+        // k has descended past a leaf. The answer is the last node at which
+        // the search went left, found by stripping the trailing right turns
+        // (1 bits) and the final left turn (0 bit).
+        return k >> (count_trailing_ones(k) + 1);
+    }
+
+    /**
+     * \brief   Counts the number of trailing 1 bits in x.
+     * \param   x   The value to count the bits of.
+     * \return  The number of trailing 1 bits.
+     */
+    static inline unsigned count_trailing_ones(size_t x) noexcept
+    {
+#if defined(__GNUC__)
+        return static_cast<unsigned>(__builtin_ctzll(~static_cast<unsigned long long>(x)));
+#else
+        unsigned n = 0;
+        for (; x & 1; x >>= 1)
+            n++;
+        return n;
+#endif
+    }
+
+    /**
+     * \brief   Populates the tree from a vector of elements.
+     * \param   sorted  The elements, which will be sorted and deduplicated in
+     *                  place.
+     */
+    void build(std::vector<T>& sorted)
+    {
+        std::sort(sorted.begin(), sorted.end(), comp);
+        sorted.erase(std::unique(sorted.begin(), sorted.end(),
+                                 [this](const T& a, const T& b) {
+                                     return !comp(a, b) && !comp(b, a);
+                                 }),
+                     sorted.end());
+        count = sorted.size();
+        // Align tree[0] to a cache line (where possible) so that each prefetch
+        // of tree[k * BLOCK] fetches exactly the line holding that block.
+        storage.resize(count + 1 + BLOCK);
+        size_t offset = 0;
+        if (CACHE_LINE % sizeof(T) == 0)
+        {
+            const uintptr_t addr = reinterpret_cast<uintptr_t>(storage.data());
+            const uintptr_t misalign = addr % CACHE_LINE;
+            offset = misalign ? (CACHE_LINE - misalign) / sizeof(T) : 0;
+        }
+        tree = storage.data() + offset;
+        size_t next = 0;
+        fill(sorted, next, 1);
+    }
+
+    /**
+     * \brief   Recursively fills the subtree rooted at index k with an
+     *          in-order traversal of the sorted elements.
+     * \param   sorted  The sorted, unique elements.
+     * \param   next    The index of the next element of sorted to place.
+     * \param   k       The subtree root.
+     */
+    void fill(const std::vector<T>& sorted, size_t& next, size_t k)
+    {
+        if (k > count)
+            return;
+        fill(sorted, next, 2 * k);
+        tree[k] = sorted[next++];
+        fill(sorted, next, 2 * k + 1);
+    }
+};
+
+#endif
@@ -0,0 +1,434 @@
+/**
+ * \file   IntegerSet.h
+ * \author Jonathan Simmonds
+ * \brief  Compact, fast unordered set of unsigned integer keys.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_INTEGERSET_H
+#define _COMMON_INTEGERSET_H
+
+#include <cstddef>      // ptrdiff_t
+#include <cstdint>      // uint64_t
+#include <iterator>     // forward_iterator_tag
+#include <limits>       // numeric_limits
+#include <type_traits>  // is_integral, is_unsigned, integral_constant
+#include <vector>       // vector
+
+#if defined(__SSE2__)
+#include <emmintrin.h>  // SSE2 intrinsics
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>  // _mm_cmpeq_epi64
+#endif
+
+
+/**
+ * \brief   Compact, fast unordered set of unsigned integer keys (e.g. 32 or
+ *          64-bit IDs).
+ *
+ * Keys are stored directly in a power-of-two sized open-addressing table,
+ * located with multiplicative (Fibonacci) hashing and linear probing. Empty
+ * slots hold a reserved sentinel (the maximum key value) rather than needing
+ * any per-slot metadata; the sentinel itself may still be stored as it is
+ * tracked separately. Where SSE2 is available (and SSE4.1 for 64-bit keys)
+ * probing compares a whole 16 byte group of slots against the key at once.
+ *
+ * Unlike SimpleSet insertion is amortised O(1), at the cost of iteration
+ * being in an unspecified order.
+ *
+ * \param T     The key type. Must be an unsigned integral type.
+ */
+template <class T>
+class IntegerSet
+{
+    static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value,
+                  "IntegerSet keys must be unsigned integers");
+
+private:
+    /** The value marking an empty slot. */
+    static const T EMPTY = std::numeric_limits<T>::max();
+
+    /** The number of slots compared at once when probing. */
+    static const size_t GROUP = 16 / sizeof(T) > 0 ? 16 / sizeof(T) : 1;
+
+    /** The minimum number of slots in the table. */
+    static const size_t MIN_CAPACITY = 16;
+
+    /** The table. Holds capacity slots followed by a copy of the first
+     *  GROUP slots so that a group may be read from any slot without
+     *  wrapping. */
+    std::vector<T> slots;
+
+    /** The number of slots in the table (excluding the copied group). Always
+     *  a power of two. */
+    size_t capacity;
+
+    /** The shift applied to the hash to produce a slot index. */
+    unsigned shift;
+
+    /** The number of keys in the table (excluding the sentinel). */
+    size_t count;
+
+    /** Whether the sentinel value is in the set. */
+    bool has_empty_key;
+
+    /** Storage for the sentinel value for iterators to refer to. */
+    T empty_key;
+
+public:
+    /** The type this set stores. */
+    typedef T value_type;
+
+    /** A const iterator type to iterate over elements in the set. */
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        const T& operator*() const noexcept
+        {
+            return pos < set->capacity ? set->slots[pos] : set->empty_key;
+        }
+        const_iterator& operator++() noexcept
+        {
+            pos++;
+            skip_empty();
+            return *this;
+        }
+        const_iterator operator++(int) noexcept
+        {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const const_iterator& other) const noexcept
+        {
+            return set == other.set && pos == other.pos;
+        }
+        bool operator!=(const const_iterator& other) const noexcept
+        {
+            return !operator==(other);
+        }
+
+    private:
+        friend class IntegerSet;
+        const_iterator(const IntegerSet* set, size_t pos) noexcept
+                : set(set), pos(pos)
+        {
+            skip_empty();
+        }
+        void skip_empty() noexcept
+        {
+            while (pos < set->capacity && set->slots[pos] == EMPTY)
+                pos++;
+        }
+        const IntegerSet* set;
+        size_t pos;
+    };
+
+    /** Iterators never permit modification of the elements. */
+    typedef const_iterator iterator;
+
+    /**
+     * \brief   IntegerSet Constructor.
+     * \param   expected    The number of keys to size the table for. The set
+     *                      will grow beyond this if required.
+     */
+    explicit IntegerSet(size_t expected = 0)
+            : slots(), capacity(0), shift(0), count(0), has_empty_key(false),
+              empty_key(EMPTY)
+    {
+        allocate(capacity_for(expected));
+    }
+
+    /**
+     * \brief   IntegerSet Destructor.
+     */
+    virtual ~IntegerSet(void) {}
+
+    /**
+     * \brief   Queries whether the set contains the given key.
+     * \param   key The key to check for.
+     * \return  true if the key is in the set, false otherwise.
+     */
+    inline bool contains(T key) const noexcept
+    {
+        if (key == EMPTY)
+            return has_empty_key;
+        size_t pos = home(key);
+        for (;;)
+        {
+            unsigned match, empty;
+            probe(&slots[pos], key, match, empty);
+            if (match)
+                return true;
+            if (empty)
+                return false;
+            pos = (pos + GROUP) & (capacity - 1);
+        }
+    }
+
+    /**
+     * \brief   Inserts the given key into the set.
+     * \param   key The key to insert (no action will be taken if it is already
+     *              in the set).
+     * \return  true if the key was inserted, false if it was already present.
+     */
+    bool insert(T key)
+    {
+        if (key == EMPTY)
+        {
+            const bool inserted = !has_empty_key;
+            has_empty_key = true;
+            return inserted;
+        }
+        if ((count + 1) * 4 > capacity * 3)
+            rehash(capacity * 2);
+        size_t pos = home(key);
+        for (;;)
+        {
+            unsigned match, empty;
+            probe(&slots[pos], key, match, empty);
+            if (match)
+                return false;
+            if (empty)
+            {
+                // Keys are never found beyond an empty slot, so the first
+                // empty slot in the probe sequence is where the key belongs.
+                pos = (pos + lowest_bit(empty)) & (capacity - 1);
+                place(pos, key);
+                count++;
+                return true;
+            }
+            pos = (pos + GROUP) & (capacity - 1);
+        }
+    }
+
+    /**
+     * \brief   Ensures the table can hold at least the given number of keys
+     *          without needing to grow.
+     * \param   expected    The number of keys to size the table for.
+     */
+    void reserve(size_t expected)
+    {
+        const size_t needed = capacity_for(expected);
+        if (needed > capacity)
+            rehash(needed);
+    }
+
+    /**
+     * \brief   Queries whether the set is empty (i.e. size 0).
+     * \return  true if empty, false otherwise.
+     */
+    inline bool empty(void) const noexcept
+    {
+        return size() == 0;
+    }
+
+    /**
+     * \brief   Determines the set size.
+     * \return  Number of elements in the set.
+     */
+    inline size_t size(void) const noexcept
+    {
+        return count + (has_empty_key ? 1 : 0);
+    }
+
+    /**
+     * \brief   Returns an iterator pointing to the first element in the set.
+     * \return  An iterator to the beginning of the container.
+     */
+    inline const_iterator begin(void) const noexcept
+    {
+        return const_iterator(this, 0);
+    }
+
+    /**
+     * \brief   Returns an iterator pointing to the past-the-end element in the
+     *          set.
+     * \return  An iterator to past the end of the container.
+     */
+    inline const_iterator end(void) const noexcept
+    {
+        return const_iterator(this, capacity + (has_empty_key ? 1 : 0));
+    }
+
+private:
+    /**
+     * \brief   Calculates the home slot of a key by Fibonacci hashing: the
+     *          key is multiplied by 2^64 / phi and the top bits taken.
+     * \param   key The key to hash.
+     * \return  The slot index, in <tt>[0, capacity)</tt>.
+     */
+    inline size_t home(T key) const noexcept
+    {
+        return static_cast<size_t>(
+                (static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    /**
+     * \brief   Writes a key into a slot, keeping the copied group in sync.
+     * \param   pos The slot index.
+     * \param   key The key to write.
+     */
+    inline void place(size_t pos, T key) noexcept
+    {
+        slots[pos] = key;
+        if (pos < GROUP)
+            slots[capacity + pos] = key;
+    }
+
+    /**
+     * \brief   Compares the group of slots starting at p against the key and
+     *          the sentinel.
+     * \param   p       Pointer to the first slot of the group.
+     * \param   key     The key to compare against.
+     * \param   match   Output bitmask, bit i set if slot i holds the key.
+     * \param   empty   Output bitmask, bit i set if slot i is empty.
+     */
+    static inline void probe(const T* p, T key, unsigned& match,
+                             unsigned& empty) noexcept
+    {
+        probe(p, key, match, empty, std::integral_constant<size_t, sizeof(T)>());
+    }
+
+    template <size_t N>
+    static inline void probe(const T* p, T key, unsigned& match,
+                             unsigned& empty,
+                             std::integral_constant<size_t, N>) noexcept
+    {
+        match = 0;
+        empty = 0;
+        for (size_t i = 0; i < GROUP; i++)
+        {
+            match |= static_cast<unsigned>(p[i] == key) << i;
+            empty |= static_cast<unsigned>(p[i] == EMPTY) << i;
+        }
+    }
+
+#if defined(__SSE2__)
+    static inline void probe(const T* p, T key, unsigned& match,
+                             unsigned& empty,
+                             std::integral_constant<size_t, 4>) noexcept
+    {
+        const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i keys = _mm_set1_epi32(static_cast<int>(key));
+        const __m128i empties = _mm_set1_epi32(-1);
+        match = static_cast<unsigned>(_mm_movemask_ps(
+                _mm_castsi128_ps(_mm_cmpeq_epi32(group, keys))));
+        empty = static_cast<unsigned>(_mm_movemask_ps(
+                _mm_castsi128_ps(_mm_cmpeq_epi32(group, empties))));
+    }
+#endif
+
+#if defined(__SSE4_1__)
+    static inline void probe(const T* p, T key, unsigned& match,
+                             unsigned& empty,
+                             std::integral_constant<size_t, 8>) noexcept
+    {
+        const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i keys = _mm_set1_epi64x(static_cast<long long>(key));
+        const __m128i empties = _mm_set1_epi64x(-1);
+        match = static_cast<unsigned>(_mm_movemask_pd(
+                _mm_castsi128_pd(_mm_cmpeq_epi64(group, keys))));
+        empty = static_cast<unsigned>(_mm_movemask_pd(
+                _mm_castsi128_pd(_mm_cmpeq_epi64(group, empties))));
+    }
+#endif
+
+    /**
+     * \brief   Finds the index of the lowest set bit.
+     * \param   x   The (non-zero) value to search.
+     * \return  The index of the lowest set bit.
+     */
+    static inline unsigned lowest_bit(unsigned x) noexcept
+    {
+#if defined(__GNUC__)
+        return static_cast<unsigned>(__builtin_ctz(x));
+#else
+        unsigned n = 0;
+        for (; !(x & 1); x >>= 1)
+            n++;
+        return n;
+#endif
+    }
+
+    /**
+     * \brief   Calculates the table capacity needed to hold the given number
+     *          of keys within the maximum load factor (3/4).
+     * \param   expected    The number of keys.
+     * \return  The capacity, a power of two.
+     */
+    static size_t capacity_for(size_t expected) noexcept
+    {
+        size_t cap = MIN_CAPACITY;
+        while (cap * 3 < expected * 4)
+            cap *= 2;
+        return cap;
+    }
+
+    /**
+     * \brief   Replaces the table with an empty one of the given capacity.
+     * \param   cap The new capacity, a power of two.
+     */
+    void allocate(size_t cap)
+    {
+        slots.assign(cap + GROUP, EMPTY);
+        capacity = cap;
+        shift = 64;
+        for (size_t c = cap; c > 1; c >>= 1)
+            shift--;
+    }
+
+    /**
+     * \brief   Moves every key into a new table of the given capacity.
+     * \param   cap The new capacity, a power of two.
+     */
+    void rehash(size_t cap)
+    {
+        std::vector<T> old;
+        old.swap(slots);
+        const size_t old_capacity = capacity;
+        allocate(cap);
+        for (size_t i = 0; i < old_capacity; i++)
+        {
+            const T key = old[i];
+            if (key == EMPTY)
+                continue;
+            size_t pos = home(key);
+            while (slots[pos] != EMPTY)
+                pos = (pos + 1) & (capacity - 1);
+            place(pos, key);
+        }
+    }
+};
+
+template <class T>
+const T IntegerSet<T>::EMPTY;
+
+#endif
@@ -28,7 +28,14 @@
 #ifndef _COMMON_SIMPLESET_H
 #define _COMMON_SIMPLESET_H
 
-#include <algorithm>    // find
+#include <algorithm>    // find, max, min
+#include <cstdint>      // uint64_t
+#include <functional>   // hash
+#include <iterator>     // distance, iterator_traits, make_move_iterator
+#include <memory>       // allocator
+#include <thread>       // thread
+#include <type_traits>  // enable_if, is_convertible
+#include <unordered_set> // unordered_set
 #include <vector>       // vector
 
 
@@ -39,21 +46,196 @@
  * (and immutability) of data and provides set-like methods. This has a smaller
  * memory footprint and is faster than std::set for small amounts of data, but
  * has O(n) complexity for insertion (all other operations are O(1)) so will
- * perform worse than std::set for large n.
+ * perform worse than std::set for large n. Large sets should instead be built
+ * in one go from a range, which deduplicates in O(n) across multiple threads.
+ *
+ * \param T         The type stored in this set.
+ * \param Allocator The allocator used for the set's storage.
  */
-template <class T>
+template <class T, class Allocator = std::allocator<T>>
 class SimpleSet
 {
 private:
     /** The vector that actually holds the data. */
-    std::vector<T> set;
+    std::vector<T, Allocator> set;
+
+    /** The minimum number of input elements given to each thread when
+     *  building a set from a range. */
+    static const size_t PARALLEL_GRAIN = 1 << 16;
+
+    /**
+     * \brief   Maps a hash onto one of \p parts partitions. The hash is
+     *          mixed first so that the partition is independent of the low
+     *          bits a hash table will use.
+     * \param   h       The hash to map.
+     * \param   parts   The number of partitions.
+     * \return  The partition index, in <tt>[0, parts)</tt>.
+     */
+    static inline size_t partition_of(size_t h, size_t parts) noexcept
+    {
+        const uint64_t mixed = static_cast<uint64_t>(h) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(((mixed >> 32) * parts) >> 32);
+    }
+
+    /**
+     * \brief   Fills the (empty) set with the unique elements of the given
+     *          range, using the given number of threads.
+     * \param   first   Iterator to the first element of the input range.
+     * \param   n       The number of elements in the input range.
+     * \param   threads The number of threads to use (>= 1).
+     * \param   hash    The hash function to partition and deduplicate with.
+     */
+    template <class RandomIt, class Hash>
+    void parallel_build(RandomIt first, size_t n, unsigned threads,
+                        const Hash& hash)
+    {
+        const size_t parts = threads;
+        // Phase 1: each thread scatters its slice of the input into one
+        // bucket per partition. buckets[t * parts + p] is only touched by
+        // thread t during this phase.
+        std::vector<std::vector<T>> buckets(parts * parts);
+        auto scatter = [&](size_t t) {
+            const size_t begin = n * t / parts;
+            const size_t end = n * (t + 1) / parts;
+            std::vector<T>* out = &buckets[t * parts];
+            for (size_t p = 0; p < parts; p++)
+                out[p].reserve((end - begin) / parts + 1);
+            for (size_t i = begin; i < end; i++)
+            {
+                const T& elem = first[i];
+                out[partition_of(hash(elem), parts)].push_back(elem);
+            }
+        };
+        // Phase 2: each thread deduplicates one partition, gathering from
+        // every thread's bucket for it. Partitions are disjoint so no
+        // synchronisation is required.
+        std::vector<std::vector<T>> unique(parts);
+        auto dedupe = [&](size_t p) {
+            size_t total = 0;
+            for (size_t t = 0; t < parts; t++)
+                total += buckets[t * parts + p].size();
+            std::unordered_set<T, Hash> seen(total, hash);
+            std::vector<T>& out = unique[p];
+            out.reserve(total);
+            for (size_t t = 0; t < parts; t++)
+            {
+                std::vector<T>& bucket = buckets[t * parts + p];
+                for (T& elem : bucket)
+                    if (seen.insert(elem).second)
+                        out.push_back(std::move(elem));
+                std::vector<T>().swap(bucket);
+            }
+        };
+        run_parallel(parts, scatter);
+        run_parallel(parts, dedupe);
+        // Phase 3: concatenate the partitions.
+        size_t total = 0;
+        for (const std::vector<T>& part : unique)
+            total += part.size();
+        set.reserve(total);
+        for (std::vector<T>& part : unique)
+            set.insert(set.end(), std::make_move_iterator(part.begin()),
+                       std::make_move_iterator(part.end()));
+    }
+
+    /**
+     * \brief   Calls <tt>fn(i)</tt> for every i in <tt>[0, count)</tt>, each
+     *          on its own thread (with the last on the calling thread), and
+     *          waits for all of them to complete.
+     * \param   count   The number of calls to make.
+     * \param   fn      The function to call.
+     */
+    template <class Fn>
+    static void run_parallel(size_t count, Fn& fn)
+    {
+        std::vector<std::thread> workers;
+        workers.reserve(count - 1);
+        for (size_t i = 0; i + 1 < count; i++)
+            workers.emplace_back(fn, i);
+        fn(count - 1);
+        for (std::thread& worker : workers)
+            worker.join();
+    }
 
 public:
+    /** The type this set stores. */
+    typedef T value_type;
+    /** The type used for sizes and indices. */
+    typedef size_t size_type;
+    /** Constant reference to an element. */
+    typedef const T& const_reference;
+    /** Random access iterator over the (immutable) elements of the set. As
+     *  the elements are contiguous this may be used with the parallel
+     *  algorithms of C++17 (e.g. <tt>std::execution::par</tt>). */
+    typedef typename std::vector<T, Allocator>::const_iterator const_iterator;
+    /** Iterators never permit modification of the elements. */
+    typedef const_iterator iterator;
+    /** The allocator type used for the set's storage. */
+    typedef Allocator allocator_type;
+
+    /** Breakdown of the memory used by a set, as returned by memory_usage().
+     *  Memory owned by the elements themselves (e.g. the contents of a
+     *  std::string) is not included. */
+    struct MemoryUsage
+    {
+        /** Bytes of the SimpleSet object itself. */
+        size_t object_bytes;
+        /** Bytes allocated on the heap for element storage. */
+        size_t heap_bytes;
+        /** Bytes of heap storage holding elements. */
+        size_t used_bytes;
+        /** Bytes of heap storage allocated but not yet holding elements. */
+        size_t slack_bytes;
+        /** Bytes used per element beyond sizeof(T), i.e. the object and
+         *  slack bytes spread across the elements (0 if empty). */
+        double overhead_per_element;
+    };
+
     /**
      * \brief   SimpleSet Constructor.
      */
     explicit SimpleSet(void) : set() {}
 
+    /**
+     * \brief   SimpleSet Constructor, using the given allocator.
+     * \param   alloc   The allocator to use for the set's storage.
+     */
+    explicit SimpleSet(const Allocator& alloc) : set(alloc) {}
+
+    /**
+     * \brief   SimpleSet Constructor, building the set from a range of
+     *          (possibly repeated) elements using multiple threads.
+     *
+     * The input is partitioned by hash across the threads, each partition is
+     * deduplicated independently with a hash set and the partitions are then
+     * concatenated. This is O(n) rather than the O(n^2) of calling insert()
+     * for every element, so should be used whenever a large set is built in
+     * one go. The order of the resulting set is unspecified.
+     * Requires \p Hash (by default std::hash<T>) to be defined for T.
+     * \param   first   Iterator to the first element of the input range.
+     * \param   last    Iterator to past the end of the input range.
+     * \param   threads The number of threads to use. 0 (the default) uses
+     *                  std::thread::hardware_concurrency(). Small inputs are
+     *                  always processed on the calling thread.
+     * \param   hash    The hash function to partition and deduplicate with.
+     * \param   alloc   The allocator to use for the set's storage.
+     */
+    template <class RandomIt, class Hash = std::hash<T>,
+              typename = typename std::enable_if<std::is_convertible<
+                  typename std::iterator_traits<RandomIt>::iterator_category,
+                  std::random_access_iterator_tag>::value>::type>
+    SimpleSet(RandomIt first, RandomIt last, unsigned threads = 0,
+              const Hash& hash = Hash(), const Allocator& alloc = Allocator())
+            : set(alloc)
+    {
+        const size_t n = static_cast<size_t>(std::distance(first, last));
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(
+                std::min<size_t>(threads, n / PARALLEL_GRAIN + 1));
+        parallel_build(first, n, threads, hash);
+    }
+
     /**
      * \brief   SimpleSet Destructor.
      */
@@ -98,13 +280,63 @@ public:
         return set.size();
     }
 
+    /**
+     * \brief   Reports the memory used by the set.
+     * \return  The breakdown of the memory used.
+     */
+    inline MemoryUsage memory_usage(void) const noexcept
+    {
+        MemoryUsage usage;
+        usage.object_bytes = sizeof(*this);
+        usage.heap_bytes = set.capacity() * sizeof(T);
+        usage.used_bytes = set.size() * sizeof(T);
+        usage.slack_bytes = usage.heap_bytes - usage.used_bytes;
+        usage.overhead_per_element = set.empty() ? 0.0 :
+                static_cast<double>(usage.object_bytes + usage.slack_bytes) /
+                set.size();
+        return usage;
+    }
+
+    /**
+     * \brief   Returns a pointer to the contiguous array of elements in the
+     *          set, which is valid for <tt>[data(), data() + size())</tt>.
+     *          Together with size() this allows the set to be viewed as a
+     *          span without copying.
+     * \return  Constant pointer to the first element.
+     */
+    inline const T* data(void) const noexcept
+    {
+        return set.data();
+    }
+
+    /**
+     * \brief   Returns an iterator pointing to the first element in the set.
+     *          Elements cannot be modified through the iterator as that could
+     *          break their uniqueness.
+     * \return  An iterator to the beginning of the container.
+     */
+    inline const_iterator begin(void) const noexcept
+    {
+        return set.cbegin();
+    }
+
+    /**
+     * \brief   Returns an iterator pointing to the past-the-end element in the
+     *          set.
+     * \return  An iterator to past the end of the container.
+     */
+    inline const_iterator end(void) const noexcept
+    {
+        return set.cend();
+    }
+
     /**
      * \brief   Returns an iterator pointing to the first element in the set.
      * \return  An iterator to the beginning of the container.
      */
-    inline typename std::vector<T>::iterator begin(void) noexcept
+    inline const_iterator cbegin(void) const noexcept
     {
-        return set.begin();
+        return set.cbegin();
     }
 
     /**
@@ -112,9 +344,9 @@ public:
      *          set.
      * \return  An iterator to past the end of the container.
      */
-    inline typename std::vector<T>::iterator end(void) noexcept
+    inline const_iterator cend(void) const noexcept
     {
-        return set.end();
+        return set.cend();
     }
 
     /**
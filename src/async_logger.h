@@ -0,0 +1,656 @@
+/**
+ * \file   async_logger.h
+ * \author Jonathan Simmonds
+ * \brief  Asynchronous logger which defers formatting to a background thread.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_ASYNC_LOGGER_H
+#define _COMMON_ASYNC_LOGGER_H
+
+#include <atomic>       // atomic
+#include <cerrno>       // errno, EINTR
+#include <chrono>       // system_clock, milliseconds
+#include <cstdint>      // uint32_t, uint64_t, int64_t
+#include <cstdio>       // snprintf
+#include <cstdlib>      // size_t
+#include <cstring>      // memcpy, strlen
+#include <memory>       // unique_ptr
+#include <mutex>        // mutex, lock_guard
+#include <string>       // string
+#include <thread>       // thread, this_thread
+#include <type_traits>  // decay, is_trivially_copyable
+#include <vector>       // vector
+
+#include <sys/uio.h>    // writev, iovec
+#include <unistd.h>     // write
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>  // __rdtsc
+#endif
+
+
+/**
+ * \brief   What a logging thread does when its ring is full.
+ */
+enum class overflow_policy {
+    /** Discard the record (counted by <tt>async_logger::dropped()</tt>). */
+    drop,
+    /** Wait for the background thread to make space. */
+    block,
+};
+
+/**
+ * \brief   Asynchronous logger with deferred formatting.
+ *
+ * Logging a message copies a compact binary record into a lock-free
+ * single-producer single-consumer ring owned by the calling thread: a pointer
+ * to the (static) printf-style format string, a timestamp and the raw bytes
+ * of the arguments. No formatting or allocation happens on the logging thread
+ * (other than creating the thread's ring on its first message). A background
+ * thread drains every ring in batches, formats the records with snprintf and
+ * writes them to a file descriptor with writev.
+ *
+ * Arguments must be trivially copyable (integers, floating point, pointers,
+ * ...) or strings (<tt>const char*</tt> or <tt>std::string</tt>), which are
+ * copied into the record. The format string itself is not copied, so must
+ * outlive the logger (a string literal is ideal). Records from one thread are
+ * written in order; there is no ordering between threads.
+ *
+ * Records are timestamped with the CPU's cycle counter (the TSC on x86, the
+ * virtual counter on AArch64, otherwise system_clock) rather than by reading
+ * the wall clock, which is the most expensive part of logging. The background
+ * thread converts counter values to wall-clock time by interpolating between
+ * readings of both clocks it takes itself, so the TSC must be invariant, as
+ * on every x86 CPU of the last decade.
+ *
+ * Performance: apart from reading the counter, a call costs about 10 ns.
+ * Reading the TSC typically takes about 25 cycles on bare metal, which keeps
+ * a call within a 20 ns budget there. It can be much slower under
+ * virtualisation, which is a known limitation: on a shared single-core VM,
+ * reading the TSC took about 18 ns and a call took 25 to 35 ns. Reading
+ * system_clock on the same VM took about 35 ns. bench/BenchAsyncLogger
+ * measures these.
+ *
+ * Requires POSIX.
+ */
+class async_logger {
+public:
+    /**
+     * \brief   Constructor, starting the background thread.
+     * \param   fd          The file descriptor to write to. Not closed by the
+     *                      logger.
+     * \param   ring_bytes  The size of each thread's ring. Rounded up to a
+     *                      power of two. Records larger than half of this are
+     *                      always dropped.
+     * \param   policy      What to do when a thread's ring is full.
+     * \param   poll_interval   How long the background thread sleeps when
+     *                      every ring is empty.
+     */
+    explicit async_logger(int fd, std::size_t ring_bytes = 1 << 16,
+                          overflow_policy policy = overflow_policy::drop,
+                          std::chrono::milliseconds poll_interval = std::chrono::milliseconds(1))
+            : fd(fd)
+            , ring_bytes(round_up_pow2(ring_bytes < 256 ? 256 : ring_bytes))
+            , policy(policy)
+            , poll_interval(poll_interval)
+            , id(next_id().fetch_add(1) + 1)
+            , worker(&async_logger::run, this) {}
+
+    /**
+     * \brief   Destructor. Writes every record logged before destruction, then
+     *          stops the background thread.
+     */
+    ~async_logger() {
+        stopping.store(true, std::memory_order_release);
+        worker.join();
+    }
+
+    async_logger(const async_logger&) = delete;
+    async_logger& operator=(const async_logger&) = delete;
+
+    /**
+     * \brief   Logs a message, to be formatted as
+     *          <tt>snprintf(fmt, args...)</tt> on the background thread.
+     * \param   fmt     The printf-style format string. Must outlive the
+     *                  logger.
+     * \param   args    The arguments to format.
+     * \return  true if the record was queued, false if it was dropped.
+     */
+    template <typename... ARGS>
+    bool log(const char* fmt, const ARGS&... args) noexcept {
+        ring* r = local_ring();
+        if (r == nullptr) {
+            return false;
+        }
+        const std::size_t payload = sizeof(record_header) + encoded_size(args...);
+        const std::size_t size = (payload + ALIGN - 1) & ~(ALIGN - 1);
+        std::uint64_t next;
+        unsigned char* out = r->reserve(size, policy == overflow_policy::block, next);
+        if (out == nullptr) {
+            dropped_records.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        record_header header;
+        header.size = static_cast<std::uint32_t>(size);
+        header.padding = 0;
+        header.format = &formatter<typename std::decay<ARGS>::type...>::format;
+        header.fmt = fmt;
+        header.timestamp = ticks();
+        std::memcpy(out, &header, sizeof(header));
+        encode(out + sizeof(header), args...);
+        r->head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \brief   Blocks until every record logged (by any thread) before the
+     *          call has been written.
+     */
+    void flush() {
+        std::vector<std::pair<ring*, std::uint64_t>> targets;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            for (const std::unique_ptr<ring>& r : rings) {
+                targets.emplace_back(r.get(), r->head.load(std::memory_order_acquire));
+            }
+        }
+        for (const std::pair<ring*, std::uint64_t>& target : targets) {
+            while (target.first->tail.load(std::memory_order_acquire) < target.second) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /**
+     * \brief   Retrieves the number of records dropped because a ring was full
+     *          or the record was too large.
+     * \return  The number of dropped records.
+     */
+    std::size_t dropped() const noexcept {
+        return dropped_records.load(std::memory_order_relaxed);
+    }
+
+private:
+    /** The alignment of every record in a ring. */
+    static const std::size_t ALIGN = 8;
+    /** The number of loggers whose rings each thread caches. */
+    static const std::size_t CACHED_LOGGERS = 4;
+    /** The maximum number of records written by a single writev. */
+    static const int BATCH_RECORDS = 64;
+    /** The size of the background thread's formatting buffer. */
+    static const std::size_t BATCH_BYTES = 1 << 16;
+
+    /** Function formatting a record's arguments into a buffer. */
+    using format_fn = int (*)(char* out, std::size_t cap, const char* fmt,
+                              const unsigned char* args);
+
+    /** The header of each record. The first 8 bytes alone are also used as a
+     *  padding marker at the end of a ring, so must contain size. */
+    struct record_header {
+        std::uint32_t size;     // Bytes in the record including the header.
+        std::uint32_t padding;  // Non-zero if this is padding to skip.
+        format_fn format;
+        const char* fmt;
+        std::int64_t timestamp; // The value of ticks() when logged.
+    };
+
+    /** How a single argument type is copied into and out of a record. */
+    template <typename T, typename = void>
+    struct codec {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "async_logger arguments must be trivially copyable or strings");
+        using decoded = T;
+        static std::size_t size(const T&) noexcept { return sizeof(T); }
+        static unsigned char* encode(unsigned char* out, const T& value) noexcept {
+            std::memcpy(out, &value, sizeof(T));
+            return out + sizeof(T);
+        }
+        static const unsigned char* decode(const unsigned char* in, T& value) noexcept {
+            std::memcpy(&value, in, sizeof(T));
+            return in + sizeof(T);
+        }
+    };
+
+    /** Strings are copied (null-terminated) into the record and decoded as a
+     *  pointer into it. */
+    struct string_codec {
+        using decoded = const char*;
+        static std::size_t size(const char* value) noexcept {
+            return std::strlen(value) + 1;
+        }
+        static unsigned char* encode(unsigned char* out, const char* value) noexcept {
+            const std::size_t n = std::strlen(value) + 1;
+            std::memcpy(out, value, n);
+            return out + n;
+        }
+        static const unsigned char* decode(const unsigned char* in, const char*& value) noexcept {
+            value = reinterpret_cast<const char*>(in);
+            return in + std::strlen(value) + 1;
+        }
+    };
+
+    /** Decodes each argument of a record in turn, accumulating them in
+     *  DONE, and finally calls snprintf with all of them. */
+    template <typename... ARGS>
+    struct decoder;
+
+    /** Formats a record whose arguments have the given types. */
+    template <typename... ARGS>
+    struct formatter {
+        static int format(char* out, std::size_t cap, const char* fmt,
+                          const unsigned char* args) noexcept {
+            return decoder<ARGS...>::run(out, cap, fmt, args);
+        }
+    };
+
+    static std::size_t encoded_size() noexcept { return 0; }
+
+    template <typename A, typename... REST>
+    static std::size_t encoded_size(const A& arg, const REST&... rest) noexcept {
+        return codec<typename std::decay<A>::type>::size(arg) + encoded_size(rest...);
+    }
+
+    static void encode(unsigned char*) noexcept {}
+
+    template <typename A, typename... REST>
+    static void encode(unsigned char* out, const A& arg, const REST&... rest) noexcept {
+        encode(codec<typename std::decay<A>::type>::encode(out, arg), rest...);
+    }
+
+    /**
+     * \brief   Lock-free single-producer single-consumer byte ring holding
+     *          one thread's records. Positions increase monotonically and are
+     *          masked to index the storage.
+     */
+    struct ring {
+        explicit ring(std::size_t bytes, std::thread::id owner)
+                : storage(new unsigned char[bytes]), mask(bytes - 1), owner(owner) {}
+
+        /**
+         * \brief   Reserves space for a record, inserting padding if it would
+         *          otherwise straddle the end of the storage. The record is
+         *          published by storing next to head.
+         * \param   size    The record size, a multiple of ALIGN.
+         * \param   block   Whether to wait for space rather than fail.
+         * \param   next    Set to the head position after the record.
+         * \return  Pointer to write the record to, or nullptr if there is no
+         *          space.
+         */
+        unsigned char* reserve(std::size_t size, bool block, std::uint64_t& next) noexcept {
+            const std::size_t capacity = mask + 1;
+            if (size > capacity / 2) {
+                return nullptr;
+            }
+            const std::uint64_t pos = head.load(std::memory_order_relaxed);
+            const std::size_t offset = static_cast<std::size_t>(pos & mask);
+            const std::size_t contiguous = capacity - offset;
+            const std::size_t needed = size <= contiguous ? size : contiguous + size;
+            while (pos + needed - cached_tail > capacity) {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (pos + needed - cached_tail <= capacity) {
+                    break;
+                }
+                if (!block) {
+                    return nullptr;
+                }
+                std::this_thread::yield();
+            }
+            next = pos + needed;
+            if (needed != size) {
+                // Pad to the end of the storage and start at the beginning.
+                const std::uint32_t pad[2] = { static_cast<std::uint32_t>(contiguous), 1 };
+                std::memcpy(storage.get() + offset, pad, sizeof(pad));
+                return storage.get();
+            }
+            return storage.get() + offset;
+        }
+
+        std::unique_ptr<unsigned char[]> storage;
+        const std::size_t mask;
+        const std::thread::id owner;
+        /** Producer state, padded onto its own cache line. (Padding is used
+         *  rather than alignas as over-aligned new requires C++17.) */
+        char producer_pad[64];
+        std::atomic<std::uint64_t> head { 0 };
+        std::uint64_t cached_tail = 0;
+        /** Consumer state, padded onto its own cache line. */
+        char consumer_pad[64];
+        std::atomic<std::uint64_t> tail { 0 };
+        char end_pad[64];
+    };
+
+    /** A thread's cache of its rings in recently used loggers. */
+    struct thread_cache {
+        struct entry {
+            std::uint64_t id;
+            ring* r;
+        };
+        entry entries[CACHED_LOGGERS];
+        std::size_t next_victim;
+    };
+
+    static thread_cache& local_cache() noexcept {
+        static thread_local thread_cache cache = {};
+        return cache;
+    }
+
+    /**
+     * \brief   Retrieves the calling thread's ring, creating it on first use.
+     *
+     * Each thread caches its rings for the last CACHED_LOGGERS loggers it
+     * used, keyed by logger id, so a thread alternating between a few loggers
+     * only takes the mutex the first time it uses each.
+     *
+     * \return  The ring, or nullptr if it could not be allocated.
+     */
+    ring* local_ring() noexcept {
+        thread_cache& cache = local_cache();
+        for (const thread_cache::entry& entry : cache.entries) {
+            if (entry.id == id) {
+                return entry.r;
+            }
+        }
+        return register_thread(cache);
+    }
+
+    /**
+     * \brief   Finds or creates the calling thread's ring and caches it.
+     * \param   cache   The calling thread's cache.
+     * \return  The ring, or nullptr if it could not be allocated.
+     */
+    ring* register_thread(thread_cache& cache) noexcept {
+        try {
+            const std::thread::id self = std::this_thread::get_id();
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            ring* found = nullptr;
+            for (const std::unique_ptr<ring>& r : rings) {
+                if (r->owner == self) {
+                    found = r.get();
+                }
+            }
+            if (found == nullptr) {
+                rings.emplace_back(new ring(ring_bytes, self));
+                found = rings.back().get();
+                ring_count.store(rings.size(), std::memory_order_release);
+            }
+            thread_cache::entry& entry = cache.entries[cache.next_victim++ % CACHED_LOGGERS];
+            entry.id = id;
+            entry.r = found;
+            return found;
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    /**
+     * \brief   The background thread: drains every ring until stopped.
+     */
+    void run() {
+        std::vector<ring*> snapshot;
+        for (;;) {
+            // Read stopping before draining so that records logged before
+            // the destructor was called are always written.
+            const bool stop = stopping.load(std::memory_order_acquire);
+            // Every record drained below was timestamped before (or, racing
+            // with this, just after) this reading.
+            latest = sample_clock();
+            if (snapshot.size() != ring_count.load(std::memory_order_acquire)) {
+                std::lock_guard<std::mutex> lock(rings_mutex);
+                snapshot.clear();
+                for (const std::unique_ptr<ring>& r : rings) {
+                    snapshot.push_back(r.get());
+                }
+            }
+            bool idle = true;
+            for (ring* r : snapshot) {
+                while (drain(*r)) {
+                    idle = false;
+                }
+            }
+            if (idle) {
+                if (stop) {
+                    return;
+                }
+                // Interpolate from here next time, so steps of the wall clock
+                // only affect records logged around them.
+                epoch = latest;
+                std::this_thread::sleep_for(poll_interval);
+            }
+        }
+    }
+
+    /**
+     * \brief   Formats and writes a batch of records from a ring.
+     * \param   r   The ring to drain.
+     * \return  true if any records were drained.
+     */
+    bool drain(ring& r) {
+        const std::uint64_t head = r.head.load(std::memory_order_acquire);
+        std::uint64_t pos = r.tail.load(std::memory_order_relaxed);
+        if (pos == head) {
+            return false;
+        }
+        iovec iov[BATCH_RECORDS];
+        int records = 0;
+        std::size_t used = 0;
+        while (pos != head && records < BATCH_RECORDS && BATCH_BYTES - used > 64) {
+            const unsigned char* in = r.storage.get() + (pos & r.mask);
+            std::uint32_t marker[2];
+            std::memcpy(marker, in, sizeof(marker));
+            if (marker[1] != 0) {
+                pos += marker[0];
+                continue;
+            }
+            record_header header;
+            std::memcpy(&header, in, sizeof(header));
+            char* out = batch.get() + used;
+            const std::size_t cap = BATCH_BYTES - used;
+            const std::int64_t timestamp = to_ns(header.timestamp);
+            const std::int64_t seconds = timestamp / 1000000000;
+            const std::int64_t nanos = timestamp % 1000000000;
+            int n = std::snprintf(out, cap, "[%lld.%09lld] ",
+                                  static_cast<long long>(seconds),
+                                  static_cast<long long>(nanos));
+            if (n >= 0 && static_cast<std::size_t>(n) < cap) {
+                const int m = header.format(out + n, cap - n, header.fmt, in + sizeof(header));
+                n += m < 0 ? 0 : m;
+            }
+            // Truncated output keeps the newline in the last byte.
+            std::size_t len = n < 0 ? 0 : static_cast<std::size_t>(n);
+            if (len > cap - 1) {
+                len = cap - 1;
+            }
+            out[len++] = '\n';
+            iov[records].iov_base = out;
+            iov[records].iov_len = len;
+            records++;
+            used += len;
+            pos += header.size;
+        }
+        write_all(iov, records);
+        r.tail.store(pos, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \brief   Writes every byte described by the iovecs, retrying partial
+     *          writes.
+     * \param   iov     The buffers to write. Modified.
+     * \param   count   The number of buffers.
+     */
+    void write_all(iovec* iov, int count) noexcept {
+        while (count > 0) {
+            const ssize_t written = ::writev(fd, iov, count);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            std::size_t remaining = static_cast<std::size_t>(written);
+            while (count > 0 && remaining >= iov->iov_len) {
+                remaining -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+                iov->iov_len -= remaining;
+            }
+        }
+    }
+
+    static std::int64_t now_ns() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * \brief   Reads the counter records are timestamped with.
+     * \return  The counter value, in unspecified units.
+     */
+    static std::int64_t ticks() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        return static_cast<std::int64_t>(__rdtsc());
+#elif defined(__aarch64__)
+        std::uint64_t value;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+        return static_cast<std::int64_t>(value);
+#else
+        return now_ns();
+#endif
+    }
+
+    /** A reading of both ticks() and the wall clock at the same moment. */
+    struct clock_sample {
+        std::int64_t ticks;
+        std::int64_t ns;
+    };
+
+    static clock_sample sample_clock() noexcept {
+        const std::int64_t before = ticks();
+        clock_sample sample;
+        sample.ns = now_ns();
+        sample.ticks = before + (ticks() - before) / 2;
+        return sample;
+    }
+
+    /**
+     * \brief   Converts a record's timestamp to wall-clock time by linear
+     *          interpolation between epoch and latest.
+     * \param   t   The value of ticks() when the record was logged.
+     * \return  Nanoseconds since the epoch.
+     */
+    std::int64_t to_ns(std::int64_t t) const noexcept {
+        const std::int64_t span = latest.ticks - epoch.ticks;
+        if (span <= 0) {
+            return latest.ns;
+        }
+        const double ns_per_tick = static_cast<double>(latest.ns - epoch.ns) / static_cast<double>(span);
+        return epoch.ns + static_cast<std::int64_t>(static_cast<double>(t - epoch.ticks) * ns_per_tick);
+    }
+
+    static std::size_t round_up_pow2(std::size_t x) noexcept {
+        std::size_t p = 1;
+        while (p < x) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    /** Source of unique logger ids, used to validate thread-local caches. */
+    static std::atomic<std::uint64_t>& next_id() noexcept {
+        static std::atomic<std::uint64_t> counter { 0 };
+        return counter;
+    }
+
+    const int fd;
+    const std::size_t ring_bytes;
+    const overflow_policy policy;
+    const std::chrono::milliseconds poll_interval;
+    const std::uint64_t id;
+    std::atomic<bool> stopping { false };
+    std::atomic<std::size_t> dropped_records { 0 };
+    /** Protects rings. */
+    std::mutex rings_mutex;
+    /** Every thread's ring. Never removed while the logger is alive. */
+    std::vector<std::unique_ptr<ring>> rings;
+    /** The number of rings, so the background thread can check for new
+     *  rings without locking. */
+    std::atomic<std::size_t> ring_count { 0 };
+    /** The background thread's formatting buffer. */
+    std::unique_ptr<char[]> batch { new char[BATCH_BYTES] };
+    /** The clock readings timestamps are interpolated between. Only used by
+     *  the background thread. */
+    clock_sample epoch { sample_clock() };
+    clock_sample latest { epoch };
+    /** The background thread. Declared last so everything else is
+     *  initialised before it starts. */
+    std::thread worker;
+};
+
+template <>
+struct async_logger::decoder<> {
+    template <typename... DONE>
+    static int run(char* out, std::size_t cap, const char* fmt,
+                   const unsigned char*, DONE... done) noexcept {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+        return std::snprintf(out, cap, fmt, done...);
+#pragma GCC diagnostic pop
+    }
+};
+
+template <typename A, typename... REST>
+struct async_logger::decoder<A, REST...> {
+    template <typename... DONE>
+    static int run(char* out, std::size_t cap, const char* fmt,
+                   const unsigned char* in, DONE... done) noexcept {
+        typename codec<A>::decoded value;
+        in = codec<A>::decode(in, value);
+        return decoder<REST...>::run(out, cap, fmt, in, done..., value);
+    }
+};
+
+/** std::string arguments are logged as their contents. */
+template <>
+struct async_logger::codec<std::string, void> : async_logger::string_codec {
+    static std::size_t size(const std::string& value) noexcept {
+        return value.size() + 1;
+    }
+    static unsigned char* encode(unsigned char* out, const std::string& value) noexcept {
+        std::memcpy(out, value.c_str(), value.size() + 1);
+        return out + value.size() + 1;
+    }
+    using string_codec::decode;
+};
+
+/** C string arguments are logged as their contents. */
+template <>
+struct async_logger::codec<const char*, void> : async_logger::string_codec {};
+template <>
+struct async_logger::codec<char*, void> : async_logger::string_codec {};
+
+#endif // _COMMON_ASYNC_LOGGER_H
@@ -28,8 +28,13 @@
 #ifndef _COMMON_CIRCULAR_BUFFER_H
 #define _COMMON_CIRCULAR_BUFFER_H
 
-#include <array>    // array
-#include <cstdlib>  // size_t
+#include <array>        // array
+#include <cstddef>      // ptrdiff_t
+#include <cstdlib>      // size_t
+#include <iterator>     // random_access_iterator_tag
+#include <memory>       // unique_ptr
+#include <type_traits>  // conditional, decay, enable_if, integral_constant
+#include <utility>      // forward, move, pair, swap
 
 
 /**  
@@ -42,54 +47,133 @@
  *              this is accounted for when the SIZE is decided upon (i.e.
  *              <tt>capacity = SIZE - 1</tt>). SIZE must be >= 1 (which would
  *              result in a buffer with no usable elements).
+ * \param HEAP  If true the elements are stored in a separate heap allocation
+ *              rather than inline in the object. This makes moving and
+ *              swapping buffers O(1) pointer exchanges, at the cost of an
+ *              allocation on construction and copy.
  */
-template <typename T, std::size_t SIZE>
+template <typename T, std::size_t SIZE, bool HEAP = false>
 class circular_buffer {
     static_assert(SIZE > 0, "SIZE must be > 0");
 
 protected:
+    /** Whether ARGS is a single argument of (possibly cv/ref-qualified) type
+     *  SELF. Used to stop forwarding constructors hiding copy constructors. */
+    template <typename SELF, typename... ARGS>
+    struct is_single : std::false_type {};
+    template <typename SELF, typename ARG>
+    struct is_single<SELF, ARG>
+            : std::is_same<typename std::decay<ARG>::type, SELF> {};
 
 public:
     /** The type this buffer stores. */
     using value_type = T;
 
-    /** An iterator type to iterate over elements in this buffer. */
-    class iterator {
-    protected:
-        friend class circular_buffer;
-        constexpr iterator(circular_buffer<T, SIZE>& buf, std::size_t start) noexcept
-                : buffer(buf), pos(start) {};
-    public:
-        T& operator*() noexcept;
-        void operator++() noexcept;
-        const bool operator==(const iterator& other) noexcept;
-        const bool operator!=(const iterator& other) noexcept;
-    private:
-        circular_buffer<T, SIZE>& buffer;
-        std::size_t pos;
+    /** Breakdown of the memory used by a buffer, as returned by
+     *  <tt>memory_usage()</tt>. Memory owned by the elements themselves (e.g.
+     *  the contents of a std::string) is not included. */
+    struct memory_usage_info {
+        /** Bytes of the circular_buffer object itself (including the inline
+         *  element storage). */
+        std::size_t object_bytes;
+        /** Bytes allocated on the heap for element storage. */
+        std::size_t heap_bytes;
+        /** Bytes of element storage holding live elements. */
+        std::size_t used_bytes;
+        /** Bytes of element storage not holding live elements (including the
+         *  slot which is always left empty). */
+        std::size_t slack_bytes;
+        /** Bytes used per live element beyond <tt>sizeof(T)</tt>, i.e. all
+         *  other bytes spread across the live elements (0 if empty). */
+        double overhead_per_element;
     };
 
-    /** A const-iterator type to iterate over elements in this buffer. */
-    class const_iterator {
-    protected:
+private:
+    /**
+     * \brief   Iterator over the elements, front to back. Holds a storage
+     *          index, so dereferencing and stepping are as cheap as for
+     *          <tt>operator[]</tt>; distances and ordering are by position
+     *          from the front.
+     */
+    template <bool CONST>
+    class basic_iterator {
+        using buffer_type = typename std::conditional<CONST, const circular_buffer, circular_buffer>::type;
         friend class circular_buffer;
-        constexpr const_iterator(const circular_buffer<T, SIZE>& buf, std::size_t start) noexcept
-                : buffer(buf), pos(start) {};
+        constexpr basic_iterator(buffer_type& buf, std::size_t start) noexcept
+                : buffer(&buf), pos(start) {}
+
     public:
-        const T& operator*() noexcept;
-        void operator++() noexcept;
-        const bool operator==(const const_iterator& other) noexcept;
-        const bool operator!=(const const_iterator& other) noexcept;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = typename std::conditional<CONST, const T*, T*>::type;
+        using reference = typename std::conditional<CONST, const T&, T&>::type;
+
+        constexpr basic_iterator() noexcept : buffer(nullptr), pos(0) {}
+        /** Conversion from a mutable to a const iterator. */
+        template <bool OTHER, typename = typename std::enable_if<CONST && !OTHER>::type>
+        constexpr basic_iterator(const basic_iterator<OTHER>& other) noexcept
+                : buffer(other.buffer), pos(other.pos) {}
+
+        reference operator*() const noexcept { return buffer->buffer[pos]; }
+        pointer operator->() const noexcept { return &buffer->buffer[pos]; }
+        reference operator[](difference_type n) const noexcept { return *(*this + n); }
+
+        basic_iterator& operator++() noexcept { pos = buffer->capped_mod(pos + 1); return *this; }
+        basic_iterator operator++(int) noexcept { basic_iterator old = *this; ++*this; return old; }
+        basic_iterator& operator--() noexcept { pos = buffer->capped_mod(pos + SIZE - 1); return *this; }
+        basic_iterator operator--(int) noexcept { basic_iterator old = *this; --*this; return old; }
+        basic_iterator& operator+=(difference_type n) noexcept {
+            pos = buffer->capped_mod(n >= 0 ? pos + static_cast<std::size_t>(n)
+                                            : pos + SIZE - static_cast<std::size_t>(-n));
+            return *this;
+        }
+        basic_iterator& operator-=(difference_type n) noexcept { return *this += -n; }
+        basic_iterator operator+(difference_type n) const noexcept { basic_iterator it = *this; return it += n; }
+        basic_iterator operator-(difference_type n) const noexcept { basic_iterator it = *this; return it -= n; }
+        friend basic_iterator operator+(difference_type n, const basic_iterator& it) noexcept { return it + n; }
+        // Iterators and const_iterators can be mixed, in either order.
+        template <bool OTHER>
+        difference_type operator-(const basic_iterator<OTHER>& other) const noexcept {
+            return static_cast<difference_type>(index()) - static_cast<difference_type>(other.index());
+        }
+
+        template <bool OTHER>
+        bool operator==(const basic_iterator<OTHER>& other) const noexcept {
+            return buffer == other.buffer && pos == other.pos;
+        }
+        template <bool OTHER>
+        bool operator!=(const basic_iterator<OTHER>& other) const noexcept { return !(*this == other); }
+        template <bool OTHER>
+        bool operator<(const basic_iterator<OTHER>& other) const noexcept { return index() < other.index(); }
+        template <bool OTHER>
+        bool operator>(const basic_iterator<OTHER>& other) const noexcept { return other < *this; }
+        template <bool OTHER>
+        bool operator<=(const basic_iterator<OTHER>& other) const noexcept { return !(other < *this); }
+        template <bool OTHER>
+        bool operator>=(const basic_iterator<OTHER>& other) const noexcept { return !(*this < other); }
+
     private:
-        const circular_buffer<T, SIZE>& buffer;
+        template <bool> friend class basic_iterator;
+        /** The position from the front of the buffer. */
+        std::size_t index() const noexcept { return buffer->index_of(pos); }
+        buffer_type* buffer;
         std::size_t pos;
     };
 
+public:
+    /** A random access iterator over the elements in this buffer, front to
+     *  back. */
+    using iterator = basic_iterator<false>;
+    /** A random access const-iterator over the elements in this buffer, front
+     *  to back. */
+    using const_iterator = basic_iterator<true>;
+
 
     /**
      * \brief   Constructor, initialising an empty circular_buffer.
      */
-    constexpr circular_buffer() noexcept = default;
+    constexpr circular_buffer() noexcept(!HEAP) {}
 
     /**
      * \brief   Constructor, initialising the circular_buffer.
@@ -100,17 +184,61 @@ public:
      *          <tt>at(len()-1)</tt>).
      */
     template<typename... ARGS,
-             typename = typename std::enable_if<(sizeof...(ARGS) < SIZE)>::type>
-    constexpr circular_buffer(ARGS&&... args) noexcept
+             typename = typename std::enable_if<(sizeof...(ARGS) < SIZE) &&
+                    !is_single<circular_buffer, ARGS...>::value>::type>
+    constexpr circular_buffer(ARGS&&... args) noexcept(!HEAP)
             : buffer{std::forward<ARGS>(args)...}
             , head(sizeof...(ARGS))
             , tail(0) {}
 
+    /**
+     * \brief   Copy constructor. Only the live elements of other are copied,
+     *          and are placed at the start of the new buffer's storage.
+     * \param   other   The buffer to copy.
+     */
+    circular_buffer(const circular_buffer& other);
+
+    /**
+     * \brief   Move constructor. For a heap-backed buffer this takes other's
+     *          storage in O(1), after which other may only be assigned to or
+     *          destroyed. Otherwise only the live elements of other are moved,
+     *          and other is left empty.
+     * \param   other   The buffer to move from.
+     */
+    circular_buffer(circular_buffer&& other) noexcept;
+
+    /**
+     * \brief   Copy assignment. Only the live elements of other are copied,
+     *          and are placed at the start of this buffer's storage.
+     * \param   other   The buffer to copy.
+     * \return  This buffer.
+     */
+    circular_buffer& operator=(const circular_buffer& other);
+
+    /**
+     * \brief   Move assignment. For a heap-backed buffer this exchanges
+     *          storage with other in O(1). Otherwise only the live elements of
+     *          other are moved, and other is left empty.
+     * \param   other   The buffer to move from.
+     * \return  This buffer.
+     */
+    circular_buffer& operator=(circular_buffer&& other) noexcept;
+
     /**
      * \brief   Destructor.
      */
     virtual ~circular_buffer() = default;
 
+    /**
+     * \brief   Exchanges the contents of this buffer with another. This is an
+     *          O(1) pointer exchange for a heap-backed buffer, otherwise it
+     *          exchanges the live elements of each buffer in place, using no
+     *          temporary buffer. A wrapped inline buffer is first rotated to
+     *          the start of its storage, which is O(SIZE).
+     * \param   other   The buffer to swap with.
+     */
+    void swap(circular_buffer& other) noexcept;
+
     /**
      * \brief   Returns whether or not the buffer is full.
      *          When full the buffer will insert new elements over the oldest.
@@ -138,6 +266,12 @@ public:
      */
     constexpr std::size_t capacity() const noexcept;
 
+    /**
+     * \brief   Reports the memory used by the buffer.
+     * \return  The breakdown of the memory used.
+     */
+    memory_usage_info memory_usage() const noexcept;
+
     /**
      * \brief   Treats the buffer like an array with indices <tt>[0,SIZE-1)</tt>
      *          and returns the item from the buffer located at the given index.
@@ -236,6 +370,16 @@ public:
      */
     void push_back(T&& item) noexcept;
 
+    /**
+     * \brief   Copies a range of items into the buffer, a contiguous run at a
+     *          time, overwriting the oldest items if the buffer becomes full.
+     *          If count exceeds the capacity only the last
+     *          <tt>capacity()</tt> items are kept.
+     * \param   items   Pointer to the first item to copy.
+     * \param   count   The number of items to copy.
+     */
+    void push_back(const T* items, std::size_t count) noexcept;
+
     /**
      * \brief   Removes the newest item from the buffer.
      *          Calling <tt>pop_back()</tt> on an empty buffer causes undefined
@@ -250,6 +394,97 @@ public:
      */
     void pop_front() noexcept;
 
+    /**
+     * \brief   Removes the given number of oldest items from the buffer.
+     *          Calling <tt>pop_front()</tt> with a count greater than
+     *          <tt>len()</tt> causes undefined behaviour.
+     * \param   count   The number of items to remove.
+     */
+    void pop_front(std::size_t count) noexcept;
+
+    /**
+     * \brief   Returns the first contiguous run of elements in the buffer,
+     *          i.e. from the front up to the back or the end of the storage,
+     *          whichever comes first. Together with <tt>array_two()</tt> this
+     *          covers every element, in order, so bulk operations can work on
+     *          (at most) two plain arrays rather than element by element.
+     * \return  Pointer to the front element and the length of the run (which
+     *          is 0 if the buffer is empty).
+     */
+    std::pair<const T*, std::size_t> array_one() const noexcept;
+
+    /**
+     * \brief   Returns the first contiguous run of elements in the buffer.
+     * \return  Pointer to the front element and the length of the run.
+     */
+    std::pair<T*, std::size_t> array_one() noexcept;
+
+    /**
+     * \brief   Returns the second contiguous run of elements in the buffer,
+     *          i.e. those which have wrapped around to the start of the
+     *          storage.
+     * \return  Pointer to the first wrapped element and the length of the run
+     *          (which is 0 if the elements have not wrapped).
+     */
+    std::pair<const T*, std::size_t> array_two() const noexcept;
+
+    /**
+     * \brief   Returns the second contiguous run of elements in the buffer.
+     * \return  Pointer to the first wrapped element and the length of the run.
+     */
+    std::pair<T*, std::size_t> array_two() noexcept;
+
+    /**
+     * \brief   Copies an item into the buffer before the given position. If
+     *          the buffer is full the oldest item is discarded first (so
+     *          inserting at <tt>begin()</tt> of a full buffer has no effect).
+     *          Whichever of the elements before or after the position are
+     *          fewer are moved to make room, so this is O(min(i, len() - i))
+     *          for an insert at index i. All iterators are invalidated.
+     * \param   pos     Iterator to the element to insert before (may be
+     *                  <tt>end()</tt>).
+     * \param   item    The item to copy into the buffer.
+     * \return  Iterator to the inserted item (or <tt>begin()</tt> if it was
+     *          immediately discarded).
+     */
+    iterator insert(iterator pos, const T& item) noexcept;
+
+    /**
+     * \brief   Moves an item into the buffer before the given position. If
+     *          the buffer is full the oldest item is discarded first (so
+     *          inserting at <tt>begin()</tt> of a full buffer has no effect).
+     *          Whichever of the elements before or after the position are
+     *          fewer are moved to make room, so this is O(min(i, len() - i))
+     *          for an insert at index i. All iterators are invalidated.
+     * \param   pos     Iterator to the element to insert before (may be
+     *                  <tt>end()</tt>).
+     * \param   item    The item to move into the buffer.
+     * \return  Iterator to the inserted item (or <tt>begin()</tt> if it was
+     *          immediately discarded).
+     */
+    iterator insert(iterator pos, T&& item) noexcept;
+
+    /**
+     * \brief   Removes the item at the given position. Whichever of the
+     *          elements before or after it are fewer are moved to close the
+     *          gap. All iterators are invalidated.
+     * \param   pos     Iterator to the item to remove. Must be
+     *                  dereferenceable.
+     * \return  Iterator to the item which followed the removed item.
+     */
+    iterator erase(iterator pos) noexcept;
+
+    /**
+     * \brief   Removes the items in the range <tt>[first, last)</tt>.
+     *          Whichever of the elements before or after the range are fewer
+     *          are moved to close the gap, a contiguous run at a time. All
+     *          iterators are invalidated.
+     * \param   first   Iterator to the first item to remove.
+     * \param   last    Iterator to the item following the last to remove.
+     * \return  Iterator to the item which followed the removed items.
+     */
+    iterator erase(iterator first, iterator last) noexcept;
+
     /**
      *  \brief  Returns an iterable object to the beginning (i.e. front) of the
      *          buffer. If the buffer is empty the returned iterator will be
@@ -284,9 +519,54 @@ public:
      */
     const_iterator end() const noexcept;
 
+    /**
+     *  \brief  Returns a const-iterator to the beginning (i.e. front) of the
+     *          buffer.
+     *  \return Iterator to the front of the buffer.
+     */
+    const_iterator cbegin() const noexcept;
+
+    /**
+     *  \brief  Returns a const-iterator to the element following the last
+     *          element (i.e. back) of the buffer.
+     *  \return Iterator to the element following the last element.
+     */
+    const_iterator cend() const noexcept;
+
 private:
+    /** Heap-allocated storage for SIZE elements, used in place of the inline
+     *  std::array when HEAP is set. Copying allocates fresh storage but does
+     *  not copy the elements, as circular_buffer copies only live elements
+     *  itself. */
+    class heap_array {
+    public:
+        heap_array() : data(new T[SIZE]()) {}
+        template <typename... ARGS,
+                  typename = typename std::enable_if<(sizeof...(ARGS) > 0) &&
+                        !is_single<heap_array, ARGS...>::value>::type>
+        heap_array(ARGS&&... args) : heap_array() {
+            std::size_t i = 0;
+            int expand[] = { 0, ((data[i++] = std::forward<ARGS>(args)), 0)... };
+            (void) expand;
+        }
+        heap_array(const heap_array&) : heap_array() {}
+        heap_array(heap_array&&) noexcept = default;
+        heap_array& operator=(const heap_array&) { allocate(); return *this; }
+        heap_array& operator=(heap_array&&) noexcept = default;
+        T& operator[](std::size_t pos) noexcept { return data[pos]; }
+        const T& operator[](std::size_t pos) const noexcept { return data[pos]; }
+        /** Allocates storage if it has been moved away. */
+        void allocate() { if (!data) data.reset(new T[SIZE]()); }
+        void swap(heap_array& other) noexcept { data.swap(other.data); }
+    private:
+        std::unique_ptr<T[]> data;
+    };
+
+    /** The storage type: inline or on the heap depending on HEAP. */
+    using storage_type = typename std::conditional<HEAP, heap_array, std::array<T, SIZE>>::type;
+
     /** The actual buffer. */
-    std::array<T, SIZE> buffer {};
+    storage_type buffer {};
     /** The buffer head: always points to a blank (or no-longer accessible)
      *  element. */
     std::size_t head { 0 };
@@ -305,7 +585,99 @@ private:
     inline constexpr std::size_t capped_mod(std::size_t x) const noexcept {
         return x < SIZE ? x : x - SIZE;
     }
+
+    /** Move constructor for a heap-backed buffer: take other's storage. */
+    circular_buffer(circular_buffer&& other, std::true_type) noexcept;
+    /** Move constructor for an inline buffer: move the live elements. */
+    circular_buffer(circular_buffer&& other, std::false_type) noexcept;
+
+    /**
+     * \brief   Converts a storage index into an index from the oldest element.
+     * \param   pos The storage index, which must be a live element or head.
+     * \return  The corresponding index in <tt>[0, len()]</tt>.
+     */
+    inline constexpr std::size_t index_of(std::size_t pos) const noexcept {
+        return capped_mod(pos + SIZE - tail);
+    }
+
+    /**
+     * \brief   Makes space for an item before the given position, discarding
+     *          the oldest item if full.
+     * \param   pos The storage index to insert before.
+     * \return  The storage index to write the item to, or SIZE if the item
+     *          should be discarded.
+     */
+    std::size_t make_space(std::size_t pos) noexcept;
+
+    /**
+     * \brief   Moves count elements one contiguous run at a time, where the
+     *          destination precedes the source (so may overlap its start).
+     * \param   src     The storage index of the first element to move.
+     * \param   dst     The storage index to move the first element to.
+     * \param   count   The number of elements to move.
+     */
+    void move_toward_tail(std::size_t src, std::size_t dst, std::size_t count) noexcept;
+
+    /**
+     * \brief   Moves count elements one contiguous run at a time, where the
+     *          destination follows the source (so may overlap its end).
+     * \param   src_end The storage index following the last element to move.
+     * \param   dst_end The storage index following the last element's
+     *                  destination.
+     * \param   count   The number of elements to move.
+     */
+    void move_toward_head(std::size_t src_end, std::size_t dst_end, std::size_t count) noexcept;
+
+    /**
+     * \brief   Copies the live elements of other to the start of this buffer's
+     *          storage, replacing this buffer's contents.
+     * \param   other   The buffer to copy from (must not be this buffer).
+     */
+    void copy_live(const circular_buffer& other);
+
+    /**
+     * \brief   Moves the live elements of other to the start of this buffer's
+     *          storage, replacing this buffer's contents and leaving other
+     *          empty.
+     * \param   other   The buffer to move from (must not be this buffer).
+     */
+    void move_live(circular_buffer& other) noexcept;
+
+    /**
+     * \brief   Moves the live elements to the start of this buffer's storage,
+     *          leaving its contents unchanged.
+     */
+    void compact() noexcept;
+
+    /** Move assignment for a heap-backed buffer: exchange storage. */
+    void move_assign(circular_buffer& other, std::true_type) noexcept;
+    /** Move assignment for an inline buffer: move the live elements. */
+    void move_assign(circular_buffer& other, std::false_type) noexcept;
+
+    /** Swap for a heap-backed buffer: exchange storage. */
+    void swap(circular_buffer& other, std::true_type) noexcept;
+    /** Swap for an inline buffer: exchange the live elements in place. */
+    void swap(circular_buffer& other, std::false_type) noexcept;
+
+    /** Ensures inline storage is usable (it always is). */
+    static void allocate(std::array<T, SIZE>&) noexcept {}
+    /** Ensures heap storage is usable, reallocating it if it was moved. */
+    static void allocate(heap_array& storage) { storage.allocate(); }
 };
 
+/**
+ * \brief   Exchanges the contents of two buffers.
+ * \see     circular_buffer::swap(circular_buffer&)
+ */
+template <typename T, std::size_t SIZE, bool HEAP>
+void swap(circular_buffer<T, SIZE, HEAP>& a, circular_buffer<T, SIZE, HEAP>& b) noexcept {
+    a.swap(b);
+}
+
+/** A circular_buffer whose elements are stored on the heap, allowing O(1)
+ *  move and swap. */
+template <typename T, std::size_t SIZE>
+using heap_circular_buffer = circular_buffer<T, SIZE, true>;
+
 #include "circular_buffer.tpp"
 #endif // _COMMON_CIRCULAR_BUFFER_H
\ No newline at end of file
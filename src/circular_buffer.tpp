@@ -25,114 +25,211 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
+#include <algorithm> // copy, min, move, move_backward, rotate, swap_ranges
 #include <stdexcept> // out_of_range
 
 #include "circular_buffer.h"
 
 
-template <typename T, std::size_t SIZE>
-T& circular_buffer<T, SIZE>::iterator::operator*() noexcept {
-    return buffer.buffer[pos];
+template <typename T, std::size_t SIZE, bool HEAP>
+circular_buffer<T, SIZE, HEAP>::circular_buffer(const circular_buffer& other) {
+    copy_live(other);
 }
-template <typename T, std::size_t SIZE>
-void circular_buffer<T, SIZE>::iterator::operator++() noexcept {
-    pos = buffer.capped_mod(pos + 1);
+
+template <typename T, std::size_t SIZE, bool HEAP>
+circular_buffer<T, SIZE, HEAP>::circular_buffer(circular_buffer&& other) noexcept
+        : circular_buffer(std::move(other), std::integral_constant<bool, HEAP>()) {}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+circular_buffer<T, SIZE, HEAP>::circular_buffer(circular_buffer&& other, std::true_type) noexcept
+        : buffer(std::move(other.buffer))
+        , head(other.head)
+        , tail(other.tail) {
+    other.head = other.tail = 0;
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+circular_buffer<T, SIZE, HEAP>::circular_buffer(circular_buffer&& other, std::false_type) noexcept {
+    move_live(other);
 }
-template <typename T, std::size_t SIZE>
-const bool circular_buffer<T, SIZE>::iterator::operator==(const iterator& other) noexcept {
-    return &buffer == &other.buffer && pos == other.pos;
+
+template <typename T, std::size_t SIZE, bool HEAP>
+circular_buffer<T, SIZE, HEAP>& circular_buffer<T, SIZE, HEAP>::operator=(const circular_buffer& other) {
+    if (this != &other) {
+        allocate(buffer);
+        copy_live(other);
+    }
+    return *this;
 }
-template <typename T, std::size_t SIZE>
-const bool circular_buffer<T, SIZE>::iterator::operator!=(const iterator& other) noexcept {
-    return !operator==(other);
+
+template <typename T, std::size_t SIZE, bool HEAP>
+circular_buffer<T, SIZE, HEAP>& circular_buffer<T, SIZE, HEAP>::operator=(circular_buffer&& other) noexcept {
+    if (this != &other) {
+        move_assign(other, std::integral_constant<bool, HEAP>());
+    }
+    return *this;
 }
 
-template <typename T, std::size_t SIZE>
-const T& circular_buffer<T, SIZE>::const_iterator::operator*() noexcept {
-    return buffer.buffer[pos];
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::swap(circular_buffer& other) noexcept {
+    if (this != &other) {
+        swap(other, std::integral_constant<bool, HEAP>());
+    }
 }
-template <typename T, std::size_t SIZE>
-void circular_buffer<T, SIZE>::const_iterator::operator++() noexcept {
-    pos = buffer.capped_mod(pos + 1);
+
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::copy_live(const circular_buffer& other) {
+    // The live elements occupy at most two contiguous runs: from the tail
+    // towards the end of the storage, then from the start of the storage.
+    const std::size_t n = other.len();
+    const std::size_t first = std::min(n, SIZE - other.tail);
+    T* out = std::copy(&other.buffer[other.tail], &other.buffer[other.tail] + first, &buffer[0]);
+    std::copy(&other.buffer[0], &other.buffer[0] + (n - first), out);
+    tail = 0;
+    head = n;
 }
-template <typename T, std::size_t SIZE>
-const bool circular_buffer<T, SIZE>::const_iterator::operator==(const const_iterator& other) noexcept {
-    return &buffer == &other.buffer && pos == other.pos;
+
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::move_live(circular_buffer& other) noexcept {
+    const std::size_t n = other.len();
+    const std::size_t first = std::min(n, SIZE - other.tail);
+    T* out = std::move(&other.buffer[other.tail], &other.buffer[other.tail] + first, &buffer[0]);
+    std::move(&other.buffer[0], &other.buffer[0] + (n - first), out);
+    tail = 0;
+    head = n;
+    other.head = other.tail = 0;
 }
-template <typename T, std::size_t SIZE>
-const bool circular_buffer<T, SIZE>::const_iterator::operator!=(const const_iterator& other) noexcept {
-    return !operator==(other);
+
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::compact() noexcept {
+    const std::size_t n = len();
+    if (tail == 0) {
+        return;
+    }
+    if (tail <= head) {
+        std::move(&buffer[tail], &buffer[head], &buffer[0]);
+    } else {
+        // Wrapped: rotating the storage brings the run from the tail to the
+        // start, followed by the run from the old start.
+        std::rotate(&buffer[0], &buffer[tail], &buffer[0] + SIZE);
+    }
+    tail = 0;
+    head = n;
 }
 
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::move_assign(circular_buffer& other, std::true_type) noexcept {
+    swap(other, std::true_type());
+}
 
-template <typename T, std::size_t SIZE>
-bool circular_buffer<T, SIZE>::full() const noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::move_assign(circular_buffer& other, std::false_type) noexcept {
+    move_live(other);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::swap(circular_buffer& other, std::true_type) noexcept {
+    buffer.swap(other.buffer);
+    std::swap(head, other.head);
+    std::swap(tail, other.tail);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::swap(circular_buffer& other, std::false_type) noexcept {
+    // A temporary buffer would need sizeof(*this) of stack, so exchange the
+    // elements in place: once both are compacted, swap the common prefix and
+    // move the remainder of the longer buffer across.
+    compact();
+    other.compact();
+    circular_buffer& longer = head < other.head ? other : *this;
+    circular_buffer& shorter = head < other.head ? *this : other;
+    const std::size_t common = shorter.head;
+    std::swap_ranges(&buffer[0], &buffer[0] + common, &other.buffer[0]);
+    std::move(&longer.buffer[common], &longer.buffer[longer.head], &shorter.buffer[common]);
+    std::swap(head, other.head);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+bool circular_buffer<T, SIZE, HEAP>::full() const noexcept {
     return capped_mod(head + 1) == tail;
 }
 
-template <typename T, std::size_t SIZE>
-bool circular_buffer<T, SIZE>::empty() const noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+bool circular_buffer<T, SIZE, HEAP>::empty() const noexcept {
     return head == tail;
 }
 
-template <typename T, std::size_t SIZE>
-std::size_t circular_buffer<T, SIZE>::len() const noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+std::size_t circular_buffer<T, SIZE, HEAP>::len() const noexcept {
     return (head < tail) ? (head + SIZE) - tail : head - tail;
 }
 
-template <typename T, std::size_t SIZE>
-constexpr std::size_t circular_buffer<T, SIZE>::capacity() const noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+constexpr std::size_t circular_buffer<T, SIZE, HEAP>::capacity() const noexcept {
     return SIZE - 1;
 }
 
-template <typename T, std::size_t SIZE>
-const T& circular_buffer<T, SIZE>::at(std::size_t pos) const noexcept(false) {
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::memory_usage_info circular_buffer<T, SIZE, HEAP>::memory_usage() const noexcept {
+    memory_usage_info usage;
+    const std::size_t live = len();
+    usage.object_bytes = sizeof(*this);
+    usage.heap_bytes = HEAP ? SIZE * sizeof(T) : 0;
+    usage.used_bytes = live * sizeof(T);
+    usage.slack_bytes = (SIZE - live) * sizeof(T);
+    usage.overhead_per_element = live == 0 ? 0.0 :
+            static_cast<double>(usage.object_bytes + usage.heap_bytes - usage.used_bytes) / live;
+    return usage;
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+const T& circular_buffer<T, SIZE, HEAP>::at(std::size_t pos) const noexcept(false) {
     if (pos >= len()) {
         throw std::out_of_range("Out of range access to circular_buffer");
     }
     return operator[](pos);
 }
 
-template <typename T, std::size_t SIZE>
-T& circular_buffer<T, SIZE>::at(std::size_t pos) noexcept(false) {
+template <typename T, std::size_t SIZE, bool HEAP>
+T& circular_buffer<T, SIZE, HEAP>::at(std::size_t pos) noexcept(false) {
     if (pos >= len()) {
         throw std::out_of_range("Out of range access to circular_buffer");
     }
     return operator[](pos);
 }
 
-template <typename T, std::size_t SIZE>
-const T& circular_buffer<T, SIZE>::operator[](std::size_t pos) const noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+const T& circular_buffer<T, SIZE, HEAP>::operator[](std::size_t pos) const noexcept {
     return buffer[capped_mod(tail + pos)];
 }
 
-template <typename T, std::size_t SIZE>
-T& circular_buffer<T, SIZE>::operator[](std::size_t pos) noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+T& circular_buffer<T, SIZE, HEAP>::operator[](std::size_t pos) noexcept {
     return buffer[capped_mod(tail + pos)];
 }
 
-template <typename T, std::size_t SIZE>
-const T& circular_buffer<T, SIZE>::back() const noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+const T& circular_buffer<T, SIZE, HEAP>::back() const noexcept {
     return buffer[capped_mod(head + SIZE - 1)];
 }
 
-template <typename T, std::size_t SIZE>
-T& circular_buffer<T, SIZE>::back() noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+T& circular_buffer<T, SIZE, HEAP>::back() noexcept {
     return buffer[capped_mod(head + SIZE - 1)];
 }
 
-template <typename T, std::size_t SIZE>
-const T& circular_buffer<T, SIZE>::front() const noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+const T& circular_buffer<T, SIZE, HEAP>::front() const noexcept {
     return buffer[tail];
 }
 
-template <typename T, std::size_t SIZE>
-T& circular_buffer<T, SIZE>::front() noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+T& circular_buffer<T, SIZE, HEAP>::front() noexcept {
     return buffer[tail];
 }
 
-template <typename T, std::size_t SIZE>
-void circular_buffer<T, SIZE>::push_back(const T& item) noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::push_back(const T& item) noexcept {
     buffer[head] = item;
     head = capped_mod(head + 1);
     if (head == tail) {
@@ -140,8 +237,8 @@ void circular_buffer<T, SIZE>::push_back(const T& item) noexcept {
     }
 }
 
-template <typename T, std::size_t SIZE>
-void circular_buffer<T, SIZE>::push_back(T&& item) noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::push_back(T&& item) noexcept {
     std::swap(buffer[head], item);
     head = capped_mod(head + 1);
     if (head == tail) {
@@ -149,32 +246,183 @@ void circular_buffer<T, SIZE>::push_back(T&& item) noexcept {
     }
 }
 
-template <typename T, std::size_t SIZE>
-void circular_buffer<T, SIZE>::pop_back() noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::push_back(const T* items, std::size_t count) noexcept {
+    if (count > SIZE - 1) {
+        items += count - (SIZE - 1);
+        count = SIZE - 1;
+    }
+    const std::size_t live = len();
+    const std::size_t overflow = live + count > SIZE - 1 ? live + count - (SIZE - 1) : 0;
+    const std::size_t run = std::min(count, SIZE - head);
+    std::copy(items, items + run, &buffer[head]);
+    std::copy(items + run, items + count, &buffer[0]);
+    head = capped_mod(head + count);
+    tail = capped_mod(tail + overflow);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::pop_back() noexcept {
     head = capped_mod(head + SIZE - 1);
 }
 
-template <typename T, std::size_t SIZE>
-void circular_buffer<T, SIZE>::pop_front() noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::pop_front() noexcept {
     tail = capped_mod(tail + 1);
 }
 
-template <typename T, std::size_t SIZE>
-typename circular_buffer<T, SIZE>::iterator circular_buffer<T, SIZE>::begin() noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::pop_front(std::size_t count) noexcept {
+    tail = capped_mod(tail + count);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+std::pair<const T*, std::size_t> circular_buffer<T, SIZE, HEAP>::array_one() const noexcept {
+    return std::make_pair(&buffer[tail], (head < tail) ? SIZE - tail : head - tail);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+std::pair<T*, std::size_t> circular_buffer<T, SIZE, HEAP>::array_one() noexcept {
+    return std::make_pair(&buffer[tail], (head < tail) ? SIZE - tail : head - tail);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+std::pair<const T*, std::size_t> circular_buffer<T, SIZE, HEAP>::array_two() const noexcept {
+    return std::make_pair(&buffer[0], (head < tail) ? head : 0);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+std::pair<T*, std::size_t> circular_buffer<T, SIZE, HEAP>::array_two() noexcept {
+    return std::make_pair(&buffer[0], (head < tail) ? head : 0);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::iterator circular_buffer<T, SIZE, HEAP>::insert(iterator pos, const T& item) noexcept {
+    const std::size_t slot = make_space(pos.pos);
+    if (slot == SIZE) {
+        return begin();
+    }
+    buffer[slot] = item;
+    return iterator(*this, slot);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::iterator circular_buffer<T, SIZE, HEAP>::insert(iterator pos, T&& item) noexcept {
+    const std::size_t slot = make_space(pos.pos);
+    if (slot == SIZE) {
+        return begin();
+    }
+    buffer[slot] = std::move(item);
+    return iterator(*this, slot);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::iterator circular_buffer<T, SIZE, HEAP>::erase(iterator pos) noexcept {
+    iterator last = pos;
+    ++last;
+    return erase(pos, last);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::iterator circular_buffer<T, SIZE, HEAP>::erase(iterator first, iterator last) noexcept {
+    const std::size_t begin_index = index_of(first.pos);
+    const std::size_t end_index = index_of(last.pos);
+    const std::size_t count = end_index - begin_index;
+    if (count == 0) {
+        return last;
+    }
+    if (begin_index < len() - end_index) {
+        // Fewer elements before the range: shift them up over it.
+        move_toward_head(first.pos, last.pos, begin_index);
+        tail = capped_mod(tail + count);
+        return last;
+    } else {
+        // Fewer elements after the range: shift them down over it.
+        move_toward_tail(last.pos, first.pos, len() - end_index);
+        head = capped_mod(head + SIZE - count);
+        return first;
+    }
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::iterator circular_buffer<T, SIZE, HEAP>::begin() noexcept {
     return iterator(*this, tail);
 }
 
-template <typename T, std::size_t SIZE>
-typename circular_buffer<T, SIZE>::const_iterator circular_buffer<T, SIZE>::begin() const noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::const_iterator circular_buffer<T, SIZE, HEAP>::begin() const noexcept {
     return const_iterator(*this, tail);
 }
 
-template <typename T, std::size_t SIZE>
-typename circular_buffer<T, SIZE>::iterator circular_buffer<T, SIZE>::end() noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::iterator circular_buffer<T, SIZE, HEAP>::end() noexcept {
     return iterator(*this, head);
 }
 
-template <typename T, std::size_t SIZE>
-typename circular_buffer<T, SIZE>::const_iterator circular_buffer<T, SIZE>::end() const noexcept {
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::const_iterator circular_buffer<T, SIZE, HEAP>::end() const noexcept {
     return const_iterator(*this, head);
 }
+
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::const_iterator circular_buffer<T, SIZE, HEAP>::cbegin() const noexcept {
+    return begin();
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+typename circular_buffer<T, SIZE, HEAP>::const_iterator circular_buffer<T, SIZE, HEAP>::cend() const noexcept {
+    return end();
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+std::size_t circular_buffer<T, SIZE, HEAP>::make_space(std::size_t pos) noexcept {
+    std::size_t index = index_of(pos);
+    if (full()) {
+        // Behave as push_back does: the oldest element makes way.
+        if (index == 0) {
+            return SIZE;
+        }
+        pop_front();
+        index--;
+    }
+    if (index < len() - index) {
+        const std::size_t new_tail = capped_mod(tail + SIZE - 1);
+        move_toward_tail(tail, new_tail, index);
+        tail = new_tail;
+    } else {
+        const std::size_t new_head = capped_mod(head + 1);
+        move_toward_head(head, new_head, len() - index);
+        head = new_head;
+    }
+    return capped_mod(tail + index);
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::move_toward_tail(std::size_t src, std::size_t dst, std::size_t count) noexcept {
+    while (count > 0) {
+        const std::size_t run = std::min(count, std::min(SIZE - src, SIZE - dst));
+        std::move(&buffer[src], &buffer[src] + run, &buffer[dst]);
+        src = capped_mod(src + run);
+        dst = capped_mod(dst + run);
+        count -= run;
+    }
+}
+
+template <typename T, std::size_t SIZE, bool HEAP>
+void circular_buffer<T, SIZE, HEAP>::move_toward_head(std::size_t src_end, std::size_t dst_end, std::size_t count) noexcept {
+    // Work backwards from the ends so overlapping elements are moved before
+    // they are overwritten. An end of 0 is the end of the storage.
+    while (count > 0) {
+        if (src_end == 0) {
+            src_end = SIZE;
+        }
+        if (dst_end == 0) {
+            dst_end = SIZE;
+        }
+        const std::size_t run = std::min(count, std::min(src_end, dst_end));
+        std::move_backward(&buffer[src_end - run], &buffer[0] + src_end, &buffer[0] + dst_end);
+        src_end -= run;
+        dst_end -= run;
+        count -= run;
+    }
+}
@@ -0,0 +1,374 @@
+/**
+ * \file   circular_buffer_2d.h
+ * \author Jonathan Simmonds
+ * \brief  Two dimensional toroidal Circular Buffer for scrolling grids.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_CIRCULAR_BUFFER_2D_H
+#define _COMMON_CIRCULAR_BUFFER_2D_H
+
+#include <algorithm>    // copy, fill
+#include <cstddef>      // ptrdiff_t
+#include <cstdlib>      // size_t
+#include <memory>       // unique_ptr
+
+
+/**
+ * \brief   A run of (possibly strided) elements of a circular_buffer_2d.
+ */
+template <typename T>
+struct grid_span {
+    /** The first element. */
+    T* data;
+    /** The number of elements. */
+    std::size_t size;
+    /** The distance between consecutive elements (1 for a row, the grid width
+     *  for a column). */
+    std::size_t stride;
+
+    T& operator[](std::size_t i) const noexcept {
+        return data[i * stride];
+    }
+};
+
+/**
+ * \brief   A row or column of a circular_buffer_2d: the elements of first
+ *          followed by those of second. second is empty unless the row or
+ *          column wraps around the edge of the storage.
+ */
+template <typename T>
+struct grid_line {
+    grid_span<T> first;
+    grid_span<T> second;
+
+    /** \return The number of elements. */
+    std::size_t size() const noexcept {
+        return first.size + second.size;
+    }
+
+    T& operator[](std::size_t i) const noexcept {
+        return i < first.size ? first[i] : second[i - first.size];
+    }
+};
+
+/**
+ * \brief   Two dimensional analogue of circular_buffer: a fixed size grid
+ *          which wraps independently in x and y, for scrolling views such as
+ *          spectrograms or sliding windows of tiles.
+ *
+ * The grid is a window onto a torus. Scrolling moves the window's origin, so
+ * it is O(1) (or O(the cells scrolled in) when they are also cleared) rather
+ * than moving every cell: after <tt>scroll_y(1)</tt> the old row 1 is row 0
+ * and the old row 0, now the last row, is ready to be overwritten with new
+ * data. Each row is at most two contiguous runs of storage, and each column
+ * at most two strided runs.
+ *
+ * \param T         The type stored in this buffer. Must have a default
+ *                  constructor.
+ * \param WIDTH     The number of columns.
+ * \param HEIGHT    The number of rows.
+ */
+template <typename T, std::size_t WIDTH, std::size_t HEIGHT>
+class circular_buffer_2d {
+    static_assert(WIDTH > 0 && HEIGHT > 0, "WIDTH and HEIGHT must be > 0");
+
+public:
+    /** The type this buffer stores. */
+    using value_type = T;
+
+    /**
+     * \brief   Constructor, initialising every cell by default construction.
+     *          The cells are stored on the heap.
+     */
+    circular_buffer_2d() : cells(new T[WIDTH * HEIGHT]()) {}
+
+    /**
+     * \brief   Copy constructor.
+     * \param   other   The buffer to copy.
+     */
+    circular_buffer_2d(const circular_buffer_2d& other)
+            : cells(new T[WIDTH * HEIGHT]), origin_x(other.origin_x), origin_y(other.origin_y) {
+        std::copy(other.cells.get(), other.cells.get() + WIDTH * HEIGHT, cells.get());
+    }
+
+    /**
+     * \brief   Move constructor. The moved-from buffer has no cells, so may
+     *          only be assigned to or destroyed.
+     * \param   other   The buffer to move.
+     */
+    circular_buffer_2d(circular_buffer_2d&& other) noexcept = default;
+
+    /**
+     * \brief   Copy assignment.
+     * \param   other   The buffer to copy.
+     * \return  This buffer.
+     */
+    circular_buffer_2d& operator=(const circular_buffer_2d& other) {
+        if (!cells) {
+            // This buffer was moved from.
+            cells.reset(new T[WIDTH * HEIGHT]);
+        }
+        std::copy(other.cells.get(), other.cells.get() + WIDTH * HEIGHT, cells.get());
+        origin_x = other.origin_x;
+        origin_y = other.origin_y;
+        return *this;
+    }
+
+    circular_buffer_2d& operator=(circular_buffer_2d&& other) noexcept = default;
+
+    /** \return The number of columns. */
+    constexpr std::size_t width() const noexcept { return WIDTH; }
+
+    /** \return The number of rows. */
+    constexpr std::size_t height() const noexcept { return HEIGHT; }
+
+    /**
+     * \brief   Retrieves the cell at the given position of the window.
+     * \param   x   The column, which must be < WIDTH.
+     * \param   y   The row, which must be < HEIGHT.
+     * \return  Reference to the cell.
+     */
+    T& operator()(std::size_t x, std::size_t y) noexcept {
+        return cells[index(x, y)];
+    }
+
+    /**
+     * \brief   Retrieves the cell at the given position of the window.
+     * \param   x   The column, which must be < WIDTH.
+     * \param   y   The row, which must be < HEIGHT.
+     * \return  Reference to the cell.
+     */
+    const T& operator()(std::size_t x, std::size_t y) const noexcept {
+        return cells[index(x, y)];
+    }
+
+    /**
+     * \brief   Scrolls the window horizontally: column n becomes column 0 and
+     *          the columns scrolled past wrap around to the other side, keeping
+     *          their old contents.
+     * \param   n   The number of columns to scroll by (negative to scroll the
+     *              other way).
+     */
+    void scroll_x(std::ptrdiff_t n) noexcept {
+        origin_x = wrap<WIDTH>(origin_x, n);
+    }
+
+    /**
+     * \brief   Scrolls the window horizontally, filling the columns scrolled in
+     *          with the given value.
+     * \param   n       The number of columns to scroll by.
+     * \param   fill    The value for the new columns.
+     */
+    void scroll_x(std::ptrdiff_t n, const T& fill) {
+        scroll_x(n);
+        const std::size_t count = magnitude(n, WIDTH);
+        for (std::size_t i = 0; i < count; i++) {
+            fill_column(n > 0 ? WIDTH - 1 - i : i, fill);
+        }
+    }
+
+    /**
+     * \brief   Scrolls the window vertically: row n becomes row 0 and the rows
+     *          scrolled past wrap around to the other side, keeping their old
+     *          contents.
+     * \param   n   The number of rows to scroll by (negative to scroll the
+     *              other way).
+     */
+    void scroll_y(std::ptrdiff_t n) noexcept {
+        origin_y = wrap<HEIGHT>(origin_y, n);
+    }
+
+    /**
+     * \brief   Scrolls the window vertically, filling the rows scrolled in
+     *          with the given value.
+     * \param   n       The number of rows to scroll by.
+     * \param   fill    The value for the new rows.
+     */
+    void scroll_y(std::ptrdiff_t n, const T& fill) {
+        scroll_y(n);
+        const std::size_t count = magnitude(n, HEIGHT);
+        for (std::size_t i = 0; i < count; i++) {
+            const grid_line<T> line = row(n > 0 ? HEIGHT - 1 - i : i);
+            std::fill(line.first.data, line.first.data + line.first.size, fill);
+            std::fill(line.second.data, line.second.data + line.second.size, fill);
+        }
+    }
+
+    /**
+     * \brief   Retrieves a row of the window.
+     * \param   y   The row, which must be < HEIGHT.
+     * \return  The row, as up to two contiguous runs.
+     */
+    grid_line<T> row(std::size_t y) noexcept {
+        T* start = &cells[capped_mod<HEIGHT>(origin_y + y) * WIDTH];
+        grid_line<T> line = {
+            { start + origin_x, WIDTH - origin_x, 1 },
+            { start, origin_x, 1 }
+        };
+        return line;
+    }
+
+    /**
+     * \brief   Retrieves a row of the window.
+     * \param   y   The row, which must be < HEIGHT.
+     * \return  The row, as up to two contiguous runs.
+     */
+    grid_line<const T> row(std::size_t y) const noexcept {
+        const T* start = &cells[capped_mod<HEIGHT>(origin_y + y) * WIDTH];
+        grid_line<const T> line = {
+            { start + origin_x, WIDTH - origin_x, 1 },
+            { start, origin_x, 1 }
+        };
+        return line;
+    }
+
+    /**
+     * \brief   Retrieves a column of the window.
+     * \param   x   The column, which must be < WIDTH.
+     * \return  The column, as up to two runs with a stride of WIDTH.
+     */
+    grid_line<T> column(std::size_t x) noexcept {
+        T* start = &cells[capped_mod<WIDTH>(origin_x + x)];
+        grid_line<T> line = {
+            { start + origin_y * WIDTH, HEIGHT - origin_y, WIDTH },
+            { start, origin_y, WIDTH }
+        };
+        return line;
+    }
+
+    /**
+     * \brief   Retrieves a column of the window.
+     * \param   x   The column, which must be < WIDTH.
+     * \return  The column, as up to two runs with a stride of WIDTH.
+     */
+    grid_line<const T> column(std::size_t x) const noexcept {
+        const T* start = &cells[capped_mod<WIDTH>(origin_x + x)];
+        grid_line<const T> line = {
+            { start + origin_y * WIDTH, HEIGHT - origin_y, WIDTH },
+            { start, origin_y, WIDTH }
+        };
+        return line;
+    }
+
+    /**
+     * \brief   Copies WIDTH values into a row of the window.
+     * \param   y       The row, which must be < HEIGHT.
+     * \param   values  The values, for columns 0 to WIDTH - 1.
+     */
+    void write_row(std::size_t y, const T* values) {
+        const grid_line<T> line = row(y);
+        std::copy(values, values + line.first.size, line.first.data);
+        std::copy(values + line.first.size, values + WIDTH, line.second.data);
+    }
+
+    /**
+     * \brief   Copies HEIGHT values into a column of the window.
+     * \param   x       The column, which must be < WIDTH.
+     * \param   values  The values, for rows 0 to HEIGHT - 1.
+     */
+    void write_column(std::size_t x, const T* values) {
+        const grid_line<T> line = column(x);
+        for (std::size_t i = 0; i < line.first.size; i++) {
+            line.first[i] = values[i];
+        }
+        for (std::size_t i = 0; i < line.second.size; i++) {
+            line.second[i] = values[line.first.size + i];
+        }
+    }
+
+    /**
+     * \brief   Scrolls the window down one row and writes the new last row,
+     *          e.g. to add the latest frame of a spectrogram.
+     * \param   values  The WIDTH values of the new row.
+     */
+    void push_row(const T* values) {
+        scroll_y(1);
+        write_row(HEIGHT - 1, values);
+    }
+
+    /**
+     * \brief   Scrolls the window right one column and writes the new last
+     *          column.
+     * \param   values  The HEIGHT values of the new column.
+     */
+    void push_column(const T* values) {
+        scroll_x(1);
+        write_column(WIDTH - 1, values);
+    }
+
+private:
+    /**
+     * \brief   Performs the calculation (x % N) for 0 <= x < 2 * N.
+     * \param   x   x in the calculation.
+     * \return  The solution to the calculation.
+     */
+    template <std::size_t N>
+    static constexpr std::size_t capped_mod(std::size_t x) noexcept {
+        return x < N ? x : x - N;
+    }
+
+    /**
+     * \brief   Moves an origin by a signed offset, modulo N.
+     * \param   origin  The origin, < N.
+     * \param   n       The offset.
+     * \return  The new origin.
+     */
+    template <std::size_t N>
+    static std::size_t wrap(std::size_t origin, std::ptrdiff_t n) noexcept {
+        const std::size_t step = abs_value(n) % N;
+        return n >= 0 ? capped_mod<N>(origin + step) : capped_mod<N>(origin + N - step);
+    }
+
+    /** The number of lines scrolled by an offset, at most the size of the
+     *  axis (as scrolling further revisits the same lines). */
+    static std::size_t magnitude(std::ptrdiff_t n, std::size_t size) noexcept {
+        const std::size_t m = abs_value(n);
+        return m < size ? m : size;
+    }
+
+    /** |n|, without overflow for the most negative n. */
+    static std::size_t abs_value(std::ptrdiff_t n) noexcept {
+        return n >= 0 ? static_cast<std::size_t>(n) : static_cast<std::size_t>(-(n + 1)) + 1;
+    }
+
+    std::size_t index(std::size_t x, std::size_t y) const noexcept {
+        return capped_mod<HEIGHT>(origin_y + y) * WIDTH + capped_mod<WIDTH>(origin_x + x);
+    }
+
+    void fill_column(std::size_t x, const T& fill) {
+        const grid_line<T> line = column(x);
+        for (std::size_t i = 0; i < line.size(); i++) {
+            line[i] = fill;
+        }
+    }
+
+    /** The cells, row-major. */
+    std::unique_ptr<T[]> cells;
+    /** The storage column of column 0 of the window. */
+    std::size_t origin_x = 0;
+    /** The storage row of row 0 of the window. */
+    std::size_t origin_y = 0;
+};
+
+#endif // _COMMON_CIRCULAR_BUFFER_2D_H
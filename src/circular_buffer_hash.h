@@ -0,0 +1,401 @@
+/**
+ * \file   circular_buffer_hash.h
+ * \author Jonathan Simmonds
+ * \brief  CRC32C and XXH64 over byte arrays and circular_buffer contents.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_CIRCULAR_BUFFER_HASH_H
+#define _COMMON_CIRCULAR_BUFFER_HASH_H
+
+#include <cstdint>      // uint32_t, uint64_t
+#include <cstdlib>      // size_t
+#include <cstring>      // memcpy
+#include <type_traits>  // is_trivially_copyable
+#include <utility>      // pair
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>  // _mm_crc32_*
+#endif
+
+#include "circular_buffer.h"
+
+
+namespace circular_buffer_hash_detail {
+
+/** The lookup tables for the portable CRC32C, processing 8 bytes at a time
+ *  (slicing-by-8). */
+struct crc32c_tables {
+    std::uint32_t t[8][256];
+
+    crc32c_tables() noexcept {
+        // The reflected Castagnoli polynomial.
+        const std::uint32_t POLY = 0x82F63B78u;
+        for (std::uint32_t i = 0; i < 256; i++) {
+            std::uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (POLY & (0u - (crc & 1)));
+            }
+            t[0][i] = crc;
+        }
+        for (std::uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+
+    static const crc32c_tables& get() noexcept {
+        static const crc32c_tables tables;
+        return tables;
+    }
+};
+
+/**
+ * \brief   Advances a (pre-inverted) CRC32C over an array.
+ * \param   crc     The CRC so far, inverted.
+ * \param   p       The array.
+ * \param   n       The length of the array.
+ * \return  The new CRC, inverted.
+ */
+inline std::uint32_t crc32c_update(std::uint32_t crc, const unsigned char* p, std::size_t n) noexcept {
+#if defined(__SSE4_2__)
+#if defined(__x86_64__) || defined(_M_X64)
+    std::uint64_t crc64 = crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+#endif
+    for (; n >= 4; p += 4, n -= 4) {
+        std::uint32_t word;
+        std::memcpy(&word, p, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; n > 0; p++, n--) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    return crc;
+#else
+    const crc32c_tables& tables = crc32c_tables::get();
+    const std::uint32_t (&t)[8][256] = tables.t;
+    for (; n >= 8; p += 8, n -= 8) {
+        const std::uint32_t lo = crc ^ (static_cast<std::uint32_t>(p[0]) | static_cast<std::uint32_t>(p[1]) << 8 |
+                                        static_cast<std::uint32_t>(p[2]) << 16 | static_cast<std::uint32_t>(p[3]) << 24);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; n > 0; p++, n--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+    }
+    return crc;
+#endif
+}
+
+static const std::uint64_t XXH_P1 = 11400714785074694791ULL;
+static const std::uint64_t XXH_P2 = 14029467366897019727ULL;
+static const std::uint64_t XXH_P3 = 1609587929392839161ULL;
+static const std::uint64_t XXH_P4 = 9650029242287828579ULL;
+static const std::uint64_t XXH_P5 = 2870177450012600261ULL;
+
+inline std::uint64_t rotl64(std::uint64_t x, int r) noexcept {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline std::uint64_t read64(const unsigned char* p) noexcept {
+    // Little-endian hosts only, as XXH64 is defined over little-endian words.
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline std::uint32_t read32(const unsigned char* p) noexcept {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline std::uint64_t xxh64_round(std::uint64_t acc, std::uint64_t input) noexcept {
+    acc += input * XXH_P2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_P1;
+}
+
+inline std::uint64_t xxh64_merge_round(std::uint64_t acc, std::uint64_t val) noexcept {
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_P1 + XXH_P4;
+}
+
+/**
+ * \brief   Applies a function to each (at most two) contiguous segment of a
+ *          buffer's contents, as bytes.
+ * \param   buf The buffer. Its elements must be trivially copyable.
+ * \param   f   Callable invoked as <tt>f(const void* p, std::size_t bytes)</tt>.
+ */
+template <typename T, std::size_t SIZE, bool HEAP, typename F>
+void for_each_segment(const circular_buffer<T, SIZE, HEAP>& buf, F f) {
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable to be hashed");
+    const std::pair<const T*, std::size_t> one = buf.array_one();
+    const std::pair<const T*, std::size_t> two = buf.array_two();
+    f(static_cast<const void*>(one.first), one.second * sizeof(T));
+    if (two.second != 0) {
+        f(static_cast<const void*>(two.first), two.second * sizeof(T));
+    }
+}
+
+} // namespace circular_buffer_hash_detail
+
+
+/**
+ * \brief   Incremental CRC32C (Castagnoli) checksum. Uses the SSE4.2
+ *          <tt>crc32</tt> instruction when built with SSE4.2 support, or an
+ *          8-bytes-at-a-time table lookup otherwise. Copyable, so a
+ *          checksum may be saved and resumed.
+ */
+class crc32c_state {
+public:
+    /**
+     * \brief   Constructor.
+     * \param   crc     The checksum of any data already processed, to resume
+     *                  from (0 to start afresh).
+     */
+    explicit crc32c_state(std::uint32_t crc = 0) noexcept : crc(~crc) {}
+
+    /**
+     * \brief   Adds data to the checksum.
+     * \param   data    The data.
+     * \param   len     The length of the data in bytes.
+     */
+    void update(const void* data, std::size_t len) noexcept {
+        crc = circular_buffer_hash_detail::crc32c_update(crc, static_cast<const unsigned char*>(data), len);
+    }
+
+    /**
+     * \brief   Adds the contents of a buffer (its elements' bytes, front to
+     *          back) to the checksum.
+     * \param   buf     The buffer. Its elements must be trivially copyable.
+     */
+    template <typename T, std::size_t SIZE, bool HEAP>
+    void update(const circular_buffer<T, SIZE, HEAP>& buf) noexcept {
+        circular_buffer_hash_detail::for_each_segment(buf, [this](const void* p, std::size_t n) {
+            update(p, n);
+        });
+    }
+
+    /**
+     * \brief   Retrieves the checksum of the data added so far.
+     * \return  The CRC32C.
+     */
+    std::uint32_t value() const noexcept {
+        return ~crc;
+    }
+
+private:
+    /** The running CRC, inverted. */
+    std::uint32_t crc;
+};
+
+/**
+ * \brief   Calculates the CRC32C of an array.
+ * \param   data    The data.
+ * \param   len     The length of the data in bytes.
+ * \param   crc     The checksum of any preceding data (0 if none).
+ * \return  The CRC32C.
+ */
+inline std::uint32_t crc32c(const void* data, std::size_t len, std::uint32_t crc = 0) noexcept {
+    crc32c_state state(crc);
+    state.update(data, len);
+    return state.value();
+}
+
+/**
+ * \brief   Calculates the CRC32C of the contents of a buffer.
+ * \param   buf     The buffer. Its elements must be trivially copyable.
+ * \param   crc     The checksum of any preceding data (0 if none).
+ * \return  The CRC32C.
+ */
+template <typename T, std::size_t SIZE, bool HEAP>
+std::uint32_t crc32c(const circular_buffer<T, SIZE, HEAP>& buf, std::uint32_t crc = 0) noexcept {
+    crc32c_state state(crc);
+    state.update(buf);
+    return state.value();
+}
+
+
+/**
+ * \brief   Incremental XXH64 hash. Data may be added in pieces of any size,
+ *          giving the same result as hashing it in one piece. Copyable, so a
+ *          hash may be saved and resumed. Little-endian hosts only.
+ */
+class xxhash64_state {
+public:
+    /**
+     * \brief   Constructor.
+     * \param   seed    The seed.
+     */
+    explicit xxhash64_state(std::uint64_t seed = 0) noexcept
+            : seed(seed)
+            , v { seed + circular_buffer_hash_detail::XXH_P1 + circular_buffer_hash_detail::XXH_P2,
+                  seed + circular_buffer_hash_detail::XXH_P2,
+                  seed,
+                  seed - circular_buffer_hash_detail::XXH_P1 } {}
+
+    /**
+     * \brief   Adds data to the hash.
+     * \param   data    The data.
+     * \param   len     The length of the data in bytes.
+     */
+    void update(const void* data, std::size_t len) noexcept {
+        using namespace circular_buffer_hash_detail;
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        total += len;
+        if (pending + len < STRIPE) {
+            std::memcpy(buffer + pending, p, len);
+            pending += len;
+            return;
+        }
+        if (pending != 0) {
+            const std::size_t fill = STRIPE - pending;
+            std::memcpy(buffer + pending, p, fill);
+            consume(buffer);
+            p += fill;
+            len -= fill;
+            pending = 0;
+        }
+        // The four lanes are independent, so the loop runs them in parallel.
+        std::uint64_t v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+        for (; len >= STRIPE; p += STRIPE, len -= STRIPE) {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p + 8));
+            v3 = xxh64_round(v3, read64(p + 16));
+            v4 = xxh64_round(v4, read64(p + 24));
+        }
+        v[0] = v1; v[1] = v2; v[2] = v3; v[3] = v4;
+        std::memcpy(buffer, p, len);
+        pending = len;
+    }
+
+    /**
+     * \brief   Adds the contents of a buffer (its elements' bytes, front to
+     *          back) to the hash.
+     * \param   buf     The buffer. Its elements must be trivially copyable.
+     */
+    template <typename T, std::size_t SIZE, bool HEAP>
+    void update(const circular_buffer<T, SIZE, HEAP>& buf) noexcept {
+        circular_buffer_hash_detail::for_each_segment(buf, [this](const void* p, std::size_t n) {
+            update(p, n);
+        });
+    }
+
+    /**
+     * \brief   Retrieves the hash of the data added so far. More data may
+     *          still be added afterwards.
+     * \return  The XXH64 hash.
+     */
+    std::uint64_t digest() const noexcept {
+        using namespace circular_buffer_hash_detail;
+        std::uint64_t h;
+        if (total >= STRIPE) {
+            h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+            for (int i = 0; i < 4; i++) {
+                h = xxh64_merge_round(h, v[i]);
+            }
+        } else {
+            h = seed + XXH_P5;
+        }
+        h += static_cast<std::uint64_t>(total);
+        const unsigned char* p = buffer;
+        const unsigned char* end = buffer + pending;
+        for (; p + 8 <= end; p += 8) {
+            h ^= xxh64_round(0, read64(p));
+            h = rotl64(h, 27) * XXH_P1 + XXH_P4;
+        }
+        if (p + 4 <= end) {
+            h ^= static_cast<std::uint64_t>(read32(p)) * XXH_P1;
+            h = rotl64(h, 23) * XXH_P2 + XXH_P3;
+            p += 4;
+        }
+        for (; p < end; p++) {
+            h ^= *p * XXH_P5;
+            h = rotl64(h, 11) * XXH_P1;
+        }
+        h ^= h >> 33;
+        h *= XXH_P2;
+        h ^= h >> 29;
+        h *= XXH_P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    /** The number of bytes consumed by each round of the four lanes. */
+    static const std::size_t STRIPE = 32;
+
+    void consume(const unsigned char* p) noexcept {
+        using namespace circular_buffer_hash_detail;
+        v[0] = xxh64_round(v[0], read64(p));
+        v[1] = xxh64_round(v[1], read64(p + 8));
+        v[2] = xxh64_round(v[2], read64(p + 16));
+        v[3] = xxh64_round(v[3], read64(p + 24));
+    }
+
+    std::uint64_t seed;
+    /** The four lane accumulators. */
+    std::uint64_t v[4];
+    /** The total number of bytes added. */
+    std::uint64_t total = 0;
+    /** Bytes not yet forming a whole stripe. */
+    unsigned char buffer[STRIPE];
+    /** The number of bytes in buffer. */
+    std::size_t pending = 0;
+};
+
+/**
+ * \brief   Calculates the XXH64 hash of an array.
+ * \param   data    The data.
+ * \param   len     The length of the data in bytes.
+ * \param   seed    The seed.
+ * \return  The XXH64 hash.
+ */
+inline std::uint64_t xxhash64(const void* data, std::size_t len, std::uint64_t seed = 0) noexcept {
+    xxhash64_state state(seed);
+    state.update(data, len);
+    return state.digest();
+}
+
+/**
+ * \brief   Calculates the XXH64 hash of the contents of a buffer.
+ * \param   buf     The buffer. Its elements must be trivially copyable.
+ * \param   seed    The seed.
+ * \return  The XXH64 hash.
+ */
+template <typename T, std::size_t SIZE, bool HEAP>
+std::uint64_t xxhash64(const circular_buffer<T, SIZE, HEAP>& buf, std::uint64_t seed = 0) noexcept {
+    xxhash64_state state(seed);
+    state.update(buf);
+    return state.digest();
+}
+
+#endif // _COMMON_CIRCULAR_BUFFER_HASH_H
@@ -0,0 +1,298 @@
+/**
+ * \file   circular_buffer_scan.h
+ * \author Jonathan Simmonds
+ * \brief  SIMD delimiter and line scanning over byte circular_buffers.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_CIRCULAR_BUFFER_SCAN_H
+#define _COMMON_CIRCULAR_BUFFER_SCAN_H
+
+#include <cstdlib>  // size_t
+#include <utility>  // pair
+
+#if defined(__AVX2__)
+#include <immintrin.h>  // _mm256_*
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>  // _mm_*
+#endif
+
+#include "circular_buffer.h"
+
+
+/**
+ * \brief   A contiguous run of bytes.
+ */
+struct byte_span {
+    /** The first byte. */
+    const char* data;
+    /** The number of bytes. */
+    std::size_t size;
+};
+
+namespace circular_buffer_scan_detail {
+
+/**
+ * \brief   Finds the index of the lowest set bit.
+ * \param   x   The (non-zero) value to search.
+ * \return  The index of the lowest set bit.
+ */
+inline unsigned lowest_bit(unsigned x) noexcept {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctz(x));
+#else
+    unsigned n = 0;
+    for (; !(x & 1); x >>= 1)
+        n++;
+    return n;
+#endif
+}
+
+/**
+ * \brief   Finds the first occurrence of a byte in an array, 32 bytes at a
+ *          time with AVX2 or 16 at a time with SSE2 where available.
+ * \param   p   The array.
+ * \param   n   The length of the array.
+ * \param   c   The byte to find.
+ * \return  The index of the byte, or n if it is not found.
+ */
+inline std::size_t find_byte(const char* p, std::size_t n, char c) noexcept {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i needle32 = _mm256_set1_epi8(c);
+    for (; i + 32 <= n; i += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle32)));
+        if (mask != 0) {
+            return i + lowest_bit(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i needle16 = _mm_set1_epi8(c);
+    for (; i + 16 <= n; i += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle16)));
+        if (mask != 0) {
+            return i + lowest_bit(mask);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (p[i] == c) {
+            return i;
+        }
+    }
+    return n;
+}
+
+/**
+ * \brief   Finds the first occurrence of any of a set of bytes in an array,
+ *          vectorised as find_byte() is.
+ * \param   p       The array.
+ * \param   n       The length of the array.
+ * \param   set     The bytes to find.
+ * \param   set_len The number of bytes in set.
+ * \return  The index of the first byte found, or n if none are found.
+ */
+inline std::size_t find_any_byte(const char* p, std::size_t n, const char* set, std::size_t set_len) noexcept {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= n; i += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i matches = _mm256_setzero_si256();
+        for (std::size_t s = 0; s < set_len; s++) {
+            matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(set[s])));
+        }
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(matches));
+        if (mask != 0) {
+            return i + lowest_bit(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i matches = _mm_setzero_si128();
+        for (std::size_t s = 0; s < set_len; s++) {
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi8(block, _mm_set1_epi8(set[s])));
+        }
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(matches));
+        if (mask != 0) {
+            return i + lowest_bit(mask);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        for (std::size_t s = 0; s < set_len; s++) {
+            if (p[i] == set[s]) {
+                return i;
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * \brief   Applies an array search to the contents of a buffer from a
+ *          logical index, searching each of its (at most two) contiguous
+ *          segments in turn.
+ * \param   buf     The buffer.
+ * \param   from    The logical index to start from.
+ * \param   search  Callable invoked as <tt>search(const char* p, size_t n)</tt>
+ *                  returning the index of the match or n.
+ * \return  The logical index of the match, or <tt>buf.len()</tt>.
+ */
+template <std::size_t SIZE, bool HEAP, typename F>
+std::size_t scan(const circular_buffer<char, SIZE, HEAP>& buf, std::size_t from, F search) noexcept {
+    const std::pair<const char*, std::size_t> one = buf.array_one();
+    const std::pair<const char*, std::size_t> two = buf.array_two();
+    if (from < one.second) {
+        const std::size_t found = search(one.first + from, one.second - from);
+        if (found != one.second - from) {
+            return from + found;
+        }
+        from = one.second;
+    }
+    if (from < one.second + two.second) {
+        const std::size_t offset = from - one.second;
+        return from + search(two.first + offset, two.second - offset);
+    }
+    return one.second + two.second;
+}
+
+} // namespace circular_buffer_scan_detail
+
+
+/**
+ * \brief   Finds the first occurrence of a byte in a buffer.
+ * \param   buf     The buffer.
+ * \param   delim   The byte to find.
+ * \param   from    The logical index to start searching from.
+ * \return  The logical index of the byte, or <tt>buf.len()</tt> if it is not
+ *          found.
+ */
+template <std::size_t SIZE, bool HEAP>
+std::size_t find(const circular_buffer<char, SIZE, HEAP>& buf, char delim, std::size_t from = 0) noexcept {
+    return circular_buffer_scan_detail::scan(buf, from, [delim](const char* p, std::size_t n) {
+        return circular_buffer_scan_detail::find_byte(p, n, delim);
+    });
+}
+
+/**
+ * \brief   Finds the first occurrence of a multi-byte delimiter (e.g.
+ *          <tt>"\r\n"</tt>) in a buffer, including one which straddles the
+ *          end of the storage.
+ * \param   buf         The buffer.
+ * \param   delim       The delimiter.
+ * \param   delim_len   The length of the delimiter. Must be > 0.
+ * \param   from        The logical index to start searching from.
+ * \return  The logical index of the start of the delimiter, or
+ *          <tt>buf.len()</tt> if it is not found.
+ */
+template <std::size_t SIZE, bool HEAP>
+std::size_t find(const circular_buffer<char, SIZE, HEAP>& buf, const char* delim, std::size_t delim_len,
+                 std::size_t from = 0) noexcept {
+    const std::size_t len = buf.len();
+    for (;;) {
+        // Find candidates by their first byte, then check the remainder by
+        // logical index so it may continue across the wrap.
+        const std::size_t pos = find(buf, delim[0], from);
+        if (pos + delim_len > len) {
+            return len;
+        }
+        std::size_t i = 1;
+        while (i < delim_len && buf[pos + i] == delim[i]) {
+            i++;
+        }
+        if (i == delim_len) {
+            return pos;
+        }
+        from = pos + 1;
+    }
+}
+
+/**
+ * \brief   Finds the first occurrence of any of a set of bytes in a buffer.
+ * \param   buf     The buffer.
+ * \param   set     The bytes to find.
+ * \param   set_len The number of bytes in set.
+ * \param   from    The logical index to start searching from.
+ * \return  The logical index of the first byte found, or <tt>buf.len()</tt>
+ *          if none are found.
+ */
+template <std::size_t SIZE, bool HEAP>
+std::size_t find_any(const circular_buffer<char, SIZE, HEAP>& buf, const char* set, std::size_t set_len,
+                     std::size_t from = 0) noexcept {
+    return circular_buffer_scan_detail::scan(buf, from, [set, set_len](const char* p, std::size_t n) {
+        return circular_buffer_scan_detail::find_any_byte(p, n, set, set_len);
+    });
+}
+
+/**
+ * \brief   Splits the complete lines at the front of a buffer, terminated by
+ *          <tt>"\n"</tt> or <tt>"\r\n"</tt>. The buffer is not modified: pass
+ *          the return value to <tt>pop_front()</tt> to consume the lines.
+ * \param   buf     The buffer.
+ * \param   f       Callable invoked as
+ *                  <tt>f(byte_span first, byte_span second)</tt> for each line,
+ *                  in order, where the line (without its terminator) is the
+ *                  bytes of first followed by those of second. second is empty
+ *                  unless the line straddles the end of the storage.
+ * \return  The number of bytes of complete lines, including terminators.
+ */
+template <std::size_t SIZE, bool HEAP, typename F>
+std::size_t split_lines(const circular_buffer<char, SIZE, HEAP>& buf, F f) {
+    const std::pair<const char*, std::size_t> one = buf.array_one();
+    const std::pair<const char*, std::size_t> two = buf.array_two();
+    const std::size_t len = one.second + two.second;
+    std::size_t start = 0;
+    for (;;) {
+        const std::size_t newline = find(buf, '\n', start);
+        if (newline == len) {
+            return start;
+        }
+        std::size_t end = newline;
+        if (end > start && buf[end - 1] == '\r') {
+            end--;
+        }
+        byte_span first = { two.first, 0 };
+        byte_span second = { two.first, 0 };
+        if (start >= one.second) {
+            first.data = two.first + (start - one.second);
+            first.size = end - start;
+        } else if (end <= one.second) {
+            first.data = one.first + start;
+            first.size = end - start;
+        } else {
+            first.data = one.first + start;
+            first.size = one.second - start;
+            second.size = end - one.second;
+        }
+        f(first, second);
+        start = newline + 1;
+    }
+}
+
+#endif // _COMMON_CIRCULAR_BUFFER_SCAN_H
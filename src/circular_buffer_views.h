@@ -0,0 +1,577 @@
+/**
+ * \file   circular_buffer_views.h
+ * \author Jonathan Simmonds
+ * \brief  Lazily evaluated range adaptors over circular_buffer contents.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_CIRCULAR_BUFFER_VIEWS_H
+#define _COMMON_CIRCULAR_BUFFER_VIEWS_H
+
+#include <cstddef>      // ptrdiff_t
+#include <cstdlib>      // size_t
+#include <iterator>     // iterator_traits, *_iterator_tag
+#include <type_traits>  // conditional, decay, enable_if, is_base_of, is_lvalue_reference
+#include <utility>      // declval, forward, move, pair
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<ranges>)
+#include <ranges>       // ranges::view_base, ranges::enable_borrowed_range
+#define _COMMON_CIRCULAR_BUFFER_VIEWS_RANGES 1
+#endif
+#endif
+
+#include "circular_buffer.h"
+
+
+/*
+ * Views over a circular_buffer (or dynamic_circular_buffer) which transform,
+ * filter, trim or stride through its elements lazily, as they are iterated,
+ * rather than building a temporary container. Views compose with the pipe
+ * operator, e.g.:
+ *
+ *     using namespace circular_buffer_views;
+ *     for (double x : buf | filter(is_valid) | transform(to_celsius)) { ... }
+ *
+ * Views are read-only, hold a pointer to the buffer (which must outlive them)
+ * and are cheap to copy. take_last, stride and transform of a buffer keep its
+ * random access iterators. In C++20 they are also std::ranges views, so can be
+ * mixed with the standard adaptors.
+ *
+ * Iterating a view with its iterators steps through the buffer one element at
+ * a time. The for_each() member function is a faster path: views over random
+ * access bases visit the buffer's (at most two) contiguous runs with plain
+ * pointer loops, so the compiler can optimise them as it would a loop over an
+ * array.
+ */
+namespace circular_buffer_views {
+
+#ifdef _COMMON_CIRCULAR_BUFFER_VIEWS_RANGES
+/** The base of every view, marking it as a view for std::ranges. */
+struct view_base : std::ranges::view_base {};
+#else
+/** The base of every view. */
+struct view_base {};
+#endif
+
+namespace detail {
+
+/** Whether V is one of these views. */
+template <typename V>
+using is_view = std::is_base_of<view_base, typename std::decay<V>::type>;
+
+/** An iterator's iterator_concept (as C++20 defines it) if it has one,
+ *  otherwise its iterator_category. */
+template <typename IT, typename = void>
+struct concept_of {
+    using type = typename std::iterator_traits<IT>::iterator_category;
+};
+template <typename IT>
+struct concept_of<IT, decltype(void(std::declval<typename IT::iterator_concept>()))> {
+    using type = typename IT::iterator_concept;
+};
+
+/** The weaker of an iterator concept and forward_iterator_tag. */
+template <typename TAG>
+using at_most_forward = typename std::conditional<
+        std::is_base_of<std::forward_iterator_tag, TAG>::value, std::forward_iterator_tag, TAG>::type;
+
+} // namespace detail
+
+
+/**
+ * \brief   View of every element of a buffer, front to back.
+ * \param BUFFER    The buffer type: circular_buffer or
+ *                  dynamic_circular_buffer.
+ */
+template <typename BUFFER>
+class buffer_view : public view_base {
+public:
+    using iterator = typename BUFFER::const_iterator;
+
+    buffer_view() noexcept : buffer(nullptr) {}
+    explicit buffer_view(const BUFFER& buffer) noexcept : buffer(&buffer) {}
+
+    iterator begin() const noexcept { return buffer->begin(); }
+    iterator end() const noexcept { return buffer->end(); }
+    std::size_t size() const noexcept { return buffer->len(); }
+
+    /**
+     * \brief   Calls g on every element, one contiguous run at a time.
+     * \param   g   Callable invoked as <tt>g(const T&)</tt>.
+     */
+    template <typename G>
+    void for_each(G g) const {
+        for_each_in(0, size(), 1, g);
+    }
+
+    /**
+     * \brief   Calls g on count elements, starting at index first and
+     *          advancing step elements at a time, one contiguous run at a time.
+     * \param   first   The index of the first element.
+     * \param   count   The number of elements to visit.
+     * \param   step    The distance between visited elements.
+     * \param   g       Callable invoked as <tt>g(const T&)</tt>.
+     */
+    template <typename G>
+    void for_each_in(std::size_t first, std::size_t count, std::size_t step, G& g) const {
+        const auto one = buffer->array_one();
+        const auto two = buffer->array_two();
+        std::size_t i = first;
+        for (; count > 0 && i < one.second; i += step, count--) {
+            g(one.first[i]);
+        }
+        if (count == 0) {
+            return;
+        }
+        for (i -= one.second; count > 0; i += step, count--) {
+            g(two.first[i]);
+        }
+    }
+
+private:
+    const BUFFER* buffer;
+};
+
+
+/**
+ * \brief   View of the results of applying a function to every element of
+ *          another view. The function is called on every dereference, so
+ *          should be cheap and free of side effects.
+ * \param V The underlying view.
+ * \param F The function, called as <tt>f(element)</tt> on a const F.
+ */
+template <typename V, typename F>
+class transform_view : public view_base {
+    using base_iterator = decltype(std::declval<const V&>().begin());
+    using base_reference = typename std::iterator_traits<base_iterator>::reference;
+    using base_concept = typename detail::concept_of<base_iterator>::type;
+
+public:
+    class iterator {
+    public:
+        using reference = decltype(std::declval<const F&>()(std::declval<base_reference>()));
+        using value_type = typename std::decay<reference>::type;
+        using difference_type = typename std::iterator_traits<base_iterator>::difference_type;
+        using pointer = void;
+        using iterator_concept = base_concept;
+        /** Results returned by value are only input iterators to the pre-C++20
+         *  algorithms, however the underlying iterators can move. */
+        using iterator_category = typename std::conditional<std::is_lvalue_reference<reference>::value,
+                typename std::iterator_traits<base_iterator>::iterator_category,
+                std::input_iterator_tag>::type;
+
+        iterator() noexcept : it(), f(nullptr) {}
+        iterator(base_iterator it, const F* f) noexcept : it(it), f(f) {}
+
+        reference operator*() const { return (*f)(*it); }
+        reference operator[](difference_type n) const { return (*f)(it[n]); }
+
+        iterator& operator++() { ++it; return *this; }
+        iterator operator++(int) { iterator old = *this; ++it; return old; }
+        iterator& operator--() { --it; return *this; }
+        iterator operator--(int) { iterator old = *this; --it; return old; }
+        iterator& operator+=(difference_type n) { it += n; return *this; }
+        iterator& operator-=(difference_type n) { it -= n; return *this; }
+        iterator operator+(difference_type n) const { return iterator(it + n, f); }
+        iterator operator-(difference_type n) const { return iterator(it - n, f); }
+        friend iterator operator+(difference_type n, const iterator& i) { return i + n; }
+        difference_type operator-(const iterator& other) const { return it - other.it; }
+
+        bool operator==(const iterator& other) const { return it == other.it; }
+        bool operator!=(const iterator& other) const { return it != other.it; }
+        bool operator<(const iterator& other) const { return it < other.it; }
+        bool operator>(const iterator& other) const { return it > other.it; }
+        bool operator<=(const iterator& other) const { return it <= other.it; }
+        bool operator>=(const iterator& other) const { return it >= other.it; }
+
+    private:
+        base_iterator it;
+        const F* f;
+    };
+
+    transform_view() = default;
+    transform_view(V base, F f) : base(std::move(base)), f(std::move(f)) {}
+
+    iterator begin() const { return iterator(base.begin(), &f); }
+    iterator end() const { return iterator(base.end(), &f); }
+    std::size_t size() const { return base.size(); }
+
+    template <typename G>
+    void for_each(G g) const {
+        base.for_each([this, &g](base_reference x) { g(f(x)); });
+    }
+
+    template <typename G>
+    void for_each_in(std::size_t first, std::size_t count, std::size_t step, G& g) const {
+        auto apply = [this, &g](base_reference x) { g(f(x)); };
+        base.for_each_in(first, count, step, apply);
+    }
+
+private:
+    V base;
+    F f;
+};
+
+
+/**
+ * \brief   View of the elements of another view which satisfy a predicate.
+ *          A forward view: finding each element may skip any number of
+ *          others, so it has no size and begin() is O(n).
+ * \param V The underlying view.
+ * \param P The predicate, called as <tt>p(element)</tt> on a const P.
+ */
+template <typename V, typename P>
+class filter_view : public view_base {
+    using base_iterator = decltype(std::declval<const V&>().begin());
+    using base_reference = typename std::iterator_traits<base_iterator>::reference;
+
+public:
+    class iterator {
+    public:
+        using reference = base_reference;
+        using value_type = typename std::iterator_traits<base_iterator>::value_type;
+        using difference_type = typename std::iterator_traits<base_iterator>::difference_type;
+        using pointer = typename std::iterator_traits<base_iterator>::pointer;
+        using iterator_concept = detail::at_most_forward<typename detail::concept_of<base_iterator>::type>;
+        using iterator_category = detail::at_most_forward<
+                typename std::iterator_traits<base_iterator>::iterator_category>;
+
+        iterator() noexcept : it(), last(), p(nullptr) {}
+        iterator(base_iterator it, base_iterator last, const P* p) : it(it), last(last), p(p) {
+            satisfy();
+        }
+
+        reference operator*() const { return *it; }
+        iterator& operator++() { ++it; satisfy(); return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+        bool operator==(const iterator& other) const { return it == other.it; }
+        bool operator!=(const iterator& other) const { return it != other.it; }
+
+    private:
+        /** Advances to the next element satisfying the predicate. */
+        void satisfy() {
+            while (it != last && !(*p)(*it)) {
+                ++it;
+            }
+        }
+
+        base_iterator it;
+        base_iterator last;
+        const P* p;
+    };
+
+    filter_view() = default;
+    filter_view(V base, P p) : base(std::move(base)), p(std::move(p)) {}
+
+    iterator begin() const { return iterator(base.begin(), base.end(), &p); }
+    iterator end() const { return iterator(base.end(), base.end(), &p); }
+
+    template <typename G>
+    void for_each(G g) const {
+        base.for_each([this, &g](base_reference x) {
+            if (p(x)) {
+                g(x);
+            }
+        });
+    }
+
+private:
+    V base;
+    P p;
+};
+
+
+/**
+ * \brief   View of the last (i.e. newest) n elements of another view, or all
+ *          of them if there are fewer.
+ * \param V The underlying view, which must be random access.
+ */
+template <typename V>
+class take_last_view : public view_base {
+public:
+    using iterator = decltype(std::declval<const V&>().begin());
+    static_assert(std::is_base_of<std::random_access_iterator_tag,
+                                  typename detail::concept_of<iterator>::type>::value,
+                  "take_last needs a random access view");
+
+    take_last_view() = default;
+    take_last_view(V base, std::size_t n) : base(std::move(base)), n(n) {}
+
+    iterator begin() const { return base.begin() + static_cast<std::ptrdiff_t>(offset()); }
+    iterator end() const { return base.end(); }
+    std::size_t size() const { return base.size() - offset(); }
+
+    template <typename G>
+    void for_each(G g) const {
+        base.for_each_in(offset(), size(), 1, g);
+    }
+
+    template <typename G>
+    void for_each_in(std::size_t first, std::size_t count, std::size_t step, G& g) const {
+        base.for_each_in(offset() + first, count, step, g);
+    }
+
+private:
+    /** The number of elements of base skipped. */
+    std::size_t offset() const {
+        const std::size_t size = base.size();
+        return size > n ? size - n : 0;
+    }
+
+    V base;
+    std::size_t n = 0;
+};
+
+
+/**
+ * \brief   View of every step-th element of another view, starting with the
+ *          first.
+ * \param V The underlying view, which must be random access.
+ */
+template <typename V>
+class stride_view : public view_base {
+    using base_iterator = decltype(std::declval<const V&>().begin());
+    static_assert(std::is_base_of<std::random_access_iterator_tag,
+                                  typename detail::concept_of<base_iterator>::type>::value,
+                  "stride needs a random access view");
+
+public:
+    class iterator {
+    public:
+        using reference = typename std::iterator_traits<base_iterator>::reference;
+        using value_type = typename std::iterator_traits<base_iterator>::value_type;
+        using difference_type = typename std::iterator_traits<base_iterator>::difference_type;
+        using pointer = typename std::iterator_traits<base_iterator>::pointer;
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = typename std::iterator_traits<base_iterator>::iterator_category;
+
+        iterator() noexcept : first(), index(0), step(1) {}
+        iterator(base_iterator first, difference_type index, difference_type step) noexcept
+                : first(first), index(index), step(step) {}
+
+        reference operator*() const { return first[index * step]; }
+        reference operator[](difference_type n) const { return first[(index + n) * step]; }
+
+        iterator& operator++() { index++; return *this; }
+        iterator operator++(int) { iterator old = *this; index++; return old; }
+        iterator& operator--() { index--; return *this; }
+        iterator operator--(int) { iterator old = *this; index--; return old; }
+        iterator& operator+=(difference_type n) { index += n; return *this; }
+        iterator& operator-=(difference_type n) { index -= n; return *this; }
+        iterator operator+(difference_type n) const { return iterator(first, index + n, step); }
+        iterator operator-(difference_type n) const { return iterator(first, index - n, step); }
+        friend iterator operator+(difference_type n, const iterator& i) { return i + n; }
+        difference_type operator-(const iterator& other) const { return index - other.index; }
+
+        bool operator==(const iterator& other) const { return index == other.index; }
+        bool operator!=(const iterator& other) const { return index != other.index; }
+        bool operator<(const iterator& other) const { return index < other.index; }
+        bool operator>(const iterator& other) const { return index > other.index; }
+        bool operator<=(const iterator& other) const { return index <= other.index; }
+        bool operator>=(const iterator& other) const { return index >= other.index; }
+
+    private:
+        /** The first element of the underlying view. Stepping is by index so
+         *  the underlying iterator is never moved past its end. */
+        base_iterator first;
+        difference_type index;
+        difference_type step;
+    };
+
+    stride_view() = default;
+    stride_view(V base, std::size_t step) : base(std::move(base)), step(step > 0 ? step : 1) {}
+
+    iterator begin() const { return iterator(base.begin(), 0, signed_step()); }
+    iterator end() const { return iterator(base.begin(), static_cast<std::ptrdiff_t>(size()), signed_step()); }
+    std::size_t size() const { return (base.size() + step - 1) / step; }
+
+    template <typename G>
+    void for_each(G g) const {
+        base.for_each_in(0, size(), step, g);
+    }
+
+    template <typename G>
+    void for_each_in(std::size_t first, std::size_t count, std::size_t by, G& g) const {
+        base.for_each_in(first * step, count, by * step, g);
+    }
+
+private:
+    std::ptrdiff_t signed_step() const { return static_cast<std::ptrdiff_t>(step); }
+
+    V base;
+    std::size_t step = 1;
+};
+
+
+/**
+ * \brief   Returns a view unchanged.
+ */
+template <typename V, typename = typename std::enable_if<detail::is_view<V>::value>::type>
+V all(const V& view) {
+    return view;
+}
+
+/**
+ * \brief   Returns a view of every element of a buffer.
+ */
+template <typename BUFFER, typename = typename std::enable_if<!detail::is_view<BUFFER>::value>::type>
+buffer_view<BUFFER> all(const BUFFER& buffer) {
+    return buffer_view<BUFFER>(buffer);
+}
+
+/** Views of temporary buffers would dangle. */
+template <typename BUFFER, typename = typename std::enable_if<!detail::is_view<BUFFER>::value>::type>
+void all(const BUFFER&& buffer) = delete;
+
+/** The type of <tt>all(r)</tt>. */
+template <typename R>
+using all_t = decltype(all(std::declval<R>()));
+
+/** Pipeable adaptor returned by transform(f). */
+template <typename F> struct transform_adaptor { F f; };
+/** Pipeable adaptor returned by filter(p). */
+template <typename P> struct filter_adaptor { P p; };
+/** Pipeable adaptor returned by take_last(n). */
+struct take_last_adaptor { std::size_t n; };
+/** Pipeable adaptor returned by stride(step). */
+struct stride_adaptor { std::size_t step; };
+
+/**
+ * \brief   Lazily applies a function to every element of a buffer or view.
+ * \param   r   The buffer or view.
+ * \param   f   The function.
+ * \return  The view.
+ */
+template <typename R, typename F>
+transform_view<all_t<R>, F> transform(R&& r, F f) {
+    return transform_view<all_t<R>, F>(all(std::forward<R>(r)), std::move(f));
+}
+
+/**
+ * \brief   Creates an adaptor for <tt>r | transform(f)</tt>.
+ * \param   f   The function.
+ * \return  The adaptor.
+ */
+template <typename F>
+transform_adaptor<F> transform(F f) {
+    return transform_adaptor<F>{std::move(f)};
+}
+
+/**
+ * \brief   Lazily selects the elements of a buffer or view which satisfy a
+ *          predicate.
+ * \param   r   The buffer or view.
+ * \param   p   The predicate.
+ * \return  The view.
+ */
+template <typename R, typename P>
+filter_view<all_t<R>, P> filter(R&& r, P p) {
+    return filter_view<all_t<R>, P>(all(std::forward<R>(r)), std::move(p));
+}
+
+/**
+ * \brief   Creates an adaptor for <tt>r | filter(p)</tt>.
+ * \param   p   The predicate.
+ * \return  The adaptor.
+ */
+template <typename P>
+filter_adaptor<P> filter(P p) {
+    return filter_adaptor<P>{std::move(p)};
+}
+
+/**
+ * \brief   Selects the last (newest) n elements of a random access buffer or
+ *          view.
+ * \param   r   The buffer or view.
+ * \param   n   The maximum number of elements.
+ * \return  The view.
+ */
+template <typename R>
+take_last_view<all_t<R>> take_last(R&& r, std::size_t n) {
+    return take_last_view<all_t<R>>(all(std::forward<R>(r)), n);
+}
+
+/**
+ * \brief   Creates an adaptor for <tt>r | take_last(n)</tt>.
+ * \param   n   The maximum number of elements.
+ * \return  The adaptor.
+ */
+inline take_last_adaptor take_last(std::size_t n) {
+    return take_last_adaptor{n};
+}
+
+/**
+ * \brief   Selects every step-th element of a random access buffer or view,
+ *          starting with the first.
+ * \param   r       The buffer or view.
+ * \param   step    The distance between selected elements. 0 is treated as 1.
+ * \return  The view.
+ */
+template <typename R>
+stride_view<all_t<R>> stride(R&& r, std::size_t step) {
+    return stride_view<all_t<R>>(all(std::forward<R>(r)), step);
+}
+
+/**
+ * \brief   Creates an adaptor for <tt>r | stride(step)</tt>.
+ * \param   step    The distance between selected elements.
+ * \return  The adaptor.
+ */
+inline stride_adaptor stride(std::size_t step) {
+    return stride_adaptor{step};
+}
+
+template <typename R, typename F>
+transform_view<all_t<R>, F> operator|(R&& r, transform_adaptor<F> a) {
+    return transform(std::forward<R>(r), std::move(a.f));
+}
+
+template <typename R, typename P>
+filter_view<all_t<R>, P> operator|(R&& r, filter_adaptor<P> a) {
+    return filter(std::forward<R>(r), std::move(a.p));
+}
+
+template <typename R>
+take_last_view<all_t<R>> operator|(R&& r, take_last_adaptor a) {
+    return take_last(std::forward<R>(r), a.n);
+}
+
+template <typename R>
+stride_view<all_t<R>> operator|(R&& r, stride_adaptor a) {
+    return stride(std::forward<R>(r), a.step);
+}
+
+} // namespace circular_buffer_views
+
+#ifdef _COMMON_CIRCULAR_BUFFER_VIEWS_RANGES
+namespace std {
+namespace ranges {
+/** A buffer_view only points to its buffer, so its iterators outlive it. */
+template <typename BUFFER>
+inline constexpr bool enable_borrowed_range<circular_buffer_views::buffer_view<BUFFER>> = true;
+} // namespace ranges
+} // namespace std
+#endif
+
+#endif // _COMMON_CIRCULAR_BUFFER_VIEWS_H
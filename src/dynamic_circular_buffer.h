@@ -0,0 +1,414 @@
+/**
+ * \file   dynamic_circular_buffer.h
+ * \author Jonathan Simmonds
+ * \brief  Circular Buffer with a capacity chosen at runtime.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_DYNAMIC_CIRCULAR_BUFFER_H
+#define _COMMON_DYNAMIC_CIRCULAR_BUFFER_H
+
+#include <cstddef>      // ptrdiff_t
+#include <cstdint>      // uint32_t
+#include <cstdlib>      // size_t
+#include <iterator>     // random_access_iterator_tag
+#include <memory>       // unique_ptr
+#include <stdexcept>    // length_error, out_of_range
+#include <type_traits>  // conditional
+#include <utility>      // move, pair, swap
+
+#include "fast_mod.h"
+
+
+/**
+ * \brief   Circular Buffer whose capacity is chosen at runtime rather than
+ *          compile time, otherwise behaving as circular_buffer does (pushing
+ *          onto a full buffer overwrites the oldest element).
+ *
+ * The capacity need not be a power of two. Stepping an index by one wraps
+ * with a compare-and-subtract as in circular_buffer. Indexing by an arbitrary
+ * logical position, and so random access through the (random access)
+ * iterators, maps the position to storage with a precomputed fast_mod rather
+ * than a division, so it is branch-free.
+ *
+ * \param T     The type stored in this buffer. Must have a default
+ *              constructor.
+ */
+template <typename T>
+class dynamic_circular_buffer {
+public:
+    /** The type this buffer stores. */
+    using value_type = T;
+
+private:
+    /** Iterator over the elements, by logical position. */
+    template <bool CONST>
+    class basic_iterator {
+        using buffer_type = typename std::conditional<CONST, const dynamic_circular_buffer,
+                                                      dynamic_circular_buffer>::type;
+        friend class dynamic_circular_buffer;
+        basic_iterator(buffer_type* buffer, std::size_t pos) noexcept : buffer(buffer), pos(pos) {}
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = typename std::conditional<CONST, const T*, T*>::type;
+        using reference = typename std::conditional<CONST, const T&, T&>::type;
+
+        basic_iterator() noexcept : buffer(nullptr), pos(0) {}
+        /** Conversion from a mutable to a const iterator. */
+        template <bool OTHER, typename = typename std::enable_if<CONST && !OTHER>::type>
+        basic_iterator(const basic_iterator<OTHER>& other) noexcept : buffer(other.buffer), pos(other.pos) {}
+
+        reference operator*() const noexcept { return (*buffer)[pos]; }
+        pointer operator->() const noexcept { return &(*buffer)[pos]; }
+        reference operator[](difference_type n) const noexcept { return (*buffer)[pos + n]; }
+        basic_iterator& operator++() noexcept { pos++; return *this; }
+        basic_iterator operator++(int) noexcept { basic_iterator old = *this; pos++; return old; }
+        basic_iterator& operator--() noexcept { pos--; return *this; }
+        basic_iterator operator--(int) noexcept { basic_iterator old = *this; pos--; return old; }
+        basic_iterator& operator+=(difference_type n) noexcept { pos += n; return *this; }
+        basic_iterator& operator-=(difference_type n) noexcept { pos -= n; return *this; }
+        basic_iterator operator+(difference_type n) const noexcept { return basic_iterator(buffer, pos + n); }
+        basic_iterator operator-(difference_type n) const noexcept { return basic_iterator(buffer, pos - n); }
+        // Iterators and const_iterators can be mixed, in either order.
+        template <bool OTHER>
+        difference_type operator-(const basic_iterator<OTHER>& other) const noexcept {
+            return static_cast<difference_type>(pos) - static_cast<difference_type>(other.pos);
+        }
+        template <bool OTHER>
+        bool operator==(const basic_iterator<OTHER>& other) const noexcept { return pos == other.pos; }
+        template <bool OTHER>
+        bool operator!=(const basic_iterator<OTHER>& other) const noexcept { return pos != other.pos; }
+        template <bool OTHER>
+        bool operator<(const basic_iterator<OTHER>& other) const noexcept { return pos < other.pos; }
+        template <bool OTHER>
+        bool operator>(const basic_iterator<OTHER>& other) const noexcept { return pos > other.pos; }
+        template <bool OTHER>
+        bool operator<=(const basic_iterator<OTHER>& other) const noexcept { return pos <= other.pos; }
+        template <bool OTHER>
+        bool operator>=(const basic_iterator<OTHER>& other) const noexcept { return pos >= other.pos; }
+
+    private:
+        template <bool> friend class basic_iterator;
+        buffer_type* buffer;
+        std::size_t pos;
+    };
+
+public:
+    /** A random access iterator over the elements, front to back. */
+    using iterator = basic_iterator<false>;
+    /** A random access const-iterator over the elements, front to back. */
+    using const_iterator = basic_iterator<true>;
+
+    /**
+     * \brief   Constructor, initialising an empty buffer.
+     * \param   capacity    The maximum number of elements. Must be less than
+     *                      2^31.
+     * \throws  std::length_error   If the capacity is too large.
+     */
+    explicit dynamic_circular_buffer(std::size_t capacity)
+            : slots(checked_slots(capacity))
+            , wrap(static_cast<std::uint32_t>(slots))
+            , buffer(new T[slots]()) {}
+
+    /**
+     * \brief   Copy constructor, copying only the live elements.
+     * \param   other   The buffer to copy.
+     */
+    dynamic_circular_buffer(const dynamic_circular_buffer& other)
+            : slots(other.slots)
+            , wrap(other.wrap)
+            , buffer(new T[slots]()) {
+        for (const T& item : other) {
+            push_back(item);
+        }
+    }
+
+    /**
+     * \brief   Move constructor, taking other's storage. other is left with no
+     *          storage and must only be assigned to or destroyed.
+     * \param   other   The buffer to move from.
+     */
+    dynamic_circular_buffer(dynamic_circular_buffer&& other) noexcept = default;
+
+    /**
+     * \brief   Copy assignment.
+     * \param   other   The buffer to copy.
+     * \return  This buffer.
+     */
+    dynamic_circular_buffer& operator=(const dynamic_circular_buffer& other) {
+        if (this != &other) {
+            dynamic_circular_buffer copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    /**
+     * \brief   Move assignment, taking other's storage.
+     * \param   other   The buffer to move from.
+     * \return  This buffer.
+     */
+    dynamic_circular_buffer& operator=(dynamic_circular_buffer&& other) noexcept = default;
+
+    /**
+     * \brief   Exchanges the contents of this buffer with another, in O(1).
+     * \param   other   The buffer to swap with.
+     */
+    void swap(dynamic_circular_buffer& other) noexcept {
+        std::swap(slots, other.slots);
+        std::swap(wrap, other.wrap);
+        buffer.swap(other.buffer);
+        std::swap(head, other.head);
+        std::swap(tail, other.tail);
+    }
+
+    /**
+     * \brief   Returns whether or not the buffer is full.
+     * \return  The state of the buffer.
+     */
+    bool full() const noexcept {
+        return capped_mod(head + 1) == tail;
+    }
+
+    /**
+     * \brief   Returns whether or not the buffer is empty.
+     * \return  The state of the buffer.
+     */
+    bool empty() const noexcept {
+        return head == tail;
+    }
+
+    /**
+     * \brief   Retrieves the number of elements in the buffer.
+     * \return  The number of elements.
+     */
+    std::size_t len() const noexcept {
+        return (head < tail) ? (head + slots) - tail : head - tail;
+    }
+
+    /**
+     * \brief   Retrieves the maximum number of elements the buffer can hold.
+     * \return  The capacity, as given on construction.
+     */
+    std::size_t capacity() const noexcept {
+        return slots - 1;
+    }
+
+    /**
+     * \brief   Retrieves the element at the given position, with bounds
+     *          checking.
+     * \param   pos The position, 0 being the front.
+     * \return  Reference to the element.
+     * \throws  std::out_of_range   If pos is not less than <tt>len()</tt>.
+     */
+    const T& at(std::size_t pos) const {
+        if (pos >= len()) {
+            throw std::out_of_range("dynamic_circular_buffer: index out of range");
+        }
+        return (*this)[pos];
+    }
+
+    /**
+     * \brief   Retrieves the element at the given position, with bounds
+     *          checking.
+     * \param   pos The position, 0 being the front.
+     * \return  Reference to the element.
+     * \throws  std::out_of_range   If pos is not less than <tt>len()</tt>.
+     */
+    T& at(std::size_t pos) {
+        if (pos >= len()) {
+            throw std::out_of_range("dynamic_circular_buffer: index out of range");
+        }
+        return (*this)[pos];
+    }
+
+    /**
+     * \brief   Retrieves the element at the given position. Accessing a
+     *          position not less than <tt>len()</tt> causes undefined
+     *          behaviour.
+     * \param   pos The position, 0 being the front.
+     * \return  Reference to the element.
+     */
+    const T& operator[](std::size_t pos) const noexcept {
+        return buffer[wrap(static_cast<std::uint32_t>(tail + pos))];
+    }
+
+    /**
+     * \brief   Retrieves the element at the given position. Accessing a
+     *          position not less than <tt>len()</tt> causes undefined
+     *          behaviour.
+     * \param   pos The position, 0 being the front.
+     * \return  Reference to the element.
+     */
+    T& operator[](std::size_t pos) noexcept {
+        return buffer[wrap(static_cast<std::uint32_t>(tail + pos))];
+    }
+
+    /**
+     * \brief   Retrieves the oldest element. Undefined if empty.
+     * \return  Reference to the front element.
+     */
+    const T& front() const noexcept { return buffer[tail]; }
+
+    /**
+     * \brief   Retrieves the oldest element. Undefined if empty.
+     * \return  Reference to the front element.
+     */
+    T& front() noexcept { return buffer[tail]; }
+
+    /**
+     * \brief   Retrieves the newest element. Undefined if empty.
+     * \return  Reference to the back element.
+     */
+    const T& back() const noexcept { return buffer[capped_mod(head + slots - 1)]; }
+
+    /**
+     * \brief   Retrieves the newest element. Undefined if empty.
+     * \return  Reference to the back element.
+     */
+    T& back() noexcept { return buffer[capped_mod(head + slots - 1)]; }
+
+    /**
+     * \brief   Copies an item into the buffer, overwriting the oldest item if
+     *          the buffer is full.
+     * \param   item    The item to copy into the buffer.
+     */
+    void push_back(const T& item) {
+        buffer[head] = item;
+        advance_head();
+    }
+
+    /**
+     * \brief   Moves an item into the buffer, overwriting the oldest item if
+     *          the buffer is full.
+     * \param   item    The item to move into the buffer.
+     */
+    void push_back(T&& item) {
+        buffer[head] = std::move(item);
+        advance_head();
+    }
+
+    /**
+     * \brief   Removes the newest item. Undefined if empty.
+     */
+    void pop_back() noexcept {
+        head = capped_mod(head + slots - 1);
+    }
+
+    /**
+     * \brief   Removes the oldest item. Undefined if empty.
+     */
+    void pop_front() noexcept {
+        tail = capped_mod(tail + 1);
+    }
+
+    /**
+     * \brief   Removes the given number of oldest items. Undefined if count is
+     *          greater than <tt>len()</tt>.
+     * \param   count   The number of items to remove.
+     */
+    void pop_front(std::size_t count) noexcept {
+        tail = capped_mod(tail + count);
+    }
+
+    /**
+     * \brief   Returns the first contiguous run of elements, from the front.
+     * \return  Pointer to the front element and the length of the run.
+     */
+    std::pair<const T*, std::size_t> array_one() const noexcept {
+        return std::make_pair(&buffer[tail], (head < tail) ? slots - tail : head - tail);
+    }
+
+    /**
+     * \brief   Returns the second contiguous run of elements, which have
+     *          wrapped around to the start of the storage.
+     * \return  Pointer to the first wrapped element and the length of the run.
+     */
+    std::pair<const T*, std::size_t> array_two() const noexcept {
+        return std::make_pair(&buffer[0], (head < tail) ? head : 0);
+    }
+
+    /** \return Iterator to the front of the buffer. */
+    iterator begin() noexcept { return iterator(this, 0); }
+    /** \return Iterator to the element following the back of the buffer. */
+    iterator end() noexcept { return iterator(this, len()); }
+    /** \return Iterator to the front of the buffer. */
+    const_iterator begin() const noexcept { return const_iterator(this, 0); }
+    /** \return Iterator to the element following the back of the buffer. */
+    const_iterator end() const noexcept { return const_iterator(this, len()); }
+    /** \return Iterator to the front of the buffer. */
+    const_iterator cbegin() const noexcept { return begin(); }
+    /** \return Iterator to the element following the back of the buffer. */
+    const_iterator cend() const noexcept { return end(); }
+
+private:
+    static std::size_t checked_slots(std::size_t capacity) {
+        if (capacity >= (std::size_t(1) << 31)) {
+            throw std::length_error("dynamic_circular_buffer: capacity too large");
+        }
+        return capacity + 1;
+    }
+
+    /**
+     * \brief   Performs the calculation (x % slots) for 0 <= x < 2 * slots.
+     * \param   x   x in the calculation.
+     * \return  The solution to the calculation.
+     */
+    std::size_t capped_mod(std::size_t x) const noexcept {
+        return x < slots ? x : x - slots;
+    }
+
+    void advance_head() noexcept {
+        head = capped_mod(head + 1);
+        if (head == tail) {
+            tail = capped_mod(tail + 1);
+        }
+    }
+
+    /** The number of slots: one more than the capacity, as one slot is always
+     *  left empty. */
+    std::size_t slots;
+    /** Reduces a storage index modulo slots. */
+    fast_mod wrap;
+    /** The storage. */
+    std::unique_ptr<T[]> buffer;
+    /** The slot the next element is pushed into. */
+    std::size_t head = 0;
+    /** The slot of the oldest element. */
+    std::size_t tail = 0;
+};
+
+/**
+ * \brief   Exchanges the contents of two buffers, in O(1).
+ * \param   a   The first buffer.
+ * \param   b   The second buffer.
+ */
+template <typename T>
+void swap(dynamic_circular_buffer<T>& a, dynamic_circular_buffer<T>& b) noexcept {
+    a.swap(b);
+}
+
+#endif // _COMMON_DYNAMIC_CIRCULAR_BUFFER_H
@@ -0,0 +1,89 @@
+/**
+ * \file   fast_mod.h
+ * \author Jonathan Simmonds
+ * \brief  Division-free modulo by a runtime divisor.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_FAST_MOD_H
+#define _COMMON_FAST_MOD_H
+
+#include <cstdint>  // uint32_t, uint64_t
+
+
+/**
+ * \brief   Computes <tt>x % d</tt> for a fixed runtime divisor d with a
+ *          multiply and shift in place of a division, using Lemire's fastmod
+ *          (Lemire, Kaser & Kurz, "Faster Remainder by Direct Computation",
+ *          2019).
+ *
+ * A compile-time divisor is already strength-reduced by the compiler (as for
+ * circular_buffer's SIZE); this does the same for divisors only known at
+ * runtime, such as a ring capacity read from configuration. The reciprocal is
+ * precomputed once on construction. The result is exact for every 32-bit x
+ * and non-zero 32-bit d. On compilers without 128-bit integers it falls back
+ * to the <tt>%</tt> operator.
+ */
+class fast_mod {
+public:
+    /**
+     * \brief   Constructor, precomputing the reciprocal of the divisor.
+     * \param   d   The divisor. Must be non-zero.
+     */
+    explicit fast_mod(std::uint32_t d) noexcept
+            : d(d)
+            , m(UINT64_C(0xFFFFFFFFFFFFFFFF) / d + 1) {}
+
+    /**
+     * \brief   Calculates the remainder of division by the divisor.
+     * \param   x   The dividend.
+     * \return  <tt>x % divisor()</tt>.
+     */
+    std::uint32_t operator()(std::uint32_t x) const noexcept {
+#if defined(__SIZEOF_INT128__)
+        // The low 64 bits of m * x are the fractional part of x / d; scaling
+        // them by d gives the remainder in the high 64 bits.
+        __extension__ typedef unsigned __int128 uint128;
+        const std::uint64_t fraction = m * x;
+        return static_cast<std::uint32_t>((static_cast<uint128>(fraction) * d) >> 64);
+#else
+        return x % d;
+#endif
+    }
+
+    /**
+     * \brief   Retrieves the divisor.
+     * \return  The divisor.
+     */
+    std::uint32_t divisor() const noexcept {
+        return d;
+    }
+
+private:
+    /** The divisor. */
+    std::uint32_t d;
+    /** ceil(2^64 / d), or 0 when d is 1 (for which every remainder is 0). */
+    std::uint64_t m;
+};
+
+#endif // _COMMON_FAST_MOD_H
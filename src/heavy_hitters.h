@@ -0,0 +1,392 @@
+/**
+ * \file   heavy_hitters.h
+ * \author Jonathan Simmonds
+ * \brief  Most frequent keys over a sliding window of events.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_HEAVY_HITTERS_H
+#define _COMMON_HEAVY_HITTERS_H
+
+#include <algorithm>    // nth_element, sort, min
+#include <array>        // array
+#include <cstdint>      // uint32_t, uint64_t
+#include <cstdlib>      // size_t
+#include <functional>   // hash
+#include <utility>      // move
+
+#include "circular_buffer.h"
+
+
+namespace heavy_hitters_detail {
+
+/**
+ * \brief   Finds the smallest power of two which is at least n.
+ * \param   n       The minimum.
+ * \param   power   The power of two to start from.
+ * \return  The power of two.
+ */
+constexpr std::size_t power_of_two_at_least(std::size_t n, std::size_t power = 1) noexcept {
+    return power >= n ? power : power_of_two_at_least(n, 2 * power);
+}
+
+} // namespace heavy_hitters_detail
+
+
+/**
+ * \brief   A key and its estimated frequency, as returned by
+ *          <tt>heavy_hitters::top()</tt>.
+ */
+template <typename KEY>
+struct heavy_hitter {
+    /** The key. */
+    KEY key;
+    /** The estimated number of occurrences in the window. Never an
+     *  underestimate. */
+    std::uint32_t count;
+};
+
+/**
+ * \brief   Streaming top-K frequent keys over the last WINDOW events, in
+ *          bounded memory.
+ *
+ * The events are held in a circular_buffer so the oldest can be expired as
+ * each new one arrives. Frequencies are estimated by a Count-Min sketch
+ * (DEPTH rows of WIDTH counters, never underestimating) which supports the
+ * decrements expiry needs. The CANDIDATES keys with the highest estimates are
+ * tracked in a fixed table, found through a small open-addressed index; a
+ * key enters the table by beating the cached minimum, a lower bound on the
+ * smallest candidate estimate which is only recomputed (in O(CANDIDATES))
+ * when a key beats it, so most events are rejected without a scan.
+ *
+ * Each event is O(DEPTH) (amortised) and top() is O(CANDIDATES) plus sorting
+ * the K results. The window's storage is allocated on the heap once, at
+ * construction; nothing is allocated after that. Not thread-safe.
+ *
+ * \param KEY           The type of the keys. Must be default constructible,
+ *                      copyable and equality comparable.
+ * \param WINDOW        The number of most recent events counted.
+ * \param CANDIDATES    The number of keys tracked; the most K can be.
+ * \param WIDTH         The number of counters per sketch row. Must be a power
+ *                      of two. Each estimate exceeds the true count by at
+ *                      most <tt>e * WINDOW / WIDTH</tt> with probability at
+ *                      least <tt>1 - exp(-DEPTH)</tt>.
+ * \param DEPTH         The number of sketch rows.
+ * \param HASH          The hash function of the keys.
+ */
+template <typename KEY, std::size_t WINDOW, std::size_t CANDIDATES = 64, std::size_t WIDTH = 2048,
+          std::size_t DEPTH = 4, typename HASH = std::hash<KEY>>
+class heavy_hitters {
+    static_assert(WINDOW > 0 && WINDOW < 0xFFFFFFFFu, "WINDOW must fit the 32-bit counters");
+    static_assert(CANDIDATES > 0, "CANDIDATES must be > 0");
+    static_assert(WIDTH > 0 && (WIDTH & (WIDTH - 1)) == 0, "WIDTH must be a power of two");
+    static_assert(DEPTH > 0, "DEPTH must be > 0");
+
+public:
+    /** The type of the results of top(). */
+    using entry = heavy_hitter<KEY>;
+
+    /**
+     * \brief   Constructor, initialising an empty window.
+     * \param   hash    The hash function of the keys.
+     */
+    explicit heavy_hitters(const HASH& hash = HASH()) : hasher(hash) {}
+
+    /**
+     * \brief   Records an event, expiring the oldest if the window is full.
+     * \param   key The event's key.
+     */
+    void push(const KEY& key) {
+        if (window.full()) {
+            expire();
+        }
+        window.push_back(key);
+        const std::uint64_t h = hash_of(key);
+        const std::uint32_t estimate = add(h, 1);
+        const std::size_t slot = find(key, h);
+        if (slot != NONE) {
+            candidates[slot].count = estimate;
+            if (slot == min_slot) {
+                min_stale = true;
+            }
+            return;
+        }
+        if (count < CANDIDATES) {
+            place(count++, key, h, estimate);
+            return;
+        }
+        if (estimate <= min_count) {
+            return;
+        }
+        if (min_stale) {
+            recompute_min();
+            if (estimate <= min_count) {
+                return;
+            }
+        }
+        // Replace the smallest candidate. min_count stays a lower bound.
+        index_erase(min_slot);
+        place(min_slot, key, h, estimate);
+        min_stale = true;
+    }
+
+    /**
+     * \brief   Retrieves the K most frequent keys in the window, most frequent
+     *          first.
+     * \param   out Assigned the keys and their estimated counts. Must have
+     *              space for k entries.
+     * \param   k   The number of keys to retrieve. At most CANDIDATES are
+     *              ever returned.
+     * \return  The number of keys retrieved.
+     */
+    std::size_t top(entry* out, std::size_t k) {
+        // Refresh the cached estimates, which only change on their own keys'
+        // events, with the sketch's current view of other keys' collisions.
+        for (std::size_t i = 0; i < count; i++) {
+            candidates[i].count = estimate_hash(candidates[i].hash);
+            scratch[i].key = candidates[i].key;
+            scratch[i].count = candidates[i].count;
+        }
+        recompute_min();
+        const std::size_t n = std::min(k, count);
+        auto more_frequent = [](const entry& a, const entry& b) { return a.count > b.count; };
+        if (n < count) {
+            std::nth_element(scratch.begin(), scratch.begin() + n, scratch.begin() + count, more_frequent);
+        }
+        std::sort(scratch.begin(), scratch.begin() + n, more_frequent);
+        std::copy(scratch.begin(), scratch.begin() + n, out);
+        return n;
+    }
+
+    /**
+     * \brief   Estimates the number of occurrences of a key in the window.
+     * \param   key The key.
+     * \return  The estimate, which is never less than the true count.
+     */
+    std::uint32_t estimate(const KEY& key) const {
+        return estimate_hash(hash_of(key));
+    }
+
+    /**
+     * \brief   Retrieves the number of events in the window.
+     * \return  The smaller of WINDOW and the number of events pushed.
+     */
+    std::size_t size() const noexcept {
+        return window.len();
+    }
+
+private:
+    /** A tracked key. */
+    struct candidate {
+        KEY key;
+        std::uint64_t hash;
+        std::uint32_t count;
+    };
+
+    /** The size of the candidate index: a power of two at least twice
+     *  CANDIDATES, keeping probe sequences short. */
+    static const std::size_t INDEX_SIZE = heavy_hitters_detail::power_of_two_at_least(2 * CANDIDATES);
+    static const std::size_t INDEX_MASK = INDEX_SIZE - 1;
+    static const std::size_t NONE = ~static_cast<std::size_t>(0);
+
+    std::uint64_t hash_of(const KEY& key) const {
+        // Finalise the hash (std::hash is often the identity) so its high and
+        // low halves are independent for the sketch's double hashing.
+        std::uint64_t h = static_cast<std::uint64_t>(hasher(key));
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+
+    /**
+     * \brief   Adds delta to a key's counter in every sketch row.
+     * \return  The key's new estimate: the smallest of its counters.
+     */
+    std::uint32_t add(std::uint64_t h, std::int32_t delta) noexcept {
+        std::uint32_t estimate = ~static_cast<std::uint32_t>(0);
+        for (std::size_t row = 0; row < DEPTH; row++) {
+            std::uint32_t& counter = sketch[row][column(h, row)];
+            counter += static_cast<std::uint32_t>(delta);
+            estimate = std::min(estimate, counter);
+        }
+        return estimate;
+    }
+
+    std::uint32_t estimate_hash(std::uint64_t h) const noexcept {
+        std::uint32_t estimate = ~static_cast<std::uint32_t>(0);
+        for (std::size_t row = 0; row < DEPTH; row++) {
+            estimate = std::min(estimate, sketch[row][column(h, row)]);
+        }
+        return estimate;
+    }
+
+    /** The column of a key in a sketch row, by double hashing. */
+    static std::size_t column(std::uint64_t h, std::size_t row) noexcept {
+        const std::uint64_t h2 = (h >> 32) | 1;
+        return static_cast<std::size_t>((h + row * h2) & (WIDTH - 1));
+    }
+
+    /**
+     * \brief   Removes the oldest event from the window.
+     */
+    void expire() {
+        const KEY& key = window.front();
+        const std::uint64_t h = hash_of(key);
+        const std::uint32_t estimate = add(h, -1);
+        const std::size_t slot = find(key, h);
+        window.pop_front();
+        if (slot == NONE) {
+            return;
+        }
+        if (estimate == 0) {
+            remove(slot);
+            return;
+        }
+        candidates[slot].count = estimate;
+        if (estimate < min_count) {
+            // Below the lower bound of every other candidate.
+            min_count = estimate;
+            min_slot = slot;
+            min_stale = false;
+        }
+    }
+
+    /**
+     * \brief   Scans the candidates for the smallest estimate.
+     */
+    void recompute_min() noexcept {
+        min_count = 0;
+        min_slot = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            if (i == 0 || candidates[i].count < min_count) {
+                min_count = candidates[i].count;
+                min_slot = i;
+            }
+        }
+        min_stale = false;
+    }
+
+    /**
+     * \brief   Writes a key to a candidate slot and indexes it.
+     */
+    void place(std::size_t slot, const KEY& key, std::uint64_t h, std::uint32_t estimate) {
+        candidates[slot].key = key;
+        candidates[slot].hash = h;
+        candidates[slot].count = estimate;
+        std::size_t pos = h & INDEX_MASK;
+        while (index[pos] != 0) {
+            pos = (pos + 1) & INDEX_MASK;
+        }
+        index[pos] = static_cast<std::uint32_t>(slot + 1);
+        if (estimate < min_count) {
+            min_count = estimate;
+            min_slot = slot;
+            min_stale = false;
+        }
+    }
+
+    /**
+     * \brief   Removes a candidate, moving the last into its slot.
+     */
+    void remove(std::size_t slot) {
+        index_erase(slot);
+        const std::size_t last = count - 1;
+        if (slot != last) {
+            index[index_position(last)] = static_cast<std::uint32_t>(slot + 1);
+            candidates[slot] = std::move(candidates[last]);
+            if (min_slot == last) {
+                min_slot = slot;
+            }
+        }
+        count--;
+        // Removing a candidate can only raise the minimum, but whether the
+        // cached slot still holds it is unknown.
+        min_stale = true;
+    }
+
+    /**
+     * \brief   Finds a key's candidate slot.
+     * \return  The slot, or NONE if the key is not a candidate.
+     */
+    std::size_t find(const KEY& key, std::uint64_t h) const {
+        for (std::size_t pos = h & INDEX_MASK; index[pos] != 0; pos = (pos + 1) & INDEX_MASK) {
+            const std::size_t slot = index[pos] - 1;
+            if (candidates[slot].hash == h && candidates[slot].key == key) {
+                return slot;
+            }
+        }
+        return NONE;
+    }
+
+    /** The index position referring to a candidate slot. */
+    std::size_t index_position(std::size_t slot) const noexcept {
+        std::size_t pos = candidates[slot].hash & INDEX_MASK;
+        while (index[pos] != slot + 1) {
+            pos = (pos + 1) & INDEX_MASK;
+        }
+        return pos;
+    }
+
+    /**
+     * \brief   Removes a candidate slot from the index, shifting later entries
+     *          of the probe sequence back so no tombstone is needed.
+     */
+    void index_erase(std::size_t slot) noexcept {
+        std::size_t pos = index_position(slot);
+        index[pos] = 0;
+        for (std::size_t next = (pos + 1) & INDEX_MASK; index[next] != 0; next = (next + 1) & INDEX_MASK) {
+            const std::size_t home = candidates[index[next] - 1].hash & INDEX_MASK;
+            // Move the entry into the gap unless its home lies after the gap.
+            if (((next - home) & INDEX_MASK) >= ((next - pos) & INDEX_MASK)) {
+                index[pos] = index[next];
+                index[next] = 0;
+                pos = next;
+            }
+        }
+    }
+
+    HASH hasher;
+    /** The events in the window, oldest first. */
+    circular_buffer<KEY, WINDOW + 1, true> window;
+    /** The Count-Min sketch. */
+    std::array<std::array<std::uint32_t, WIDTH>, DEPTH> sketch {};
+    /** The tracked keys, in slots [0, count). */
+    std::array<candidate, CANDIDATES> candidates {};
+    /** The number of tracked keys. */
+    std::size_t count = 0;
+    /** Maps a key's hash to (its candidate slot + 1), or 0 if empty. */
+    std::array<std::uint32_t, INDEX_SIZE> index {};
+    /** A lower bound on the smallest candidate estimate. */
+    std::uint32_t min_count = 0;
+    /** The slot holding min_count, if not stale. */
+    std::size_t min_slot = 0;
+    /** Whether min_count and min_slot may no longer be exact. */
+    bool min_stale = true;
+    /** Workspace for top(). */
+    std::array<entry, CANDIDATES> scratch {};
+};
+
+#endif // _COMMON_HEAVY_HITTERS_H
@@ -0,0 +1,283 @@
+/**
+ * \file   mpsc_log_buffer.h
+ * \author Jonathan Simmonds
+ * \brief  Lock-free multi-producer single-consumer ring of variable-length records.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_MPSC_LOG_BUFFER_H
+#define _COMMON_MPSC_LOG_BUFFER_H
+
+#include <atomic>       // atomic
+#include <cstdint>      // uint32_t, uint64_t
+#include <cstdlib>      // size_t
+#include <cstring>      // memcpy, memset
+#include <limits>       // numeric_limits
+#include <memory>       // unique_ptr
+#include <stdexcept>    // length_error
+#include <thread>       // this_thread
+
+
+/**
+ * \brief   Byte ring to which many threads append variable-length records
+ *          and from which a single thread reads them, in the style of the
+ *          Aeron log buffers.
+ *
+ * Each record is written as a frame: an 8-byte header followed by the payload,
+ * padded to a multiple of 8 bytes. Producers claim space by advancing the tail
+ * position (with a single <tt>fetch_add</tt> in write(), or a CAS in
+ * try_write()), copy their payload into the claimed space and then publish the
+ * frame by storing its header with release ordering. Producers never wait for
+ * each other, only for the consumer to free space.
+ *
+ * The consumer scans forward from the head, stopping at the first header which
+ * is still zero (i.e. claimed but not yet published). It zeroes every frame it
+ * consumes so the space reads as unpublished the next time round the ring.
+ * Where a frame would run past the end of the ring, a padding frame (skipped
+ * by the consumer) fills the space up to the end instead and the record is
+ * written at the start.
+ */
+class mpsc_log_buffer {
+public:
+    /**
+     * \brief   Constructor, initialising an empty buffer.
+     * \param   bytes   The size of the ring. Rounded up to a power of two of at
+     *                  least 64 bytes.
+     */
+    explicit mpsc_log_buffer(std::size_t bytes)
+            : cap(round_up_pow2(bytes < 64 ? 64 : bytes))
+            , words(new std::atomic<std::uint64_t>[cap / WORD]()) {}
+
+    mpsc_log_buffer(const mpsc_log_buffer&) = delete;
+    mpsc_log_buffer& operator=(const mpsc_log_buffer&) = delete;
+
+    /**
+     * \brief   Appends a record, waiting for the consumer to free space if the
+     *          ring is full. May be called from any thread.
+     * \param   data    The record's payload.
+     * \param   len     The length of the payload.
+     * \throws  std::length_error   If len is greater than max_length().
+     */
+    void write(const void* data, std::size_t len) {
+        if (len > max_length()) {
+            throw std::length_error("mpsc_log_buffer: record too long");
+        }
+        const std::size_t frame = frame_size(len);
+        for (;;) {
+            const std::uint64_t pos = tail.fetch_add(frame, std::memory_order_relaxed);
+            wait_for_space(pos + frame);
+            const std::size_t offset = static_cast<std::size_t>(pos & (cap - 1));
+            if (offset + frame <= cap) {
+                publish(offset, data, len);
+                return;
+            }
+            // The claimed space runs past the end of the ring, so fill both of
+            // its parts with padding and claim again.
+            publish_padding(offset, cap - offset);
+            publish_padding(0, offset + frame - cap);
+        }
+    }
+
+    /**
+     * \brief   Appends a record if there is space for it. May be called from
+     *          any thread.
+     * \param   data    The record's payload.
+     * \param   len     The length of the payload.
+     * \return  true if the record was appended, false if there was not enough
+     *          space (or len is greater than max_length()).
+     */
+    bool try_write(const void* data, std::size_t len) noexcept {
+        if (len > max_length()) {
+            return false;
+        }
+        const std::size_t frame = frame_size(len);
+        std::uint64_t pos = tail.load(std::memory_order_relaxed);
+        std::size_t offset;
+        std::size_t padding;
+        do {
+            offset = static_cast<std::size_t>(pos & (cap - 1));
+            // Claim any padding needed to start the record at the beginning
+            // along with the record itself.
+            padding = offset + frame > cap ? cap - offset : 0;
+            if (pos + padding + frame > head.load(std::memory_order_acquire) + cap) {
+                return false;
+            }
+        } while (!tail.compare_exchange_weak(pos, pos + padding + frame, std::memory_order_relaxed));
+        if (padding != 0) {
+            publish_padding(offset, padding);
+            offset = 0;
+        }
+        publish(offset, data, len);
+        return true;
+    }
+
+    /**
+     * \brief   Reads published records, in order, stopping at the first which
+     *          has been claimed but not yet published. Must only be called by
+     *          the consumer thread.
+     * \param   f       Callable invoked as
+     *                  <tt>f(const unsigned char* data, std::size_t len)</tt> for
+     *                  each record. The data is only valid during the call.
+     * \param   limit   The maximum number of records to read.
+     * \return  The number of records read.
+     */
+    template <typename F>
+    std::size_t read(F f, std::size_t limit = std::numeric_limits<std::size_t>::max()) {
+        const std::uint64_t start = head.load(std::memory_order_relaxed);
+        std::uint64_t pos = start;
+        std::size_t records = 0;
+        while (records < limit) {
+            const std::size_t offset = static_cast<std::size_t>(pos & (cap - 1));
+            const std::uint64_t header = words[offset / WORD].load(std::memory_order_acquire);
+            const std::size_t length = static_cast<std::size_t>(header & LENGTH_MASK);
+            if (length == 0) {
+                break;
+            }
+            if ((header & PADDING) == 0) {
+                f(bytes() + offset + HEADER, length - HEADER);
+                records++;
+            }
+            const std::size_t frame = align(length);
+            std::memset(static_cast<void*>(bytes() + offset), 0, frame);
+            pos += frame;
+        }
+        if (pos != start) {
+            // Release so the zeroing is complete before producers reuse the
+            // space.
+            head.store(pos, std::memory_order_release);
+        }
+        return records;
+    }
+
+    /**
+     * \brief   Retrieves the size of the ring.
+     * \return  The capacity in bytes.
+     */
+    std::size_t capacity() const noexcept {
+        return cap;
+    }
+
+    /**
+     * \brief   Retrieves the length of the longest record which may be
+     *          written.
+     * \return  The maximum payload length in bytes.
+     */
+    std::size_t max_length() const noexcept {
+        return cap / 2 - HEADER;
+    }
+
+    /**
+     * \brief   Retrieves the number of bytes claimed by producers and not yet
+     *          consumed, including headers and padding. Only a snapshot when
+     *          other threads are writing or reading.
+     * \return  The number of bytes in use.
+     */
+    std::size_t used_bytes() const noexcept {
+        const std::uint64_t h = head.load(std::memory_order_acquire);
+        const std::uint64_t t = tail.load(std::memory_order_acquire);
+        return t > h ? static_cast<std::size_t>(t - h) : 0;
+    }
+
+private:
+    /** The size of a word of the ring, and the alignment of frames. */
+    static const std::size_t WORD = sizeof(std::uint64_t);
+    /** The size of a frame header. */
+    static const std::size_t HEADER = WORD;
+    /** The header bits holding the frame length (header plus payload,
+     *  unpadded). Zero until the frame is published. */
+    static const std::uint64_t LENGTH_MASK = 0xFFFFFFFFu;
+    /** The header bit marking a padding frame. */
+    static const std::uint64_t PADDING = std::uint64_t(1) << 32;
+
+    static_assert(sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t),
+                  "std::atomic<std::uint64_t> must have the size of a std::uint64_t");
+
+    unsigned char* bytes() const noexcept {
+        return reinterpret_cast<unsigned char*>(words.get());
+    }
+
+    static std::size_t align(std::size_t x) noexcept {
+        return (x + WORD - 1) & ~(WORD - 1);
+    }
+
+    static std::size_t frame_size(std::size_t len) noexcept {
+        return align(HEADER + len);
+    }
+
+    static std::size_t round_up_pow2(std::size_t x) noexcept {
+        std::size_t p = 1;
+        while (p < x) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    /**
+     * \brief   Waits until the consumer has freed the space up to the given
+     *          position.
+     * \param   end     The position the claimed space ends at.
+     */
+    void wait_for_space(std::uint64_t end) const noexcept {
+        while (end > head.load(std::memory_order_acquire) + cap) {
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * \brief   Writes a record into claimed space and publishes it.
+     * \param   offset  The offset of the frame in the ring.
+     * \param   data    The record's payload.
+     * \param   len     The length of the payload.
+     */
+    void publish(std::size_t offset, const void* data, std::size_t len) noexcept {
+        std::memcpy(static_cast<void*>(bytes() + offset + HEADER), data, len);
+        words[offset / WORD].store(static_cast<std::uint64_t>(HEADER + len), std::memory_order_release);
+    }
+
+    /**
+     * \brief   Publishes a padding frame covering claimed space.
+     * \param   offset  The offset of the frame in the ring.
+     * \param   len     The length of the frame (a multiple of WORD).
+     */
+    void publish_padding(std::size_t offset, std::size_t len) noexcept {
+        words[offset / WORD].store(PADDING | static_cast<std::uint64_t>(len), std::memory_order_release);
+    }
+
+    /** The size of the ring, a power of two. */
+    const std::size_t cap;
+    /** The ring, accessed as words for the headers and as bytes otherwise. */
+    std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+    /** Producer state, padded onto its own cache line. (Padding is used in
+     *  preference to alignas as over-aligned types are not supported by
+     *  operator new before C++17.) */
+    char producer_pad[64];
+    /** The position up to which producers have claimed space. */
+    std::atomic<std::uint64_t> tail { 0 };
+    /** Consumer state, padded onto its own cache line. */
+    char consumer_pad[64];
+    /** The position up to which the consumer has read. */
+    std::atomic<std::uint64_t> head { 0 };
+    char end_pad[64];
+};
+
+#endif // _COMMON_MPSC_LOG_BUFFER_H
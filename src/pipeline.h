@@ -0,0 +1,363 @@
+/**
+ * \file   pipeline.h
+ * \author Jonathan Simmonds
+ * \brief  Staged processing pipeline of pinned threads connected by SPSC queues.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_PIPELINE_H
+#define _COMMON_PIPELINE_H
+
+#include <array>        // array
+#include <atomic>       // atomic
+#include <chrono>       // steady_clock, duration
+#include <cstdint>      // uint64_t
+#include <cstdlib>      // size_t
+#include <functional>   // cref
+#include <memory>       // unique_ptr
+#include <thread>       // thread
+#include <utility>      // declval, move
+#include <vector>       // vector
+
+#if defined(__linux__)
+#include <pthread.h>    // pthread_setaffinity_np
+#include <sched.h>      // cpu_set_t
+#endif
+
+#include "spsc_queue.h"
+#include "wait_strategy.h"
+
+
+/**
+ * \brief   Configuration of a pipeline.
+ */
+struct pipeline_options {
+    /** The CPU to pin each stage's thread to, by stage index. Stages with no
+     *  entry, or a negative one, are not pinned. Pinning is only supported on
+     *  Linux and is ignored elsewhere. */
+    std::vector<int> cpus;
+};
+
+/**
+ * \brief   Statistics for a single pipeline stage, as returned by
+ *          <tt>pipeline::stats()</tt>.
+ */
+struct stage_stats {
+    /** The number of items the stage has processed. */
+    std::uint64_t processed;
+    /** The number of items waiting in the stage's input queue. */
+    std::size_t queue_depth;
+    /** The capacity of the stage's input queue. */
+    std::size_t queue_capacity;
+    /** The mean number of items processed per second since the pipeline
+     *  started. */
+    double throughput;
+};
+
+namespace pipeline_detail {
+
+/** The maximum number of items a stage moves between queues at once. */
+static const std::size_t BATCH = 64;
+
+/**
+ * \brief   Pins the calling thread to a CPU.
+ * \param   cpu The CPU index. Ignored if negative.
+ */
+inline void pin_current_thread(int cpu) noexcept {
+#if defined(__linux__)
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    (void) cpu;
+#endif
+}
+
+/**
+ * \brief   A stage and, recursively, every stage after it. Each stage owns its
+ *          input queue, so the chain for the first stage owns the whole
+ *          pipeline.
+ *
+ * \param IN            The type of the stage's input.
+ * \param QUEUE_SIZE    The size of each queue.
+ * \param WAIT          The wait strategy of each queue.
+ * \param STAGES        The callables for this stage and those after it.
+ */
+template <typename IN, std::size_t QUEUE_SIZE, typename WAIT, typename... STAGES>
+struct chain;
+
+/** The last stage, whose results are discarded. */
+template <typename IN, std::size_t QUEUE_SIZE, typename WAIT, typename F>
+struct chain<IN, QUEUE_SIZE, WAIT, F> {
+
+    explicit chain(F f) : f(std::move(f)) {}
+
+    void start(std::vector<std::thread>& threads, const pipeline_options& options, std::size_t index) {
+        threads.emplace_back(&chain::run, this, std::cref(options), index);
+    }
+
+    void run(const pipeline_options& options, std::size_t index) {
+        pin_current_thread(index < options.cpus.size() ? options.cpus[index] : -1);
+        for (;;) {
+            // Read closed before popping so nothing pushed before it was set
+            // can be missed.
+            const bool was_closed = closed.load(std::memory_order_acquire);
+            const std::size_t n = input.pop_batch(batch.data(), BATCH);
+            if (n == 0) {
+                if (was_closed) {
+                    return;
+                }
+                wait_for_input();
+                continue;
+            }
+            for (std::size_t i = 0; i < n; i++) {
+                f(std::move(batch[i]));
+            }
+            processed.store(processed.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+    }
+
+    void wait_for_input() {
+        input.wait_not_empty([this]() { return closed.load(std::memory_order_acquire); });
+    }
+
+    /** Closes input, once nothing more will be pushed to it. */
+    void close() noexcept {
+        closed.store(true, std::memory_order_release);
+        input.wake();
+    }
+
+    void collect(stage_stats* out, double seconds) const noexcept {
+        out->processed = processed.load(std::memory_order_relaxed);
+        out->queue_depth = input.size();
+        out->queue_capacity = input.capacity();
+        out->throughput = seconds > 0 ? out->processed / seconds : 0;
+    }
+
+    spsc_queue<IN, QUEUE_SIZE, WAIT> input;
+    /** Set once nothing more will be pushed to input. */
+    std::atomic<bool> closed { false };
+    std::atomic<std::uint64_t> processed { 0 };
+    F f;
+    std::array<IN, BATCH> batch;
+};
+
+/** A stage whose results are passed to the next stage. */
+template <typename IN, std::size_t QUEUE_SIZE, typename WAIT, typename F, typename NEXT, typename... REST>
+struct chain<IN, QUEUE_SIZE, WAIT, F, NEXT, REST...> {
+    using OUT = decltype(std::declval<F&>()(std::declval<IN&&>()));
+    using next_type = chain<OUT, QUEUE_SIZE, WAIT, NEXT, REST...>;
+
+    chain(F f, NEXT next_f, REST... rest)
+            : f(std::move(f)), next(std::move(next_f), std::move(rest)...) {}
+
+    void start(std::vector<std::thread>& threads, const pipeline_options& options, std::size_t index) {
+        threads.emplace_back(&chain::run, this, std::cref(options), index);
+        next.start(threads, options, index + 1);
+    }
+
+    void run(const pipeline_options& options, std::size_t index) {
+        pin_current_thread(index < options.cpus.size() ? options.cpus[index] : -1);
+        for (;;) {
+            const bool was_closed = closed.load(std::memory_order_acquire);
+            const std::size_t n = input.pop_batch(batch.data(), BATCH);
+            if (n == 0) {
+                if (was_closed) {
+                    next.close();
+                    return;
+                }
+                wait_for_input();
+                continue;
+            }
+            for (std::size_t i = 0; i < n; i++) {
+                results[i] = f(std::move(batch[i]));
+            }
+            std::size_t pushed = 0;
+            while ((pushed += next.input.push_batch(results.data() + pushed, n - pushed)) < n) {
+                next.input.wait_not_full([]() { return false; });
+            }
+            processed.store(processed.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+    }
+
+    void wait_for_input() {
+        input.wait_not_empty([this]() { return closed.load(std::memory_order_acquire); });
+    }
+
+    /** Closes input, once nothing more will be pushed to it. */
+    void close() noexcept {
+        closed.store(true, std::memory_order_release);
+        input.wake();
+    }
+
+    void collect(stage_stats* out, double seconds) const noexcept {
+        out->processed = processed.load(std::memory_order_relaxed);
+        out->queue_depth = input.size();
+        out->queue_capacity = input.capacity();
+        out->throughput = seconds > 0 ? out->processed / seconds : 0;
+        next.collect(out + 1, seconds);
+    }
+
+    spsc_queue<IN, QUEUE_SIZE, WAIT> input;
+    /** Set once nothing more will be pushed to input. */
+    std::atomic<bool> closed { false };
+    std::atomic<std::uint64_t> processed { 0 };
+    F f;
+    std::array<IN, BATCH> batch;
+    std::array<OUT, BATCH> results;
+    next_type next;
+};
+
+} // namespace pipeline_detail
+
+
+/**
+ * \brief   Linear pipeline of processing stages, each running on its own
+ *          (optionally pinned) thread and connected to the next by an
+ *          spsc_queue.
+ *
+ * The topology is fixed at compile time: each stage is a callable taking the
+ * previous stage's result type by rvalue reference and returning its own
+ * result, except the last whose result is discarded. Stages are called
+ * directly, with no virtual dispatch or type erasure per item, and move items
+ * between queues in batches. Items are pushed into the first stage by the
+ * thread owning the pipeline. Use make_pipeline() to construct one, e.g.
+ * <tt>make_pipeline<packet>(options, decode, enrich, aggregate, persist)</tt>.
+ *
+ * Stages wait for input, and for space in the next stage's queue, using the
+ * WAIT strategy (see wait_strategy.h): busy_spin for stages pinned to
+ * isolated cores, spin_then_yield on shared hosts or futex_park where CPU use
+ * matters more than latency.
+ *
+ * \param IN            The type of the items pushed into the pipeline.
+ * \param QUEUE_SIZE    The size of each stage's input queue.
+ * \param WAIT          The wait strategy of the stages.
+ * \param STAGES        The types of the stage callables. Every item type
+ *                      passed between stages must be default constructible
+ *                      and movable.
+ */
+template <typename IN, std::size_t QUEUE_SIZE, typename WAIT, typename... STAGES>
+class pipeline {
+    static_assert(sizeof...(STAGES) > 0, "a pipeline needs at least one stage");
+
+public:
+    /** The number of stages. */
+    static const std::size_t STAGE_COUNT = sizeof...(STAGES);
+
+    /**
+     * \brief   Constructor, starting a thread for each stage.
+     * \param   options The CPU pinning of the stages.
+     * \param   stages  The stage callables, in order.
+     */
+    explicit pipeline(const pipeline_options& options, STAGES... stages)
+            : options(options)
+            , stages(std::move(stages)...)
+            , start_time(std::chrono::steady_clock::now()) {
+        this->stages.start(threads, this->options, 0);
+    }
+
+    /**
+     * \brief   Destructor. Waits for every item pushed to pass through the
+     *          pipeline, as finish() does.
+     */
+    ~pipeline() {
+        finish();
+    }
+
+    pipeline(const pipeline&) = delete;
+    pipeline& operator=(const pipeline&) = delete;
+
+    /**
+     * \brief   Pushes an item into the first stage, waiting (according to the
+     *          wait strategy) if its queue is full. Must not be called
+     *          concurrently with other pushes or after finish().
+     * \param   item    The item.
+     */
+    void push(IN item) {
+        stages.input.push(std::move(item));
+    }
+
+    /**
+     * \brief   Pushes an item into the first stage if its queue has space.
+     *          Must not be called concurrently with other pushes or after
+     *          finish().
+     * \param   item    The item. Left unchanged if the queue was full.
+     * \return  true if the item was pushed, false if the queue was full.
+     */
+    bool try_push(IN&& item) {
+        return stages.input.try_push(std::move(item));
+    }
+
+    /**
+     * \brief   Closes the pipeline to further items and waits for every item
+     *          already pushed to pass through every stage, then stops the
+     *          threads.
+     */
+    void finish() {
+        if (threads.empty()) {
+            return;
+        }
+        stages.close();
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        threads.clear();
+    }
+
+    /**
+     * \brief   Retrieves the statistics of every stage. May be called while
+     *          the pipeline is running, giving a (not necessarily consistent)
+     *          snapshot.
+     * \return  The statistics, by stage index.
+     */
+    std::array<stage_stats, STAGE_COUNT> stats() const {
+        std::array<stage_stats, STAGE_COUNT> result;
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        stages.collect(result.data(), elapsed.count());
+        return result;
+    }
+
+private:
+    const pipeline_options options;
+    pipeline_detail::chain<IN, QUEUE_SIZE, WAIT, STAGES...> stages;
+    const std::chrono::steady_clock::time_point start_time;
+    std::vector<std::thread> threads;
+};
+
+/**
+ * \brief   Constructs a pipeline, deducing the stage types.
+ * \param   options The CPU pinning of the stages.
+ * \param   stages  The stage callables, in order.
+ * \return  The running pipeline.
+ */
+template <typename IN, std::size_t QUEUE_SIZE = 1024, typename WAIT = spin_then_yield<>, typename... STAGES>
+std::unique_ptr<pipeline<IN, QUEUE_SIZE, WAIT, STAGES...>> make_pipeline(const pipeline_options& options,
+                                                                         STAGES... stages) {
+    return std::unique_ptr<pipeline<IN, QUEUE_SIZE, WAIT, STAGES...>>(
+            new pipeline<IN, QUEUE_SIZE, WAIT, STAGES...>(options, std::move(stages)...));
+}
+
+#endif // _COMMON_PIPELINE_H
@@ -0,0 +1,343 @@
+/**
+ * \file   reorder_buffer.h
+ * \author Jonathan Simmonds
+ * \brief  Fixed-size buffer restoring sequence order to out-of-order items.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_REORDER_BUFFER_H
+#define _COMMON_REORDER_BUFFER_H
+
+#include <array>        // array
+#include <chrono>       // steady_clock
+#include <cstdint>      // uint32_t, uint64_t
+#include <cstdlib>      // size_t
+#include <limits>       // numeric_limits
+#include <type_traits>  // is_unsigned
+#include <utility>      // move
+
+
+/**
+ * \brief   The outcome of inserting an item into a reorder_buffer.
+ */
+enum class reorder_result {
+    /** The item was buffered. */
+    accepted,
+    /** An item with the same sequence number is already buffered. */
+    duplicate,
+    /** The sequence number has already been released or skipped. */
+    late,
+    /** The sequence number is SIZE or more ahead of the next expected one.
+     *  The item was not buffered; use skip_to() to make room. */
+    overflow
+};
+
+/**
+ * \brief   Reorder (jitter) buffer which accepts items tagged with sequence
+ *          numbers in any order within a window and releases them in sequence
+ *          order.
+ *
+ * Items are stored in a ring of SIZE slots, indexed by their distance from
+ * the next expected sequence number and wrapping in the same way as
+ * circular_buffer. This is equivalent to <tt>seq % SIZE</tt> when SIZE
+ * divides the range of SEQ, but is also correct across the wrap of SEQ when
+ * it does not. A bitmap records which slots are present, so insertion is
+ * O(1) and never allocates. Releasing scans the bitmap a word at a time,
+ * delivering each contiguous run of present items in one batch.
+ * Sequence numbers may wrap around: they are compared by their (unsigned)
+ * distance from the next expected sequence number.
+ *
+ * Gaps which are never filled can be abandoned explicitly with skip_to(), or
+ * after a timeout with release_expired().
+ *
+ * \param T     The type of the items. Must be default constructible and
+ *              movable.
+ * \param SIZE  The size of the window, i.e. how far ahead of the next expected
+ *              sequence number items may be buffered.
+ * \param SEQ   The (unsigned) type of the sequence numbers.
+ */
+template <typename T, std::size_t SIZE, typename SEQ = std::uint32_t>
+class reorder_buffer {
+    static_assert(SIZE > 0, "SIZE must be > 0");
+    static_assert(std::is_unsigned<SEQ>::value, "SEQ must be unsigned");
+
+public:
+    /** The clock used for gap timeouts. */
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * \brief   Constructor, initialising an empty buffer.
+     * \param   first   The first sequence number expected.
+     */
+    explicit reorder_buffer(SEQ first = 0) noexcept : next(first) {}
+
+    /**
+     * \brief   Buffers an item.
+     * \param   seq     The item's sequence number.
+     * \param   item    The item.
+     * \param   now     The arrival time of the item, used by release_expired().
+     * \return  Whether the item was buffered, and if not why.
+     */
+    reorder_result insert(SEQ seq, T item, clock::time_point now = clock::now()) {
+        const SEQ ahead = static_cast<SEQ>(seq - next);
+        if (behind(ahead)) {
+            return reorder_result::late;
+        }
+        if (ahead >= SIZE) {
+            return reorder_result::overflow;
+        }
+        const std::size_t index = capped_mod(head + ahead);
+        if (test(index)) {
+            return reorder_result::duplicate;
+        }
+        slots[index] = std::move(item);
+        arrivals[index] = now;
+        present[index / BITS] |= bit(index);
+        count++;
+        return reorder_result::accepted;
+    }
+
+    /**
+     * \brief   Releases every item which is next in sequence, in order,
+     *          stopping at the first gap.
+     * \param   f   Callable invoked as <tt>f(SEQ seq, T&& item)</tt> for each
+     *              item released.
+     * \return  The number of items released.
+     */
+    template <typename F>
+    std::size_t release(F f) {
+        std::size_t released = 0;
+        while (count > 0) {
+            const std::size_t index = head;
+            const std::size_t word = index / BITS;
+            const std::size_t offset = index % BITS;
+            // The run of present items starting at index within this word (and
+            // before the end of the slots).
+            std::size_t run = count_trailing_ones(present[word] >> offset);
+            if (run > BITS - offset) {
+                run = BITS - offset;
+            }
+            if (run > SIZE - index) {
+                run = SIZE - index;
+            }
+            if (run == 0) {
+                break;
+            }
+            for (std::size_t i = 0; i < run; i++) {
+                f(static_cast<SEQ>(next + i), std::move(slots[index + i]));
+            }
+            present[word] &= ~mask(offset, run);
+            advance(run);
+            count -= run;
+            released += run;
+        }
+        return released;
+    }
+
+    /**
+     * \brief   Abandons every sequence number before the given one, discarding
+     *          any buffered items before it. Does nothing if seq is not ahead
+     *          of the next expected sequence number.
+     * \param   seq     The new next expected sequence number.
+     * \return  The number of buffered items discarded.
+     */
+    std::size_t skip_to(SEQ seq) noexcept {
+        const SEQ ahead = static_cast<SEQ>(seq - next);
+        if (ahead == 0 || behind(ahead)) {
+            return 0;
+        }
+        std::size_t discarded = 0;
+        if (ahead >= SIZE) {
+            discarded = count;
+            present.fill(0);
+            count = 0;
+        } else {
+            for (std::size_t i = 0; i < ahead; i++) {
+                const std::size_t index = capped_mod(head + i);
+                if (test(index)) {
+                    present[index / BITS] &= ~bit(index);
+                    discarded++;
+                }
+            }
+            count -= discarded;
+        }
+        skipped += static_cast<std::uint64_t>(ahead) - discarded;
+        next = seq;
+        head = capped_mod(head + static_cast<std::size_t>(ahead % SIZE));
+        return discarded;
+    }
+
+    /**
+     * \brief   Releases every item which is next in sequence, as release()
+     *          does, then repeatedly abandons the gap before the oldest
+     *          buffered item if that item has waited for longer than the
+     *          timeout, releasing the items after it.
+     * \param   now     The current time.
+     * \param   timeout How long an item may wait for a gap before it to fill.
+     * \param   f       Callable invoked as <tt>f(SEQ seq, T&& item)</tt> for
+     *                  each item released.
+     * \return  The number of items released.
+     */
+    template <typename F>
+    std::size_t release_expired(clock::time_point now, clock::duration timeout, F f) {
+        std::size_t released = release(f);
+        while (count > 0) {
+            const std::size_t index = first_present();
+            if (now - arrivals[index] < timeout) {
+                break;
+            }
+            const std::size_t gap = capped_mod(index + SIZE - head);
+            skipped += gap;
+            advance(gap);
+            released += release(f);
+        }
+        return released;
+    }
+
+    /**
+     * \brief   Retrieves the next sequence number to be released.
+     * \return  The next expected sequence number.
+     */
+    SEQ next_sequence() const noexcept {
+        return next;
+    }
+
+    /**
+     * \brief   Retrieves the number of items buffered awaiting release.
+     * \return  The number of items.
+     */
+    std::size_t pending() const noexcept {
+        return count;
+    }
+
+    /**
+     * \brief   Returns whether or not no items are buffered.
+     * \return  The state of the buffer.
+     */
+    bool empty() const noexcept {
+        return count == 0;
+    }
+
+    /**
+     * \brief   Retrieves the number of sequence numbers abandoned by skip_to()
+     *          or release_expired() without an item having been received.
+     * \return  The number of lost sequence numbers.
+     */
+    std::uint64_t lost() const noexcept {
+        return skipped;
+    }
+
+private:
+    /** The number of bits in a bitmap word. */
+    static const std::size_t BITS = 64;
+    /** The number of bitmap words. */
+    static const std::size_t WORDS = (SIZE + BITS - 1) / BITS;
+
+    /** Whether a distance ahead of next (modulo the range of SEQ) is more
+     *  than half the range, and so is really behind. */
+    static bool behind(SEQ ahead) noexcept {
+        return ahead > std::numeric_limits<SEQ>::max() / 2;
+    }
+
+    /** Wraps an index in [0, 2 * SIZE) into the slots. */
+    static std::size_t capped_mod(std::size_t x) noexcept {
+        return x < SIZE ? x : x - SIZE;
+    }
+
+    /** Moves the next sequence number forward by n < SIZE. */
+    void advance(std::size_t n) noexcept {
+        next = static_cast<SEQ>(next + n);
+        head = capped_mod(head + n);
+    }
+
+    static std::uint64_t bit(std::size_t index) noexcept {
+        return std::uint64_t(1) << (index % BITS);
+    }
+
+    /** A mask of run bits starting at offset (run <= BITS - offset). */
+    static std::uint64_t mask(std::size_t offset, std::size_t run) noexcept {
+        const std::uint64_t bits = run == BITS ? ~std::uint64_t(0) : (std::uint64_t(1) << run) - 1;
+        return bits << offset;
+    }
+
+    bool test(std::size_t index) const noexcept {
+        return (present[index / BITS] & bit(index)) != 0;
+    }
+
+    /**
+     * \brief   Finds the slot of the oldest buffered item. Must only be called
+     *          when the buffer is not empty.
+     * \return  The slot index.
+     */
+    std::size_t first_present() const noexcept {
+        std::size_t index = head;
+        for (;;) {
+            const std::size_t offset = index % BITS;
+            const std::uint64_t word = present[index / BITS] >> offset;
+            if (word != 0) {
+                // Bits past the end of the slots are never set.
+                return index + count_trailing_ones(~word);
+            }
+            index += BITS - offset;
+            if (index >= SIZE) {
+                index = 0;
+            }
+        }
+    }
+
+    /**
+     * \brief   Counts the number of trailing 1 bits in x.
+     * \param   x   The value to count the bits of.
+     * \return  The number of trailing 1 bits.
+     */
+    static inline std::size_t count_trailing_ones(std::uint64_t x) noexcept {
+        if (~x == 0) {
+            return BITS;
+        }
+#if defined(__GNUC__)
+        return static_cast<std::size_t>(__builtin_ctzll(~static_cast<unsigned long long>(x)));
+#else
+        std::size_t n = 0;
+        for (; x & 1; x >>= 1)
+            n++;
+        return n;
+#endif
+    }
+
+    /** The next sequence number to release. */
+    SEQ next;
+    /** The slot of the next sequence number. */
+    std::size_t head = 0;
+    /** The number of items buffered. */
+    std::size_t count = 0;
+    /** The number of sequence numbers abandoned without an item. */
+    std::uint64_t skipped = 0;
+    /** Which slots hold an item. */
+    std::array<std::uint64_t, WORDS> present {};
+    /** The items, in a ring starting at head. */
+    std::array<T, SIZE> slots {};
+    /** The arrival time of each item. */
+    std::array<clock::time_point, SIZE> arrivals {};
+};
+
+#endif // _COMMON_REORDER_BUFFER_H
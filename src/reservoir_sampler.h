@@ -0,0 +1,529 @@
+/**
+ * \file   reservoir_sampler.h
+ * \author Jonathan Simmonds
+ * \brief  Fixed-capacity random samples of unbounded streams.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_RESERVOIR_SAMPLER_H
+#define _COMMON_RESERVOIR_SAMPLER_H
+
+#include <algorithm>    // push_heap, pop_heap
+#include <array>        // array
+#include <cmath>        // exp, log, log1p, floor, nextafter
+#include <cstdint>      // uint64_t
+#include <cstdlib>      // size_t
+#include <limits>       // numeric_limits
+#include <random>       // mt19937_64, random_device, uniform_*_distribution, gamma_distribution
+#include <utility>      // forward, move
+
+
+namespace reservoir_detail {
+
+/**
+ * \brief   Draws a uniform random number in the open interval (0, 1), so its
+ *          logarithm is finite.
+ * \param   rng The random number generator.
+ * \return  The random number.
+ */
+template <typename RNG>
+double open_unit(RNG& rng) {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    double u;
+    do {
+        u = dist(rng);
+    } while (u <= 0.0);
+    return u;
+}
+
+/**
+ * \brief   Draws a uniform random index in <tt>[0, n)</tt>.
+ * \param   rng The random number generator.
+ * \param   n   The number of indices. Must be > 0.
+ * \return  The index.
+ */
+template <typename RNG>
+std::uint64_t uniform_index(RNG& rng, std::uint64_t n) {
+    return std::uniform_int_distribution<std::uint64_t>(0, n - 1)(rng);
+}
+
+/**
+ * \brief   Fixed-capacity set of the items with the highest priorities seen,
+ *          held in a min-heap so the lowest is replaced in O(log SIZE).
+ */
+template <typename T, std::size_t SIZE>
+class top_k {
+public:
+    struct entry {
+        double priority;
+        T item;
+    };
+
+    /**
+     * \brief   Keeps an item if its priority is among the highest SIZE.
+     */
+    template <typename U>
+    void offer(double priority, U&& item) {
+        if (count < SIZE) {
+            entries[count].priority = priority;
+            entries[count].item = std::forward<U>(item);
+            count++;
+            std::push_heap(entries.begin(), entries.begin() + count, lower_priority);
+        } else if (priority > entries[0].priority) {
+            std::pop_heap(entries.begin(), entries.end(), lower_priority);
+            entries[SIZE - 1].priority = priority;
+            entries[SIZE - 1].item = std::forward<U>(item);
+            std::push_heap(entries.begin(), entries.end(), lower_priority);
+        }
+    }
+
+    /** The lowest priority kept. Only valid when not empty. */
+    double min_priority() const noexcept {
+        return entries[0].priority;
+    }
+
+    std::size_t size() const noexcept {
+        return count;
+    }
+
+    const entry& operator[](std::size_t i) const noexcept {
+        return entries[i];
+    }
+
+    void clear() noexcept {
+        count = 0;
+    }
+
+private:
+    static bool lower_priority(const entry& a, const entry& b) noexcept {
+        return a.priority > b.priority;
+    }
+
+    std::array<entry, SIZE> entries {};
+    std::size_t count = 0;
+};
+
+} // namespace reservoir_detail
+
+
+/**
+ * \brief   Uniform random sample of up to SIZE items from a stream of unknown
+ *          length: after n items every subset of min(n, SIZE) of them is
+ *          equally likely to be the sample.
+ *
+ * Uses Algorithm L (Li, 1994): rather than drawing a random number for every
+ * item, it draws the number of items to skip before the next one enters the
+ * sample from a geometric distribution, so once the stream is much longer
+ * than SIZE almost every item costs only a decrement. Like circular_buffer,
+ * the items are stored inline and nothing is allocated.
+ *
+ * Samplers of separate streams (e.g. one per thread) can be merged into a
+ * uniform sample of the combined stream.
+ *
+ * \param T     The type of the items. Must be default constructible and
+ *              copyable.
+ * \param SIZE  The sample size.
+ * \param RNG   The random number engine.
+ */
+template <typename T, std::size_t SIZE, typename RNG = std::mt19937_64>
+class reservoir_sampler {
+    static_assert(SIZE > 0, "SIZE must be > 0");
+
+public:
+    /**
+     * \brief   Constructor.
+     * \param   seed    The seed of the random number engine. Samplers which
+     *                  are to be merged must be seeded differently.
+     */
+    explicit reservoir_sampler(typename RNG::result_type seed = std::random_device()()) : rng(seed) {}
+
+    /**
+     * \brief   Offers the next item of the stream to the sample.
+     * \param   item    The item.
+     */
+    template <typename U>
+    void offer(U&& item) {
+        seen_count++;
+        if (count < SIZE) {
+            items[count++] = std::forward<U>(item);
+            if (count == SIZE) {
+                // The largest of SIZE uniform keys.
+                w = std::exp(std::log(reservoir_detail::open_unit(rng)) / SIZE);
+                skip = next_skip();
+            }
+        } else if (skip > 0) {
+            skip--;
+        } else {
+            items[reservoir_detail::uniform_index(rng, SIZE)] = std::forward<U>(item);
+            w *= std::exp(std::log(reservoir_detail::open_unit(rng)) / SIZE);
+            skip = next_skip();
+        }
+    }
+
+    /**
+     * \brief   Merges the sample of another stream into this one, making it a
+     *          uniform sample of both streams together.
+     *
+     * The number of items to take from each sample follows the hypergeometric
+     * distribution of drawing from the two streams' populations without
+     * replacement; that many items are then chosen from each sample by
+     * selection sampling, in place.
+     *
+     * \param   other   The sampler to merge. Not modified.
+     */
+    void merge(const reservoir_sampler& other) {
+        std::uint64_t population_a = seen_count;
+        std::uint64_t population_b = other.seen_count;
+        const std::size_t total = count + other.count < SIZE ? count + other.count : SIZE;
+        std::size_t take_a = 0;
+        for (std::size_t i = 0; i < total; i++) {
+            if (reservoir_detail::uniform_index(rng, population_a + population_b) < population_a) {
+                take_a++;
+                population_a--;
+            } else {
+                population_b--;
+            }
+        }
+        const std::size_t take_b = total - take_a;
+        // Keep take_a of this sample's items, compacted to the front...
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < count && kept < take_a; i++) {
+            if (reservoir_detail::uniform_index(rng, count - i) < take_a - kept) {
+                // Items already in place must not be self-move-assigned.
+                if (kept != i) {
+                    items[kept] = std::move(items[i]);
+                }
+                kept++;
+            }
+        }
+        // ...followed by take_b of the other's.
+        std::size_t copied = 0;
+        for (std::size_t i = 0; i < other.count && copied < take_b; i++) {
+            if (reservoir_detail::uniform_index(rng, other.count - i) < take_b - copied) {
+                items[kept + copied++] = other.items[i];
+            }
+        }
+        count = total;
+        seen_count += other.seen_count;
+        if (count == SIZE) {
+            // The largest of the SIZE smallest of seen_count uniform keys is
+            // Beta(SIZE, seen_count - SIZE + 1) distributed.
+            std::gamma_distribution<double> x(static_cast<double>(SIZE), 1.0);
+            std::gamma_distribution<double> y(static_cast<double>(seen_count - SIZE + 1), 1.0);
+            const double a = x(rng);
+            w = a / (a + y(rng));
+            skip = next_skip();
+        }
+    }
+
+    /**
+     * \brief   Empties the sample, to start sampling a new stream.
+     */
+    void clear() noexcept {
+        count = 0;
+        seen_count = 0;
+        skip = 0;
+    }
+
+    /**
+     * \brief   Retrieves an item of the sample, in no particular order.
+     * \param   i   The index, which must be less than size().
+     * \return  The item.
+     */
+    const T& operator[](std::size_t i) const noexcept {
+        return items[i];
+    }
+
+    /**
+     * \brief   Retrieves the number of items in the sample.
+     * \return  The smaller of SIZE and seen().
+     */
+    std::size_t size() const noexcept {
+        return count;
+    }
+
+    /**
+     * \brief   Retrieves the number of items offered since the sampler was
+     *          constructed or cleared (including those merged in).
+     * \return  The length of the stream.
+     */
+    std::uint64_t seen() const noexcept {
+        return seen_count;
+    }
+
+private:
+    /**
+     * \brief   Draws the number of items to skip before the next one enters
+     *          the sample, from the geometric distribution with success
+     *          probability w.
+     */
+    std::uint64_t next_skip() {
+        const double s = std::floor(std::log(reservoir_detail::open_unit(rng)) / std::log1p(-w));
+        return s < static_cast<double>(std::numeric_limits<std::uint64_t>::max() / 2)
+                ? static_cast<std::uint64_t>(s) : std::numeric_limits<std::uint64_t>::max() / 2;
+    }
+
+    std::array<T, SIZE> items {};
+    std::size_t count = 0;
+    std::uint64_t seen_count = 0;
+    /** The number of items still to skip. */
+    std::uint64_t skip = 0;
+    /** The largest key in the sample, were every item given a uniform key
+     *  and the SIZE smallest kept. */
+    double w = 0;
+    RNG rng;
+};
+
+
+/**
+ * \brief   Weighted random sample of up to SIZE items from a stream, where
+ *          each item's chance of being sampled is proportional to its weight
+ *          (sampling without replacement).
+ *
+ * Uses A-ExpJ (Efraimidis and Spirakis, 2006): each item's key is
+ * <tt>u^(1/w)</tt> for uniform u and weight w, and the items with the SIZE
+ * largest keys are the sample. Rather than drawing a key for every item, it
+ * draws the total weight to skip before the next item enters the sample.
+ * Keys are held as <tt>ln(w) - ln(-ln u)</tt>, an order-preserving transform
+ * which cannot underflow for small weights. Nothing is allocated.
+ *
+ * Samplers of separate streams can be merged exactly by keeping the largest
+ * keys of both.
+ *
+ * \param T     The type of the items. Must be default constructible and
+ *              copyable.
+ * \param SIZE  The sample size.
+ * \param RNG   The random number engine.
+ */
+template <typename T, std::size_t SIZE, typename RNG = std::mt19937_64>
+class weighted_reservoir_sampler {
+    static_assert(SIZE > 0, "SIZE must be > 0");
+
+public:
+    /**
+     * \brief   Constructor.
+     * \param   seed    The seed of the random number engine.
+     */
+    explicit weighted_reservoir_sampler(typename RNG::result_type seed = std::random_device()()) : rng(seed) {}
+
+    /**
+     * \brief   Offers the next item of the stream to the sample.
+     * \param   item    The item.
+     * \param   weight  The item's weight. Must be > 0.
+     */
+    template <typename U>
+    void offer(U&& item, double weight) {
+        seen_count++;
+        if (sample.size() < SIZE) {
+            sample.offer(std::log(weight) - std::log(-std::log(reservoir_detail::open_unit(rng))),
+                         std::forward<U>(item));
+            if (sample.size() == SIZE) {
+                jump = next_jump();
+            }
+            return;
+        }
+        jump -= weight;
+        if (jump > 0) {
+            return;
+        }
+        // This item enters the sample: draw its key conditioned on exceeding
+        // the smallest, i.e. u uniform in (T^w, 1) for threshold key T.
+        const double log_threshold = -std::exp(-sample.min_priority());
+        const double low = std::exp(weight * log_threshold);
+        double u = low + (1.0 - low) * reservoir_detail::open_unit(rng);
+        if (!(u < 1.0)) {
+            u = std::nextafter(1.0, 0.0);
+        }
+        sample.offer(std::log(weight) - std::log(-std::log(u)), std::forward<U>(item));
+        jump = next_jump();
+    }
+
+    /**
+     * \brief   Merges the sample of another stream into this one, making it a
+     *          weighted sample of both streams together.
+     * \param   other   The sampler to merge. Not modified.
+     */
+    void merge(const weighted_reservoir_sampler& other) {
+        for (std::size_t i = 0; i < other.sample.size(); i++) {
+            sample.offer(other.sample[i].priority, other.sample[i].item);
+        }
+        seen_count += other.seen_count;
+        if (sample.size() == SIZE) {
+            jump = next_jump();
+        }
+    }
+
+    /**
+     * \brief   Empties the sample, to start sampling a new stream.
+     */
+    void clear() noexcept {
+        sample.clear();
+        seen_count = 0;
+    }
+
+    /**
+     * \brief   Retrieves an item of the sample, in no particular order.
+     * \param   i   The index, which must be less than size().
+     * \return  The item.
+     */
+    const T& operator[](std::size_t i) const noexcept {
+        return sample[i].item;
+    }
+
+    /**
+     * \brief   Retrieves the number of items in the sample.
+     * \return  The smaller of SIZE and seen().
+     */
+    std::size_t size() const noexcept {
+        return sample.size();
+    }
+
+    /**
+     * \brief   Retrieves the number of items offered since the sampler was
+     *          constructed or cleared (including those merged in).
+     * \return  The length of the stream.
+     */
+    std::uint64_t seen() const noexcept {
+        return seen_count;
+    }
+
+private:
+    /**
+     * \brief   Draws the total weight to skip before the next item enters the
+     *          sample: <tt>ln(r) / ln(T)</tt> for uniform r and threshold key T.
+     */
+    double next_jump() {
+        const double log_threshold = -std::exp(-sample.min_priority());
+        return std::log(reservoir_detail::open_unit(rng)) / log_threshold;
+    }
+
+    reservoir_detail::top_k<T, SIZE> sample;
+    std::uint64_t seen_count = 0;
+    /** The weight still to skip. */
+    double jump = 0;
+    RNG rng;
+};
+
+
+/**
+ * \brief   Random sample of up to SIZE items from a stream, biased towards
+ *          recent items: an item offered at time t is weighted by
+ *          <tt>exp(lambda * t)</tt>, so an item's weight relative to newer
+ *          ones halves every <tt>ln(2) / lambda</tt>.
+ *
+ * This is forward decay applied to weighted sampling: the key of each item is
+ * <tt>lambda * t - ln(-ln u)</tt> for uniform u (the weighted sampler's key
+ * with the weight's logarithm substituted), so the weights never need
+ * computing and cannot overflow however long the stream runs. Every item
+ * costs a random number and an O(log SIZE) heap update if it is kept.
+ * Nothing is allocated.
+ *
+ * Samplers with the same lambda can be merged exactly by keeping the largest
+ * keys of both.
+ *
+ * \param T     The type of the items. Must be default constructible and
+ *              copyable.
+ * \param SIZE  The sample size.
+ * \param RNG   The random number engine.
+ */
+template <typename T, std::size_t SIZE, typename RNG = std::mt19937_64>
+class decayed_reservoir_sampler {
+    static_assert(SIZE > 0, "SIZE must be > 0");
+
+public:
+    /**
+     * \brief   Constructor.
+     * \param   lambda  The decay rate, per unit of time. 0 samples uniformly.
+     * \param   seed    The seed of the random number engine.
+     */
+    explicit decayed_reservoir_sampler(double lambda,
+                                       typename RNG::result_type seed = std::random_device()())
+            : lambda(lambda), rng(seed) {}
+
+    /**
+     * \brief   Offers the next item of the stream to the sample.
+     * \param   item    The item.
+     * \param   time    The time of the item, in the units of lambda. Need not
+     *                  be monotonic.
+     */
+    template <typename U>
+    void offer(U&& item, double time) {
+        seen_count++;
+        const double priority = lambda * time - std::log(-std::log(reservoir_detail::open_unit(rng)));
+        sample.offer(priority, std::forward<U>(item));
+    }
+
+    /**
+     * \brief   Merges the sample of another stream into this one.
+     * \param   other   The sampler to merge, which must have the same lambda.
+     *                  Not modified.
+     */
+    void merge(const decayed_reservoir_sampler& other) {
+        for (std::size_t i = 0; i < other.sample.size(); i++) {
+            sample.offer(other.sample[i].priority, other.sample[i].item);
+        }
+        seen_count += other.seen_count;
+    }
+
+    /**
+     * \brief   Empties the sample, to start sampling a new stream.
+     */
+    void clear() noexcept {
+        sample.clear();
+        seen_count = 0;
+    }
+
+    /**
+     * \brief   Retrieves an item of the sample, in no particular order.
+     * \param   i   The index, which must be less than size().
+     * \return  The item.
+     */
+    const T& operator[](std::size_t i) const noexcept {
+        return sample[i].item;
+    }
+
+    /**
+     * \brief   Retrieves the number of items in the sample.
+     * \return  The smaller of SIZE and seen().
+     */
+    std::size_t size() const noexcept {
+        return sample.size();
+    }
+
+    /**
+     * \brief   Retrieves the number of items offered since the sampler was
+     *          constructed or cleared (including those merged in).
+     * \return  The length of the stream.
+     */
+    std::uint64_t seen() const noexcept {
+        return seen_count;
+    }
+
+private:
+    const double lambda;
+    reservoir_detail::top_k<T, SIZE> sample;
+    std::uint64_t seen_count = 0;
+    RNG rng;
+};
+
+#endif // _COMMON_RESERVOIR_SAMPLER_H
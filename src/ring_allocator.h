@@ -0,0 +1,322 @@
+/**
+ * \file   ring_allocator.h
+ * \author Jonathan Simmonds
+ * \brief  Bump allocator which reclaims memory in FIFO order.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_RING_ALLOCATOR_H
+#define _COMMON_RING_ALLOCATOR_H
+
+#include <cstddef>  // max_align_t
+#include <cstdint>  // uintptr_t
+#include <cstdlib>  // size_t
+#include <cstring>  // memcpy
+#include <memory>   // unique_ptr
+#include <new>      // bad_alloc
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>  // pmr::memory_resource
+#define _COMMON_RING_ALLOCATOR_PMR 1
+#endif
+#endif
+
+
+/**
+ * \brief   Allocator for variable-sized chunks whose lifetimes are (mostly)
+ *          first-in first-out, such as request-scoped temporaries.
+ *
+ * Chunks are bump-allocated from the head of a contiguous region and
+ * reclaimed from its tail, wrapping around the end of the region in the same
+ * way as circular_buffer. Allocation and reclamation are O(1) pointer bumps
+ * and the free space is always at most two contiguous runs, so there is no
+ * fragmentation. Chunks may be freed in any order, but a chunk's memory is
+ * only reused once every chunk allocated before it has also been freed.
+ *
+ * Each chunk carries a small header (24 bytes plus alignment padding).
+ * Not thread-safe.
+ */
+class ring_allocator {
+public:
+    /**
+     * \brief   Constructor, allocating the region from the heap.
+     * \param   bytes   The size of the region.
+     */
+    explicit ring_allocator(std::size_t bytes)
+            : owned(new unsigned char[bytes + UNIT]) {
+        init(owned.get(), bytes + UNIT);
+    }
+
+    /**
+     * \brief   Constructor, using an existing region. The region is not freed
+     *          by the allocator and must outlive it.
+     * \param   region  The start of the region.
+     * \param   bytes   The size of the region.
+     */
+    ring_allocator(void* region, std::size_t bytes) noexcept {
+        init(static_cast<unsigned char*>(region), bytes);
+    }
+
+    ring_allocator(const ring_allocator&) = delete;
+    ring_allocator& operator=(const ring_allocator&) = delete;
+
+    /**
+     * \brief   Allocates a chunk of memory.
+     * \param   bytes       The size of the chunk.
+     * \param   alignment   The alignment of the chunk. Must be a power of two.
+     * \return  Pointer to the chunk.
+     * \throws  std::bad_alloc  If there is not enough contiguous free space.
+     */
+    void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+        void* p = try_allocate(bytes, alignment);
+        if (p == nullptr) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    /**
+     * \brief   Allocates a chunk of memory.
+     * \param   bytes       The size of the chunk.
+     * \param   alignment   The alignment of the chunk. Must be a power of two.
+     * \return  Pointer to the chunk, or nullptr if there is not enough
+     *          contiguous free space.
+     */
+    void* try_allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) noexcept {
+        // Requests which can never fit are rejected up front, which also keeps
+        // the chunk size arithmetic below from overflowing.
+        if (bytes > cap || alignment > cap) {
+            return nullptr;
+        }
+        if (used == 0) {
+            // Start again from the beginning to maximise the contiguous space.
+            head = tail = 0;
+        }
+        const bool wrapped = used > 0 && head <= tail;
+        // Either there is space between the head and the tail...
+        const std::size_t limit = wrapped ? tail : cap;
+        std::size_t size = chunk_size(head, bytes, alignment);
+        if (head + size <= limit) {
+            return place(head, size, alignment);
+        }
+        if (wrapped) {
+            return nullptr;
+        }
+        // ...or, when not wrapped, between the start and the tail.
+        size = chunk_size(0, bytes, alignment);
+        if (size > tail) {
+            return nullptr;
+        }
+        if (head < cap) {
+            // Mark the unusable end of the region as an already-freed chunk.
+            chunk* pad = chunk_at(head);
+            pad->size = cap - head;
+            pad->freed = 1;
+            used += pad->size;
+        }
+        head = 0;
+        return place(0, size, alignment);
+    }
+
+    /**
+     * \brief   Frees a chunk. Its memory, and that of any chunks freed after
+     *          it, is reclaimed once every older chunk is also freed.
+     * \param   p   Pointer to the chunk, as returned by allocate().
+     */
+    void deallocate(void* p) noexcept {
+        unsigned char* user = static_cast<unsigned char*>(p);
+        std::size_t offset;
+        std::memcpy(&offset, user - sizeof(std::size_t), sizeof(offset));
+        chunk_at(static_cast<std::size_t>(user - base) - offset)->freed = 1;
+        while (used > 0) {
+            chunk* oldest = chunk_at(tail);
+            if (!oldest->freed) {
+                break;
+            }
+            tail += oldest->size;
+            used -= oldest->size;
+            if (tail == cap) {
+                tail = 0;
+            }
+        }
+    }
+
+    /**
+     * \brief   Retrieves the number of bytes in the region (after alignment).
+     * \return  The capacity in bytes.
+     */
+    std::size_t capacity() const noexcept {
+        return cap;
+    }
+
+    /**
+     * \brief   Retrieves the number of bytes not yet reclaimed, including
+     *          chunk headers and padding.
+     * \return  The number of bytes in use.
+     */
+    std::size_t used_bytes() const noexcept {
+        return used;
+    }
+
+    /**
+     * \brief   Returns whether or not every chunk has been reclaimed.
+     * \return  The state of the allocator.
+     */
+    bool empty() const noexcept {
+        return used == 0;
+    }
+
+private:
+    /** The granularity of chunks. Every chunk starts at a multiple of this
+     *  from the base of the region. */
+    static const std::size_t UNIT = alignof(std::max_align_t) < 16 ? 16 : alignof(std::max_align_t);
+
+    /** The header at the start of every chunk. */
+    struct chunk {
+        std::size_t size;   // Bytes in the chunk including the header.
+        std::size_t freed;  // Non-zero once freed.
+    };
+
+    void init(unsigned char* region, std::size_t bytes) noexcept {
+        const std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(region);
+        const std::size_t skip = static_cast<std::size_t>((UNIT - addr % UNIT) % UNIT);
+        base = region + skip;
+        cap = bytes > skip ? (bytes - skip) / UNIT * UNIT : 0;
+    }
+
+    chunk* chunk_at(std::size_t offset) const noexcept {
+        return reinterpret_cast<chunk*>(base + offset);
+    }
+
+    /**
+     * \brief   Calculates the size of a chunk starting at the given offset.
+     * \param   offset      The offset of the chunk from the base.
+     * \param   bytes       The size requested by the user.
+     * \param   alignment   The alignment requested by the user.
+     * \return  The chunk size, a multiple of UNIT. Only valid for bytes and
+     *          alignment no larger than the capacity.
+     */
+    std::size_t chunk_size(std::size_t offset, std::size_t bytes, std::size_t alignment) const noexcept {
+        return round_up(user_offset(offset, alignment) + bytes - offset, UNIT);
+    }
+
+    /**
+     * \brief   Calculates where the user's memory starts for a chunk starting
+     *          at the given offset: after the header and the back-offset (the
+     *          distance back to the header, used to find it when freeing),
+     *          aligned as requested.
+     * \param   offset      The offset of the chunk from the base.
+     * \param   alignment   The alignment requested by the user.
+     * \return  The offset of the user's memory from the base.
+     */
+    std::size_t user_offset(std::size_t offset, std::size_t alignment) const noexcept {
+        const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(base) + offset +
+                                     sizeof(chunk) + sizeof(std::size_t);
+        const std::uintptr_t aligned = (start + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+        return static_cast<std::size_t>(aligned - reinterpret_cast<std::uintptr_t>(base));
+    }
+
+    /**
+     * \brief   Writes a chunk's header and back-offset and advances the head.
+     * \param   offset      The offset of the chunk from the base.
+     * \param   size        The chunk size.
+     * \param   alignment   The alignment requested by the user.
+     * \return  Pointer to the user's memory.
+     */
+    void* place(std::size_t offset, std::size_t size, std::size_t alignment) noexcept {
+        chunk* c = chunk_at(offset);
+        c->size = size;
+        c->freed = 0;
+        unsigned char* user = base + user_offset(offset, alignment);
+        const std::size_t back = static_cast<std::size_t>(user - (base + offset));
+        std::memcpy(user - sizeof(std::size_t), &back, sizeof(back));
+        head = offset + size;
+        used += size;
+        return user;
+    }
+
+    static std::size_t round_up(std::size_t x, std::size_t to) noexcept {
+        return (x + to - 1) / to * to;
+    }
+
+    /** The region, if owned. */
+    std::unique_ptr<unsigned char[]> owned;
+    /** The start of the region, aligned to UNIT. */
+    unsigned char* base = nullptr;
+    /** The usable size of the region, a multiple of UNIT. */
+    std::size_t cap = 0;
+    /** The offset of the next chunk to allocate. */
+    std::size_t head = 0;
+    /** The offset of the oldest chunk not yet reclaimed. */
+    std::size_t tail = 0;
+    /** The number of bytes between the tail and the head. */
+    std::size_t used = 0;
+};
+
+#ifdef _COMMON_RING_ALLOCATOR_PMR
+/**
+ * \brief   Polymorphic memory resource backed by a ring_allocator, for use
+ *          with the <tt>std::pmr</tt> containers. Only available in C++17.
+ */
+class ring_memory_resource : public std::pmr::memory_resource {
+public:
+    /**
+     * \brief   Constructor, allocating the region from the heap.
+     * \param   bytes   The size of the region.
+     */
+    explicit ring_memory_resource(std::size_t bytes) : ring(bytes) {}
+
+    /**
+     * \brief   Constructor, using an existing region.
+     * \param   region  The start of the region.
+     * \param   bytes   The size of the region.
+     */
+    ring_memory_resource(void* region, std::size_t bytes) noexcept : ring(region, bytes) {}
+
+    /**
+     * \brief   Retrieves the underlying allocator.
+     * \return  The allocator.
+     */
+    const ring_allocator& allocator() const noexcept {
+        return ring;
+    }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        return ring.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t, std::size_t) override {
+        ring.deallocate(p);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    ring_allocator ring;
+};
+#endif
+
+#endif // _COMMON_RING_ALLOCATOR_H
@@ -0,0 +1,331 @@
+/**
+ * \file   ring_notifier.h
+ * \author Jonathan Simmonds
+ * \brief  File descriptor notifications for queue consumers in event loops.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_RING_NOTIFIER_H
+#define _COMMON_RING_NOTIFIER_H
+
+#include <array>        // array
+#include <atomic>       // atomic, atomic_thread_fence
+#include <cerrno>       // errno, EINTR
+#include <cstdint>      // uint64_t
+#include <cstdlib>      // size_t
+#include <limits>       // numeric_limits
+#include <system_error> // system_error, system_category
+#include <utility>      // move
+
+#include <fcntl.h>      // fcntl, O_NONBLOCK, FD_CLOEXEC
+#include <unistd.h>     // pipe, read, write, close
+#if defined(__linux__)
+#include <sys/eventfd.h> // eventfd
+#endif
+
+#include "spsc_queue.h"
+
+
+/**
+ * \brief   File descriptor which becomes readable when a producer signals a
+ *          consumer, so a consumer can wait for a queue in an epoll (or
+ *          poll/select) event loop rather than on a condition variable.
+ *
+ * Signals are coalesced: once signalled, further signals do nothing (not even
+ * a system call) until the consumer re-arms the notifier, so a burst of
+ * pushes costs a single <tt>write()</tt>. Uses an eventfd on Linux, or a
+ * non-blocking pipe elsewhere (or on request). Requires POSIX.
+ */
+class ring_notifier {
+public:
+    /**
+     * \brief   Constructor, creating the file descriptor(s).
+     * \param   use_pipe    Whether to use a pipe even where eventfd is
+     *                      available.
+     * \throws  std::system_error   If the file descriptor(s) cannot be
+     *                              created.
+     */
+    explicit ring_notifier(bool use_pipe = false) {
+#if defined(__linux__)
+        if (!use_pipe) {
+            read_fd = write_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (read_fd < 0) {
+                throw std::system_error(errno, std::system_category(), "eventfd");
+            }
+            return;
+        }
+#else
+        (void) use_pipe;
+#endif
+        int fds[2];
+        if (pipe(fds) != 0) {
+            throw std::system_error(errno, std::system_category(), "pipe");
+        }
+        for (int fd : fds) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        read_fd = fds[0];
+        write_fd = fds[1];
+    }
+
+    /**
+     * \brief   Destructor, closing the file descriptor(s).
+     */
+    ~ring_notifier() {
+        close(read_fd);
+        if (write_fd != read_fd) {
+            close(write_fd);
+        }
+    }
+
+    ring_notifier(const ring_notifier&) = delete;
+    ring_notifier& operator=(const ring_notifier&) = delete;
+
+    /**
+     * \brief   Retrieves the file descriptor to wait on for readability.
+     * \return  The file descriptor.
+     */
+    int fd() const noexcept {
+        return read_fd;
+    }
+
+    /**
+     * \brief   Signals the consumer, unless it has already been signalled
+     *          since it last re-armed. Called by the producer after making
+     *          data available.
+     */
+    void notify() noexcept {
+        // Order the data being made available before reading the flag, pairing
+        // with the fence in rearm(): either the consumer sees the data after
+        // re-arming or this sees the flag cleared.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!signalled.load(std::memory_order_relaxed) && !signalled.exchange(true, std::memory_order_acq_rel)) {
+            write_signal();
+        }
+    }
+
+    /**
+     * \brief   Consumes any pending signal, so the file descriptor is no
+     *          longer readable. Does not re-arm the notifier. Called by the
+     *          consumer when the file descriptor becomes readable.
+     */
+    void consume() noexcept {
+        std::uint64_t value;
+        for (;;) {
+            const ssize_t n = read(read_fd, &value, sizeof(value));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            // An eventfd is emptied by a single read; a pipe may hold several
+            // signals.
+            if (n <= 0 || read_fd == write_fd) {
+                break;
+            }
+        }
+    }
+
+    /**
+     * \brief   Re-arms the notifier so the next notify() signals again. The
+     *          consumer must check for data after re-arming, as data made
+     *          available before it did not signal.
+     */
+    void rearm() noexcept {
+        signalled.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    /**
+     * \brief   Makes the file descriptor readable again without re-arming,
+     *          for a consumer which stops before it has consumed all the data.
+     */
+    void resignal() noexcept {
+        write_signal();
+    }
+
+private:
+    void write_signal() noexcept {
+        const std::uint64_t one = 1;
+        // A full pipe (or eventfd counter) is already readable, so a failed
+        // write can be ignored.
+        while (write(write_fd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+    }
+
+    int read_fd = -1;
+    int write_fd = -1;
+    /** Whether the consumer has been signalled since it last re-armed. */
+    std::atomic<bool> signalled { false };
+};
+
+
+/**
+ * \brief   spsc_queue which signals a ring_notifier when an item is pushed
+ *          onto it, for consumers running in an event loop.
+ *
+ * The consumer adds <tt>fd()</tt> to its event loop and calls drain() when it
+ * becomes readable. Only a push which finds the consumer armed costs a system
+ * call, so a burst of pushes between drains costs one.
+ *
+ * \param T     The type stored in the queue. Must be default constructible and
+ *              movable.
+ * \param SIZE  The number of slots. The capacity is <tt>SIZE - 1</tt>.
+ */
+template <typename T, std::size_t SIZE>
+class notifying_spsc_queue {
+public:
+    /** The type this queue stores. */
+    using value_type = T;
+
+    /**
+     * \brief   Constructor, initialising an empty queue.
+     * \param   use_pipe    Whether to notify with a pipe even where eventfd is
+     *                      available.
+     */
+    explicit notifying_spsc_queue(bool use_pipe = false) : notifier(use_pipe) {}
+
+    /**
+     * \brief   Retrieves the file descriptor which becomes readable when items
+     *          are pushed.
+     * \return  The file descriptor.
+     */
+    int fd() const noexcept {
+        return notifier.fd();
+    }
+
+    /**
+     * \brief   Moves an item onto the back of the queue if there is space,
+     *          notifying the consumer. Must only be called by the producer.
+     * \param   item    The item to move. Left unchanged if the queue was full.
+     * \return  true if the item was pushed, false if the queue was full.
+     */
+    bool try_push(T&& item) {
+        if (!queue.try_push(std::move(item))) {
+            return false;
+        }
+        notifier.notify();
+        return true;
+    }
+
+    /**
+     * \brief   Copies an item onto the back of the queue if there is space,
+     *          notifying the consumer. Must only be called by the producer.
+     * \param   item    The item to copy.
+     * \return  true if the item was pushed, false if the queue was full.
+     */
+    bool try_push(const T& item) {
+        T copy(item);
+        return try_push(std::move(copy));
+    }
+
+    /**
+     * \brief   Moves as many items as there is space for onto the back of the
+     *          queue, notifying the consumer once. Must only be called by the
+     *          producer.
+     * \param   items   The items to move.
+     * \param   count   The number of items.
+     * \return  The number of items pushed.
+     */
+    std::size_t push_batch(T* items, std::size_t count) {
+        const std::size_t n = queue.push_batch(items, count);
+        if (n > 0) {
+            notifier.notify();
+        }
+        return n;
+    }
+
+    /**
+     * \brief   Pops items in batches until the queue is empty, then re-arms
+     *          the notification. Must only be called by the consumer, typically
+     *          when <tt>fd()</tt> is readable.
+     *
+     * If max items are popped first it stops early and leaves
+     * <tt>fd()</tt> readable, so a level-triggered event loop calls it again.
+     *
+     * \param   f   Callable invoked as <tt>f(T&& item)</tt> for each item.
+     * \param   max The maximum number of items to pop.
+     * \return  The number of items popped.
+     */
+    template <typename F>
+    std::size_t drain(F f, std::size_t max = std::numeric_limits<std::size_t>::max()) {
+        notifier.consume();
+        std::size_t total = 0;
+        for (;;) {
+            while (total < max) {
+                const std::size_t want = max - total < BATCH ? max - total : BATCH;
+                const std::size_t n = queue.pop_batch(batch.data(), want);
+                for (std::size_t i = 0; i < n; i++) {
+                    f(std::move(batch[i]));
+                }
+                total += n;
+                if (n < want) {
+                    break;
+                }
+            }
+            if (total >= max) {
+                // Stopped early: stay signalled so the event loop returns.
+                if (!queue.empty()) {
+                    notifier.resignal();
+                    return total;
+                }
+            }
+            // Re-arm, then check for items pushed while still signalled, whose
+            // producers did not notify.
+            notifier.rearm();
+            if (queue.empty()) {
+                return total;
+            }
+            if (total >= max) {
+                notifier.resignal();
+                return total;
+            }
+        }
+    }
+
+    /**
+     * \brief   Retrieves the number of items in the queue. Only a snapshot
+     *          when called while the other thread is using the queue.
+     * \return  The number of items.
+     */
+    std::size_t size() const noexcept {
+        return queue.size();
+    }
+
+    /**
+     * \brief   Retrieves the maximum number of items the queue can hold.
+     * \return  The capacity, <tt>SIZE - 1</tt>.
+     */
+    constexpr std::size_t capacity() const noexcept {
+        return SIZE - 1;
+    }
+
+private:
+    /** The maximum number of items popped at once by drain(). */
+    static const std::size_t BATCH = 64;
+
+    spsc_queue<T, SIZE> queue;
+    ring_notifier notifier;
+    /** drain()'s batch of popped items. Only used by the consumer. */
+    std::array<T, BATCH> batch;
+};
+
+#endif // _COMMON_RING_NOTIFIER_H
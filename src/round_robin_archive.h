@@ -0,0 +1,261 @@
+/**
+ * \file   round_robin_archive.h
+ * \author Jonathan Simmonds
+ * \brief  Fixed-size multi-resolution archive of consolidated samples.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_ROUND_ROBIN_ARCHIVE_H
+#define _COMMON_ROUND_ROBIN_ARCHIVE_H
+
+#include <array>        // array
+#include <cstdlib>      // size_t
+#include <type_traits>  // true_type, integral_constant
+
+#include "circular_buffer.h"
+
+
+/**
+ * \brief   How the samples in a bucket of a coarser level are combined.
+ */
+enum class consolidation {
+    average,
+    min,
+    max,
+    last
+};
+
+/**
+ * \brief   Round-robin archive (in the style of RRDtool) holding a series of
+ *          samples at several resolutions in bounded memory.
+ *
+ * The archive is a cascade of levels, each a ring of SIZE buckets. Level 0
+ * holds the raw samples. Each bucket of level i + 1 consolidates
+ * FACTORS[i] consecutive buckets of level i, so the levels cover
+ * progressively longer spans of history at progressively coarser resolution,
+ * e.g. <tt>round_robin_archive<double, 60, 60, 24></tt> fed once a second
+ * holds a minute of seconds, an hour of minutes and a day of hours.
+ *
+ * Each level keeps a running accumulator for the bucket it is building, so a
+ * sample is consolidated as it arrives rather than by re-reading the finer
+ * level: push() is O(1) (at most one update per level). Once a level is full
+ * its oldest bucket is overwritten, so memory use is fixed.
+ *
+ * \param T         The type of the samples. Must be default constructible,
+ *                  copyable and, depending on the consolidation used, support
+ *                  <tt>+</tt>, <tt>/</tt> (by a T constructed from a count) and
+ *                  <tt><</tt>.
+ * \param SIZE      The number of buckets in each level.
+ * \param FACTORS   The number of buckets of each level consolidated into one
+ *                  bucket of the next. Each must be >= 1.
+ */
+template <typename T, std::size_t SIZE, std::size_t... FACTORS>
+class round_robin_archive {
+    static_assert(SIZE > 0, "SIZE must be > 0");
+
+    /** Whether every one of a list of factors is non-zero. */
+    template <std::size_t... NS>
+    struct all_positive : std::true_type {};
+    template <std::size_t N, std::size_t... NS>
+    struct all_positive<N, NS...>
+            : std::integral_constant<bool, N != 0 && all_positive<NS...>::value> {};
+    static_assert(all_positive<FACTORS...>::value, "FACTORS must be > 0");
+
+public:
+    /** The number of levels, including the raw samples. */
+    static const std::size_t LEVELS = 1 + sizeof...(FACTORS);
+
+    /** The ring holding a single level, oldest bucket first. */
+    using level_type = circular_buffer<T, SIZE + 1>;
+
+    /**
+     * \brief   Constructor, initialising an empty archive.
+     * \param   method  How buckets of the coarser levels are consolidated.
+     */
+    explicit round_robin_archive(consolidation method = consolidation::average)
+            : consolidation_method(method) {
+        // The trailing 1 avoids a zero-length array when there are no factors.
+        const std::size_t factors[] = { FACTORS..., 1 };
+        resolutions[0] = 1;
+        for (std::size_t i = 1; i < LEVELS; i++) {
+            resolutions[i] = resolutions[i - 1] * factors[i - 1];
+        }
+    }
+
+    /**
+     * \brief   Adds a sample, consolidating it into every coarser level.
+     * \param   sample  The sample to add.
+     */
+    void push(const T& sample) {
+        levels[0].push_back(sample);
+        sample_count++;
+        T value = sample;
+        for (std::size_t i = 1; i < LEVELS; i++) {
+            accumulator& acc = accumulators[i - 1];
+            accumulate(acc, value);
+            if (acc.count < resolutions[i] / resolutions[i - 1]) {
+                break;
+            }
+            // The bucket is complete: it becomes a sample of the next level.
+            value = consolidated(acc);
+            acc.count = 0;
+            levels[i].push_back(value);
+        }
+    }
+
+    /**
+     * \brief   Chooses the finest level whose buckets span at least the given
+     *          number of raw samples in total, or the coarsest level if none
+     *          do.
+     * \param   span    The number of raw samples to cover.
+     * \return  The index of the level.
+     */
+    std::size_t select_level(std::size_t span) const noexcept {
+        for (std::size_t i = 0; i < LEVELS; i++) {
+            if (span <= SIZE * resolutions[i]) {
+                return i;
+            }
+        }
+        return LEVELS - 1;
+    }
+
+    /**
+     * \brief   Visits the buckets covering the most recent span raw samples,
+     *          oldest first, at the resolution chosen by select_level(). If
+     *          that level is part way through building a bucket, the partial
+     *          bucket (consolidating the buckets of the finer level it has
+     *          received so far) is visited last and counts toward the span.
+     *          Fewer buckets are visited if the level does not yet hold enough
+     *          history.
+     * \param   span    The number of raw samples to cover.
+     * \param   f       Callable invoked as <tt>f(const T& bucket)</tt>.
+     * \return  The index of the level visited.
+     */
+    template <typename F>
+    std::size_t query(std::size_t span, F f) const {
+        const std::size_t level = select_level(span);
+        const level_type& ring = levels[level];
+        std::size_t buckets = (span + resolutions[level] - 1) / resolutions[level];
+        const bool partial = buckets > 0 && level > 0 && accumulators[level - 1].count > 0;
+        if (partial) {
+            buckets--;
+        }
+        if (buckets > ring.len()) {
+            buckets = ring.len();
+        }
+        for (std::size_t i = ring.len() - buckets; i < ring.len(); i++) {
+            f(ring[i]);
+        }
+        if (partial) {
+            f(consolidated(accumulators[level - 1]));
+        }
+        return level;
+    }
+
+    /**
+     * \brief   Retrieves a single level.
+     * \param   i   The index of the level, 0 being the raw samples.
+     * \return  The level, oldest bucket first.
+     */
+    const level_type& level(std::size_t i) const noexcept {
+        return levels[i];
+    }
+
+    /**
+     * \brief   Retrieves the resolution of a level.
+     * \param   i   The index of the level.
+     * \return  The number of raw samples consolidated into each of its
+     *          buckets.
+     */
+    std::size_t resolution(std::size_t i) const noexcept {
+        return resolutions[i];
+    }
+
+    /**
+     * \brief   Retrieves the consolidation method.
+     * \return  How buckets of the coarser levels are consolidated.
+     */
+    consolidation method() const noexcept {
+        return consolidation_method;
+    }
+
+    /**
+     * \brief   Retrieves the number of samples ever added.
+     * \return  The sample count.
+     */
+    std::size_t samples() const noexcept {
+        return sample_count;
+    }
+
+private:
+    /** The bucket a level is currently building. */
+    struct accumulator {
+        T value {};
+        std::size_t count = 0;
+    };
+
+    void accumulate(accumulator& acc, const T& sample) const {
+        if (acc.count++ == 0) {
+            acc.value = sample;
+            return;
+        }
+        switch (consolidation_method) {
+        case consolidation::average:
+            acc.value = acc.value + sample;
+            break;
+        case consolidation::min:
+            if (sample < acc.value) {
+                acc.value = sample;
+            }
+            break;
+        case consolidation::max:
+            if (acc.value < sample) {
+                acc.value = sample;
+            }
+            break;
+        case consolidation::last:
+            acc.value = sample;
+            break;
+        }
+    }
+
+    T consolidated(const accumulator& acc) const {
+        if (consolidation_method == consolidation::average) {
+            // Every bucket of the finer level covers the same number of raw
+            // samples, so the average of their averages is exact.
+            return acc.value / static_cast<T>(acc.count);
+        }
+        return acc.value;
+    }
+
+    consolidation consolidation_method;
+    std::array<level_type, LEVELS> levels {};
+    std::array<accumulator, LEVELS - 1> accumulators {};
+    std::array<std::size_t, LEVELS> resolutions {};
+    std::size_t sample_count = 0;
+};
+
+template <typename T, std::size_t SIZE, std::size_t... FACTORS>
+const std::size_t round_robin_archive<T, SIZE, FACTORS...>::LEVELS;
+
+#endif // _COMMON_ROUND_ROBIN_ARCHIVE_H
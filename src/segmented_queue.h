@@ -0,0 +1,243 @@
+/**
+ * \file   segmented_queue.h
+ * \author Jonathan Simmonds
+ * \brief  Unbounded lock-free single-producer single-consumer queue of linked blocks.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_SEGMENTED_QUEUE_H
+#define _COMMON_SEGMENTED_QUEUE_H
+
+#include <atomic>       // atomic
+#include <cstdlib>      // size_t
+#include <new>          // placement new
+#include <type_traits>  // aligned_storage
+#include <utility>      // forward, move
+
+
+/**
+ * \brief   Unbounded queue passing items from a single producer thread to a
+ *          single consumer thread without locks.
+ *
+ * Items are stored in a linked list of fixed-size blocks, each used like a
+ * circular_buffer which is filled once and then drained, so in the steady state
+ * pushing and popping touch contiguous memory much as a bounded ring does.
+ * When the producer fills its block it links on a new one rather than
+ * overwriting or waiting, so the queue never blocks. When the consumer
+ * drains a block it retires it to a free list from which the producer takes
+ * blocks before allocating, so after warming up the queue does not allocate.
+ * Retired blocks are only freed when the queue is destroyed.
+ *
+ * The free list is a Treiber stack. With a single thread pushing (the
+ * consumer) and a single thread popping (the producer) it is not subject to
+ * the ABA problem.
+ *
+ * \param T             The type stored in the queue. Must be movable.
+ * \param BLOCK_SIZE    The number of items in each block.
+ */
+template <typename T, std::size_t BLOCK_SIZE = 512>
+class segmented_queue {
+    static_assert(BLOCK_SIZE > 0, "BLOCK_SIZE must be > 0");
+
+public:
+    /** The type this queue stores. */
+    using value_type = T;
+
+    /**
+     * \brief   Constructor, initialising an empty queue with a single block.
+     */
+    segmented_queue()
+            : tail_block(new block())
+            , head_block(tail_block) {}
+
+    segmented_queue(const segmented_queue&) = delete;
+    segmented_queue& operator=(const segmented_queue&) = delete;
+
+    /**
+     * \brief   Destructor, destroying any remaining items and freeing every
+     *          block. No other thread may be using the queue.
+     */
+    ~segmented_queue() {
+        block* b = head_block;
+        std::size_t index = head_index;
+        while (b != nullptr) {
+            const std::size_t committed = b->committed.load(std::memory_order_relaxed);
+            for (; index < committed; index++) {
+                reinterpret_cast<T*>(&b->slots[index])->~T();
+            }
+            block* next = b->next.load(std::memory_order_relaxed);
+            delete b;
+            b = next;
+            index = 0;
+        }
+        b = free_blocks.load(std::memory_order_relaxed);
+        while (b != nullptr) {
+            block* next = b->next.load(std::memory_order_relaxed);
+            delete b;
+            b = next;
+        }
+    }
+
+    /**
+     * \brief   Copies an item onto the back of the queue. Must only be called
+     *          by the producer thread.
+     * \param   item    The item to copy.
+     */
+    void push(const T& item) {
+        emplace(item);
+    }
+
+    /**
+     * \brief   Moves an item onto the back of the queue. Must only be called
+     *          by the producer thread.
+     * \param   item    The item to move.
+     */
+    void push(T&& item) {
+        emplace(std::move(item));
+    }
+
+    /**
+     * \brief   Constructs an item in place on the back of the queue. Must only
+     *          be called by the producer thread.
+     * \param   args    The arguments to construct the item with.
+     */
+    template <typename... ARGS>
+    void emplace(ARGS&&... args) {
+        if (tail_index == BLOCK_SIZE) {
+            block* b = take_block();
+            // Only link the new block once the full one is published, so the
+            // consumer never moves on from a block it has not drained.
+            tail_block->next.store(b, std::memory_order_release);
+            tail_block = b;
+            tail_index = 0;
+        }
+        new (&tail_block->slots[tail_index]) T(std::forward<ARGS>(args)...);
+        tail_index++;
+        tail_block->committed.store(tail_index, std::memory_order_release);
+    }
+
+    /**
+     * \brief   Moves the item at the front of the queue out, if there is one.
+     *          Must only be called by the consumer thread.
+     * \param   item    Assigned the item.
+     * \return  true if an item was popped, false if the queue was empty.
+     */
+    bool try_pop(T& item) {
+        if (head_index == BLOCK_SIZE) {
+            block* next = head_block->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+            retire_block(head_block);
+            head_block = next;
+            head_index = 0;
+        }
+        if (head_index == head_block->committed.load(std::memory_order_acquire)) {
+            return false;
+        }
+        T* slot = reinterpret_cast<T*>(&head_block->slots[head_index]);
+        item = std::move(*slot);
+        slot->~T();
+        head_index++;
+        return true;
+    }
+
+    /**
+     * \brief   Returns whether or not the queue is empty. Must only be called
+     *          by the consumer thread (for which a false result remains true
+     *          until it pops).
+     * \return  The state of the queue.
+     */
+    bool empty() const noexcept {
+        if (head_index < BLOCK_SIZE) {
+            return head_index == head_block->committed.load(std::memory_order_acquire);
+        }
+        const block* next = head_block->next.load(std::memory_order_acquire);
+        return next == nullptr || next->committed.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    /** A block of items, filled once by the producer and drained once by the
+     *  consumer. */
+    struct block {
+        /** The number of items the producer has published in the block. */
+        std::atomic<std::size_t> committed { 0 };
+        /** The next block, in the queue or in the free list. */
+        std::atomic<block*> next { nullptr };
+        /** Storage for the items. */
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[BLOCK_SIZE];
+    };
+
+    /**
+     * \brief   Takes a block from the free list, or allocates one if the list
+     *          is empty. Called by the producer.
+     * \return  An empty block.
+     */
+    block* take_block() {
+        block* b = free_blocks.load(std::memory_order_acquire);
+        while (b != nullptr &&
+               !free_blocks.compare_exchange_weak(b, b->next.load(std::memory_order_relaxed),
+                                                  std::memory_order_acquire)) {}
+        if (b == nullptr) {
+            return new block();
+        }
+        b->committed.store(0, std::memory_order_relaxed);
+        b->next.store(nullptr, std::memory_order_relaxed);
+        return b;
+    }
+
+    /**
+     * \brief   Returns a drained block to the free list. Called by the
+     *          consumer.
+     * \param   b   The block.
+     */
+    void retire_block(block* b) noexcept {
+        block* head = free_blocks.load(std::memory_order_relaxed);
+        do {
+            b->next.store(head, std::memory_order_relaxed);
+        } while (!free_blocks.compare_exchange_weak(head, b, std::memory_order_release,
+                                                    std::memory_order_relaxed));
+    }
+
+    /** Producer state, padded onto its own cache line. (Padding is used in
+     *  preference to alignas as over-aligned types are not supported by
+     *  operator new before C++17.) */
+    char producer_pad[64];
+    /** The block the producer is filling. */
+    block* tail_block;
+    /** The index of the next slot the producer fills in tail_block. */
+    std::size_t tail_index = 0;
+    /** Consumer state, padded onto its own cache line. */
+    char consumer_pad[64];
+    /** The block the consumer is draining. */
+    block* head_block;
+    /** The index of the next slot the consumer drains in head_block. */
+    std::size_t head_index = 0;
+    /** Free list state, padded onto its own cache line. */
+    char free_pad[64];
+    /** The top of the free list of drained blocks. */
+    std::atomic<block*> free_blocks { nullptr };
+    char end_pad[64];
+};
+
+#endif // _COMMON_SEGMENTED_QUEUE_H
@@ -0,0 +1,333 @@
+/**
+ * \file   spsc_queue.h
+ * \author Jonathan Simmonds
+ * \brief  Bounded lock-free single-producer single-consumer queue.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_SPSC_QUEUE_H
+#define _COMMON_SPSC_QUEUE_H
+
+#include <array>    // array
+#include <atomic>   // atomic
+#include <cstdlib>  // size_t
+#include <utility>  // move
+
+#include "wait_strategy.h"
+
+
+/**
+ * \brief   Bounded queue passing items from a single producer thread to a
+ *          single consumer thread without locks.
+ *
+ * The items are stored in a ring of SIZE slots, one of which is always left
+ * empty so that a full queue can be told from an empty one. The producer owns
+ * the tail index (the slot it fills next) and the consumer the head index (the
+ * slot it drains next), the reverse of circular_buffer's naming. Each index is
+ * published with release ordering; each side also caches the other's index
+ * and only reloads it when the queue appears full (or empty), so in the
+ * steady state the two threads rarely touch each other's cache lines. Batch
+ * operations move many items for the cost of a single index update.
+ *
+ * The blocking operations wait using the WAIT strategy (see wait_strategy.h).
+ * Every push and pop notifies it, which costs nothing for the spinning
+ * strategies.
+ *
+ * \param T     The type stored in the queue. Must be default constructible and
+ *              movable.
+ * \param SIZE  The number of slots. The capacity is <tt>SIZE - 1</tt>.
+ * \param WAIT  The wait strategy used by the blocking operations.
+ */
+template <typename T, std::size_t SIZE, typename WAIT = spin_then_yield<>>
+class spsc_queue {
+    static_assert(SIZE > 1, "SIZE must be > 1");
+
+public:
+    /** The type this queue stores. */
+    using value_type = T;
+
+    /**
+     * \brief   Constructor, initialising an empty queue.
+     */
+    spsc_queue() = default;
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    /**
+     * \brief   Copies an item onto the back of the queue if there is space.
+     *          Must only be called by the producer thread.
+     * \param   item    The item to copy.
+     * \return  true if the item was pushed, false if the queue was full.
+     */
+    bool try_push(const T& item) {
+        T copy(item);
+        return try_push(std::move(copy));
+    }
+
+    /**
+     * \brief   Moves an item onto the back of the queue if there is space.
+     *          Must only be called by the producer thread.
+     * \param   item    The item to move. Left unchanged if the queue was full.
+     * \return  true if the item was pushed, false if the queue was full.
+     */
+    bool try_push(T&& item) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        const std::size_t next = capped_mod(t + 1);
+        if (next == head_cache) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (next == head_cache) {
+                return false;
+            }
+        }
+        slots[t] = std::move(item);
+        tail.store(next, std::memory_order_release);
+        not_empty.notify();
+        return true;
+    }
+
+    /**
+     * \brief   Moves as many items as there is space for onto the back of the
+     *          queue, in order. Must only be called by the producer thread.
+     * \param   items   The items to move.
+     * \param   count   The number of items.
+     * \return  The number of items pushed (the first that many of items).
+     */
+    std::size_t push_batch(T* items, std::size_t count) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t space = free_slots(t, head_cache);
+        if (space < count) {
+            head_cache = head.load(std::memory_order_acquire);
+            space = free_slots(t, head_cache);
+        }
+        const std::size_t n = count < space ? count : space;
+        std::size_t pos = t;
+        for (std::size_t i = 0; i < n; i++) {
+            slots[pos] = std::move(items[i]);
+            pos = capped_mod(pos + 1);
+        }
+        if (n > 0) {
+            tail.store(pos, std::memory_order_release);
+            not_empty.notify();
+        }
+        return n;
+    }
+
+    /**
+     * \brief   Moves the item at the front of the queue out, if there is one.
+     *          Must only be called by the consumer thread.
+     * \param   item    Assigned the item.
+     * \return  true if an item was popped, false if the queue was empty.
+     */
+    bool try_pop(T& item) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache) {
+                return false;
+            }
+        }
+        item = std::move(slots[h]);
+        head.store(capped_mod(h + 1), std::memory_order_release);
+        not_full.notify();
+        return true;
+    }
+
+    /**
+     * \brief   Moves up to max items out from the front of the queue, in
+     *          order. Must only be called by the consumer thread.
+     * \param   out     Assigned the items.
+     * \param   max     The maximum number of items to pop.
+     * \return  The number of items popped.
+     */
+    std::size_t pop_batch(T* out, std::size_t max) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        std::size_t available = used_slots(h, tail_cache);
+        if (available < max) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            available = used_slots(h, tail_cache);
+        }
+        const std::size_t n = max < available ? max : available;
+        std::size_t pos = h;
+        for (std::size_t i = 0; i < n; i++) {
+            out[i] = std::move(slots[pos]);
+            pos = capped_mod(pos + 1);
+        }
+        if (n > 0) {
+            head.store(pos, std::memory_order_release);
+            not_full.notify();
+        }
+        return n;
+    }
+
+    /**
+     * \brief   Moves an item onto the back of the queue, waiting while it is
+     *          full. Must only be called by the producer thread.
+     * \param   item    The item to move.
+     */
+    void push(T&& item) {
+        while (!try_push(std::move(item))) {
+            wait_not_full(never);
+        }
+    }
+
+    /**
+     * \brief   Copies an item onto the back of the queue, waiting while it is
+     *          full. Must only be called by the producer thread.
+     * \param   item    The item to copy.
+     */
+    void push(const T& item) {
+        T copy(item);
+        push(std::move(copy));
+    }
+
+    /**
+     * \brief   Moves the item at the front of the queue out, waiting while it
+     *          is empty. Must only be called by the consumer thread.
+     * \return  The item.
+     */
+    T pop() {
+        T item;
+        while (!try_pop(item)) {
+            wait_not_empty(never);
+        }
+        return item;
+    }
+
+    /**
+     * \brief   Waits until the queue has space or the cancel condition is
+     *          true. Must only be called by the producer thread.
+     * \param   cancel  Callable returning whether to stop waiting. If it
+     *                  depends on state changed by another thread, that thread
+     *                  must call wake() after changing it.
+     * \return  true if the queue has space, false if cancelled.
+     */
+    template <typename F>
+    bool wait_not_full(F cancel) {
+        const std::size_t next = capped_mod(tail.load(std::memory_order_relaxed) + 1);
+        bool has_space = false;
+        not_full.wait_until([&]() {
+            has_space = next != head.load(std::memory_order_acquire);
+            return has_space || cancel();
+        });
+        return has_space;
+    }
+
+    /**
+     * \brief   Waits until the queue has an item or the cancel condition is
+     *          true. Must only be called by the consumer thread.
+     * \param   cancel  Callable returning whether to stop waiting. If it
+     *                  depends on state changed by another thread, that thread
+     *                  must call wake() after changing it.
+     * \return  true if the queue has an item, false if cancelled.
+     */
+    template <typename F>
+    bool wait_not_empty(F cancel) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        bool has_item = false;
+        not_empty.wait_until([&]() {
+            has_item = h != tail.load(std::memory_order_acquire);
+            return has_item || cancel();
+        });
+        return has_item;
+    }
+
+    /**
+     * \brief   Wakes both threads if they are waiting, so they re-check their
+     *          cancel conditions. May be called from any thread.
+     */
+    void wake() noexcept {
+        not_empty.notify();
+        not_full.notify();
+    }
+
+    /**
+     * \brief   Retrieves the number of items in the queue. Only a snapshot
+     *          when called while the other thread is using the queue.
+     * \return  The number of items.
+     */
+    std::size_t size() const noexcept {
+        return used_slots(head.load(std::memory_order_acquire),
+                          tail.load(std::memory_order_acquire));
+    }
+
+    /**
+     * \brief   Returns whether or not the queue is empty. Only a snapshot when
+     *          called while the other thread is using the queue.
+     * \return  The state of the queue.
+     */
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    /**
+     * \brief   Retrieves the maximum number of items the queue can hold.
+     * \return  The capacity, <tt>SIZE - 1</tt>.
+     */
+    constexpr std::size_t capacity() const noexcept {
+        return SIZE - 1;
+    }
+
+private:
+    static constexpr bool never() noexcept {
+        return false;
+    }
+
+    static constexpr std::size_t capped_mod(std::size_t x) noexcept {
+        return x < SIZE ? x : x - SIZE;
+    }
+
+    static constexpr std::size_t used_slots(std::size_t h, std::size_t t) noexcept {
+        return capped_mod(t + SIZE - h);
+    }
+
+    static constexpr std::size_t free_slots(std::size_t t, std::size_t h) noexcept {
+        return SIZE - 1 - used_slots(h, t);
+    }
+
+    /** The items. */
+    std::array<T, SIZE> slots {};
+    /** Producer state, padded onto its own cache line. (Padding is used in
+     *  preference to alignas as over-aligned types are not supported by
+     *  operator new before C++17.) */
+    char producer_pad[64];
+    /** The slot the producer fills next. */
+    std::atomic<std::size_t> tail { 0 };
+    /** The producer's last view of head. */
+    std::size_t head_cache = 0;
+    /** Consumer state, padded onto its own cache line. */
+    char consumer_pad[64];
+    /** The slot the consumer drains next. */
+    std::atomic<std::size_t> head { 0 };
+    /** The consumer's last view of tail. */
+    std::size_t tail_cache = 0;
+    /** Waited on by the consumer, each on its own cache line. */
+    char not_empty_pad[64];
+    WAIT not_empty;
+    /** Waited on by the producer. */
+    char not_full_pad[64];
+    WAIT not_full;
+    char end_pad[64];
+};
+
+#endif // _COMMON_SPSC_QUEUE_H
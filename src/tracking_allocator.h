@@ -0,0 +1,200 @@
+/**
+ * \file   tracking_allocator.h
+ * \author Jonathan Simmonds
+ * \brief  Allocator which records live heap usage per container type.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_TRACKING_ALLOCATOR_H
+#define _COMMON_TRACKING_ALLOCATOR_H
+
+#include <atomic>   // atomic
+#include <cstdlib>  // size_t
+#include <memory>   // allocator
+#include <mutex>    // mutex, lock_guard
+#include <vector>   // vector
+
+
+/**
+ * \brief   The default tag for a tracking_allocator. A tag is any type with a
+ *          static <tt>name()</tt> method returning the (static) string under
+ *          which its allocations are reported, e.g.:
+ *          <tt>struct order_ids { static const char* name() { return "order ids"; } };</tt>
+ */
+struct tracking_default_tag {
+    static const char* name() noexcept { return "default"; }
+};
+
+/**
+ * \brief   Snapshot of the allocations made through tracking_allocators with
+ *          a single tag.
+ */
+struct tracking_snapshot {
+    /** The name of the tag. */
+    const char* name;
+    /** The number of bytes currently allocated. */
+    std::size_t live_bytes;
+    /** The number of allocations currently live. */
+    std::size_t live_allocations;
+    /** The total number of allocations ever made. */
+    std::size_t total_allocations;
+    /** The total number of bytes ever allocated. */
+    std::size_t total_bytes;
+};
+
+/**
+ * \brief   Global, thread-safe registry of the allocation counters for every
+ *          tag which has been used with a tracking_allocator.
+ */
+class tracking_registry {
+public:
+    /** The counters for a single tag. Updated with relaxed atomics so the
+     *  totals are exact but a snapshot taken while other threads allocate is
+     *  not a single consistent instant. */
+    struct counters {
+        explicit counters(const char* name) noexcept : name(name) {}
+        const char* name;
+        std::atomic<std::size_t> live_bytes { 0 };
+        std::atomic<std::size_t> live_allocations { 0 };
+        std::atomic<std::size_t> total_allocations { 0 };
+        std::atomic<std::size_t> total_bytes { 0 };
+    };
+
+    /**
+     * \brief   Retrieves the counters for the given tag, registering them on
+     *          first use.
+     * \return  The counters for Tag.
+     */
+    template <typename Tag>
+    static counters& get() {
+        static counters& tag_counters = instance().add(Tag::name());
+        return tag_counters;
+    }
+
+    /**
+     * \brief   Takes a snapshot of the counters of every registered tag.
+     * \return  One entry per tag, in order of first use.
+     */
+    static std::vector<tracking_snapshot> snapshot() {
+        tracking_registry& registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        std::vector<tracking_snapshot> result;
+        result.reserve(registry.tags.size());
+        for (const std::unique_ptr<counters>& c : registry.tags) {
+            tracking_snapshot entry;
+            entry.name = c->name;
+            entry.live_bytes = c->live_bytes.load(std::memory_order_relaxed);
+            entry.live_allocations = c->live_allocations.load(std::memory_order_relaxed);
+            entry.total_allocations = c->total_allocations.load(std::memory_order_relaxed);
+            entry.total_bytes = c->total_bytes.load(std::memory_order_relaxed);
+            result.push_back(entry);
+        }
+        return result;
+    }
+
+private:
+    tracking_registry() = default;
+
+    static tracking_registry& instance() {
+        static tracking_registry registry;
+        return registry;
+    }
+
+    counters& add(const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tags.emplace_back(new counters(name));
+        return *tags.back();
+    }
+
+    /** Protects tags. */
+    std::mutex mutex;
+    /** The registered counters. Never removed so references remain valid. */
+    std::vector<std::unique_ptr<counters>> tags;
+};
+
+
+/**
+ * \brief   Standard-conforming allocator which allocates through
+ *          <tt>std::allocator</tt> and records every allocation against its
+ *          tag in the tracking_registry. Use one tag per container type to
+ *          attribute heap usage, e.g.
+ *          <tt>SimpleSet<int, tracking_allocator<int, order_ids>></tt>.
+ *
+ * \param T     The type allocated.
+ * \param Tag   The tag to record allocations against.
+ */
+template <typename T, typename Tag = tracking_default_tag>
+class tracking_allocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = tracking_allocator<U, Tag>;
+    };
+
+    tracking_allocator() noexcept = default;
+
+    template <typename U>
+    tracking_allocator(const tracking_allocator<U, Tag>&) noexcept {}
+
+    /**
+     * \brief   Allocates storage for n objects of type T.
+     * \param   n   The number of objects.
+     * \return  Pointer to the (uninitialised) storage.
+     */
+    T* allocate(std::size_t n) {
+        T* p = std::allocator<T>().allocate(n);
+        const std::size_t bytes = n * sizeof(T);
+        tracking_registry::counters& c = tracking_registry::get<Tag>();
+        c.live_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        c.live_allocations.fetch_add(1, std::memory_order_relaxed);
+        c.total_allocations.fetch_add(1, std::memory_order_relaxed);
+        c.total_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        return p;
+    }
+
+    /**
+     * \brief   Frees storage previously returned by allocate().
+     * \param   p   Pointer to the storage.
+     * \param   n   The number of objects the storage was allocated for.
+     */
+    void deallocate(T* p, std::size_t n) noexcept {
+        tracking_registry::counters& c = tracking_registry::get<Tag>();
+        c.live_bytes.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+        c.live_allocations.fetch_sub(1, std::memory_order_relaxed);
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template <typename T, typename U, typename Tag>
+bool operator==(const tracking_allocator<T, Tag>&, const tracking_allocator<U, Tag>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U, typename Tag>
+bool operator!=(const tracking_allocator<T, Tag>&, const tracking_allocator<U, Tag>&) noexcept {
+    return false;
+}
+
+#endif // _COMMON_TRACKING_ALLOCATOR_H
@@ -0,0 +1,190 @@
+/**
+ * \file   triple_buffer.h
+ * \author Jonathan Simmonds
+ * \brief  Wait-free single-slot channel handing the latest value between threads.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_TRIPLE_BUFFER_H
+#define _COMMON_TRIPLE_BUFFER_H
+
+#include <atomic>   // atomic
+#include <cstdint>  // uint8_t
+#include <utility>  // move
+
+
+/**
+ * \brief   Triple buffer passing the most recent value from a single writer
+ *          thread to a single reader thread.
+ *
+ * Unlike a queue, values are not delivered in turn: the reader only ever sees
+ * the latest value published, and intermediate values it did not pick up in
+ * time are simply overwritten. This suits state snapshots where only the
+ * newest matters.
+ *
+ * The writer and reader each own one of three slots and fill or read it in
+ * place, so no value is ever copied between slots. The third slot holds the
+ * latest published value and is exchanged atomically with the writer's slot
+ * on publish() and with the reader's slot on update(). Its index is packed
+ * with a dirty bit recording whether it has been published since the reader
+ * last took it. Every operation is a single atomic exchange (or load), so
+ * both sides are wait-free.
+ *
+ * \param T     The type stored in the buffer. Must be default constructible.
+ */
+template <typename T>
+class triple_buffer {
+public:
+    /**
+     * \brief   Constructor. All three slots are default constructed.
+     */
+    triple_buffer() = default;
+
+    /**
+     * \brief   Constructor, initialising all three slots to the given value so
+     *          the reader sees it before the first publish().
+     * \param   initial The initial value.
+     */
+    explicit triple_buffer(const T& initial) {
+        for (slot& s : slots) {
+            s.value = initial;
+        }
+    }
+
+    triple_buffer(const triple_buffer&) = delete;
+    triple_buffer& operator=(const triple_buffer&) = delete;
+
+    /**
+     * \brief   Retrieves the writer's slot, to be filled in place before
+     *          calling publish(). It may hold a stale value from an earlier
+     *          publish. Must only be called by the writer thread.
+     * \return  Reference to the writer's slot.
+     */
+    T& write_buffer() noexcept {
+        return slots[back].value;
+    }
+
+    /**
+     * \brief   Publishes the writer's slot as the latest value and takes a new
+     *          slot to write into. Must only be called by the writer thread.
+     */
+    void publish() noexcept {
+        // Release so the contents of the slot are visible to the reader once
+        // it sees the new index; acquire so that the slot handed back by the
+        // reader is no longer being read.
+        back = middle.exchange(static_cast<std::uint8_t>(back | DIRTY),
+                               std::memory_order_acq_rel) & INDEX;
+    }
+
+    /**
+     * \brief   Copies a value into the writer's slot and publishes it. Must
+     *          only be called by the writer thread.
+     * \param   value   The value to publish.
+     */
+    void write(const T& value) {
+        write_buffer() = value;
+        publish();
+    }
+
+    /**
+     * \brief   Moves a value into the writer's slot and publishes it. Must
+     *          only be called by the writer thread.
+     * \param   value   The value to publish.
+     */
+    void write(T&& value) {
+        write_buffer() = std::move(value);
+        publish();
+    }
+
+    /**
+     * \brief   Takes the latest published value, if there is one the reader
+     *          has not already taken, making it available through
+     *          read_buffer(). Must only be called by the reader thread.
+     * \return  true if a new value was taken, false if the reader already has
+     *          the latest.
+     */
+    bool update() noexcept {
+        if (!(middle.load(std::memory_order_relaxed) & DIRTY)) {
+            return false;
+        }
+        // Only the writer can set the dirty bit and only the reader clears it,
+        // so it is still set here.
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    /**
+     * \brief   Retrieves the reader's slot, which holds the value taken by the
+     *          last update() and is not modified until the next. Must only be
+     *          called by the reader thread.
+     * \return  Reference to the reader's slot.
+     */
+    const T& read_buffer() const noexcept {
+        return slots[front].value;
+    }
+
+    /**
+     * \brief   Takes the latest published value, if any, and returns it. Must
+     *          only be called by the reader thread.
+     * \return  Reference to the reader's slot.
+     */
+    const T& read() noexcept {
+        update();
+        return read_buffer();
+    }
+
+    /**
+     * \brief   Returns whether or not a value has been published which the
+     *          reader has not yet taken. May be called from either thread.
+     * \return  true if there is a new value, false otherwise.
+     */
+    bool has_update() const noexcept {
+        return (middle.load(std::memory_order_relaxed) & DIRTY) != 0;
+    }
+
+private:
+    /** The dirty bit in middle. */
+    static const std::uint8_t DIRTY = 4;
+    /** The index bits in middle. */
+    static const std::uint8_t INDEX = 3;
+
+    /** A slot, padded so the reader and writer do not contend for a cache
+     *  line. (Padding is used in preference to alignas as over-aligned types
+     *  are not supported by operator new before C++17.) */
+    struct slot {
+        T value {};
+        char pad[64];
+    };
+
+    slot slots[3];
+    /** The writer's slot. Only accessed by the writer. */
+    std::uint8_t back = 0;
+    char writer_pad[64];
+    /** The latest slot and the dirty bit. */
+    std::atomic<std::uint8_t> middle { 1 };
+    char middle_pad[64];
+    /** The reader's slot. Only accessed by the reader. */
+    std::uint8_t front = 2;
+};
+
+#endif // _COMMON_TRIPLE_BUFFER_H
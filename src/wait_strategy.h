@@ -0,0 +1,223 @@
+/**
+ * \file   wait_strategy.h
+ * \author Jonathan Simmonds
+ * \brief  Policies for how a thread waits on a concurrent queue.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_WAIT_STRATEGY_H
+#define _COMMON_WAIT_STRATEGY_H
+
+#include <atomic>       // atomic, atomic_thread_fence
+#include <cstdint>      // uint32_t
+#include <cstdlib>      // size_t
+#include <thread>       // this_thread
+
+#if defined(__linux__)
+#include <climits>      // INT_MAX
+#include <linux/futex.h> // FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+#include <sys/syscall.h> // SYS_futex
+#include <unistd.h>     // syscall
+#else
+#include <condition_variable> // condition_variable
+#include <mutex>        // mutex, unique_lock
+#endif
+
+/*
+ * A wait strategy is a class used as a compile-time policy by the blocking
+ * operations of the concurrent queues (such as spsc_queue). One instance is
+ * shared by the threads waiting for a condition and the threads which may
+ * make it true, and provides:
+ *  - <tt>template <typename P> void wait_until(P ready)</tt>: returns once
+ *    <tt>ready()</tt> returns true.
+ *  - <tt>void notify()</tt>: called after every change which may make a
+ *    waiter's condition true.
+ */
+
+namespace wait_strategy_detail {
+
+/**
+ * \brief   Hints to the CPU that the calling thread is spinning, reducing its
+ *          power use and the cost of leaving the loop (and, with
+ *          hyper-threading, giving the sibling thread more of the core).
+ */
+inline void cpu_relax() noexcept {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * \brief   Spins with exponential backoff: each check of the condition is
+ *          followed by twice as many pauses as the last, up to a limit.
+ *
+ * \param SPINS     The total number of pauses to spin for.
+ * \param MAX_PAUSE The maximum number of pauses between checks.
+ * \param ready     The condition.
+ * \return  true if the condition became true, false if the spin count ran
+ *          out first.
+ */
+template <std::size_t SPINS, std::size_t MAX_PAUSE, typename P>
+bool spin(P& ready) {
+    std::size_t pauses = 1;
+    for (std::size_t spent = 0; spent < SPINS; spent += pauses) {
+        if (ready()) {
+            return true;
+        }
+        for (std::size_t i = 0; i < pauses; i++) {
+            cpu_relax();
+        }
+        if (pauses < MAX_PAUSE) {
+            pauses *= 2;
+        }
+    }
+    return ready();
+}
+
+} // namespace wait_strategy_detail
+
+
+/**
+ * \brief   Wait strategy which busy-waits, checking the condition
+ *          continuously. Lowest latency, but occupies a core, so is only
+ *          suitable for threads pinned to isolated cores.
+ */
+class busy_spin {
+public:
+    template <typename P>
+    void wait_until(P ready) noexcept(noexcept(ready())) {
+        while (!ready()) {
+            wait_strategy_detail::cpu_relax();
+        }
+    }
+
+    void notify() noexcept {}
+};
+
+/**
+ * \brief   Wait strategy which spins with exponential backoff for a while,
+ *          then yields the core to other threads between checks. Suitable
+ *          for shared hosts, where a spinning thread may be stopping the
+ *          thread it waits for from running.
+ *
+ * \param SPINS     The total number of pauses to spin for before yielding.
+ * \param MAX_PAUSE The maximum number of pauses between checks while
+ *                  spinning.
+ */
+template <std::size_t SPINS = 1024, std::size_t MAX_PAUSE = 64>
+class spin_then_yield {
+public:
+    template <typename P>
+    void wait_until(P ready) {
+        if (wait_strategy_detail::spin<SPINS, MAX_PAUSE>(ready)) {
+            return;
+        }
+        while (!ready()) {
+            std::this_thread::yield();
+        }
+    }
+
+    void notify() noexcept {}
+};
+
+/**
+ * \brief   Wait strategy which spins with exponential backoff for a while,
+ *          then sleeps until notified. Uses the least CPU, at the cost of a
+ *          wake-up latency of several microseconds, so suits laptops and
+ *          mostly-idle queues.
+ *
+ * notify() only makes a system call when a thread is asleep, so it costs a
+ * fence and a load when nobody is waiting. Uses a futex on Linux, or a mutex
+ * and condition variable elsewhere.
+ *
+ * \param SPINS     The total number of pauses to spin for before sleeping.
+ * \param MAX_PAUSE The maximum number of pauses between checks while
+ *                  spinning.
+ */
+template <std::size_t SPINS = 1024, std::size_t MAX_PAUSE = 64>
+class futex_park {
+public:
+    template <typename P>
+    void wait_until(P ready) {
+        if (wait_strategy_detail::spin<SPINS, MAX_PAUSE>(ready)) {
+            return;
+        }
+        // Announce the sleeper before the final checks of the condition,
+        // pairing with the fence in notify(): either this sees the change or
+        // notify() sees the sleeper.
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+#if defined(__linux__)
+        for (;;) {
+            // Read the epoch before checking, so a notify() in between makes
+            // the futex wait return immediately.
+            const std::uint32_t seen = epoch.load(std::memory_order_acquire);
+            if (ready()) {
+                break;
+            }
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch), FUTEX_WAIT_PRIVATE, seen,
+                    nullptr, nullptr, 0);
+        }
+#else
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!ready()) {
+                condition.wait(lock);
+            }
+        }
+#endif
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void notify() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+#if defined(__linux__)
+        epoch.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch), FUTEX_WAKE_PRIVATE, INT_MAX,
+                nullptr, nullptr, 0);
+#else
+        // Taking the lock ensures a sleeper is either yet to check its
+        // condition or already waiting.
+        { std::lock_guard<std::mutex> lock(mutex); }
+        condition.notify_all();
+#endif
+    }
+
+private:
+    /** The number of threads asleep (or about to sleep). */
+    std::atomic<std::uint32_t> sleepers { 0 };
+#if defined(__linux__)
+    /** The futex word, incremented by every notify() which wakes sleepers. */
+    std::atomic<std::uint32_t> epoch { 0 };
+#else
+    std::mutex mutex;
+    std::condition_variable condition;
+#endif
+};
+
+#endif // _COMMON_WAIT_STRATEGY_H
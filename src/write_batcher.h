@@ -0,0 +1,250 @@
+/**
+ * \file   write_batcher.h
+ * \author Jonathan Simmonds
+ * \brief  Coalesces small writes to a file descriptor into batched writev calls.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2017-2021 Jonathan Simmonds
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _COMMON_WRITE_BATCHER_H
+#define _COMMON_WRITE_BATCHER_H
+
+#include <cerrno>       // errno, EAGAIN, EINTR
+#include <chrono>       // steady_clock, microseconds
+#include <cstdint>      // uint64_t
+#include <cstdlib>      // size_t
+#include <utility>      // pair
+
+#include <sys/types.h>  // ssize_t
+#include <sys/uio.h>    // writev, iovec
+#include <unistd.h>     // write
+
+#include "circular_buffer.h"
+
+
+/**
+ * \brief   Thresholds at which a write_batcher flushes.
+ */
+struct write_batcher_options {
+    /** Flush once this many bytes are buffered. */
+    std::size_t max_bytes = 16384;
+    /** Flush once this many messages have been buffered since the buffer was
+     *  last empty. */
+    std::size_t max_messages = 64;
+    /** Flush once the oldest buffered message has waited this long. */
+    std::chrono::microseconds max_delay { 200 };
+};
+
+/**
+ * \brief   Counters describing a write_batcher's batching.
+ */
+struct write_batcher_stats {
+    /** The number of messages written. */
+    std::uint64_t messages;
+    /** The number of bytes written. */
+    std::uint64_t bytes;
+    /** The number of write system calls made. */
+    std::uint64_t syscalls;
+};
+
+/**
+ * \brief   Write-combining buffer for a file descriptor (typically a stream
+ *          socket) which accumulates small messages in a byte ring and sends
+ *          them with a single <tt>writev()</tt> of the ring's (at most two)
+ *          contiguous runs.
+ *
+ * A flush happens when the buffered bytes, the number of buffered messages or
+ * the age of the oldest message reaches its threshold. Every check is made by
+ * the thread calling write(), so there is no background thread; when no more
+ * messages arrive, the owner must call poll() by deadline() (e.g. by using it
+ * as its epoll timeout) to bound the latency of the last batch.
+ *
+ * Non-blocking descriptors are supported: a partial or would-block write
+ * leaves the unsent bytes buffered for the next flush. Not thread-safe.
+ *
+ * \param SIZE  The capacity of the ring in bytes. Messages larger than this
+ *              are written directly, which may leave a partial message sent
+ *              if a non-blocking descriptor fills up.
+ */
+template <std::size_t SIZE = 65536>
+class write_batcher {
+public:
+    /** The clock used for the deadline. */
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * \brief   Constructor.
+     * \param   fd      The file descriptor to write to. Not closed by the
+     *                  batcher.
+     * \param   options The flush thresholds.
+     */
+    explicit write_batcher(int fd, const write_batcher_options& options = write_batcher_options())
+            : fd(fd), options(options) {}
+
+    write_batcher(const write_batcher&) = delete;
+    write_batcher& operator=(const write_batcher&) = delete;
+
+    /**
+     * \brief   Buffers a message, flushing first if it does not fit and
+     *          afterwards if a threshold has been reached.
+     * \param   data    The message.
+     * \param   length  The length of the message in bytes.
+     * \return  true if the message was buffered (or written), false if it
+     *          could not be because the descriptor would block or failed,
+     *          with errno set.
+     */
+    bool write(const void* data, std::size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        if (length > ring.capacity() - ring.len()) {
+            if (!flush()) {
+                return false;
+            }
+            if (length > ring.capacity()) {
+                // Too large to buffer, and nothing is buffered ahead of it.
+                return write_direct(bytes, length);
+            }
+        }
+        const clock::time_point now = clock::now();
+        if (ring.empty()) {
+            first_time = now;
+        }
+        ring.push_back(bytes, length);
+        messages++;
+        if (ring.len() >= options.max_bytes || messages >= options.max_messages ||
+                now - first_time >= options.max_delay) {
+            return flush() || errno == EAGAIN;
+        }
+        return true;
+    }
+
+    /**
+     * \brief   Flushes if the oldest buffered message has reached its
+     *          deadline. Call by deadline() when no more messages are being
+     *          written.
+     * \param   now The current time.
+     * \return  false if a flush failed, with errno set, otherwise true.
+     */
+    bool poll(clock::time_point now = clock::now()) {
+        if (ring.empty() || now < deadline()) {
+            return true;
+        }
+        return flush() || errno == EAGAIN;
+    }
+
+    /**
+     * \brief   Retrieves the time by which poll() must be called, if no more
+     *          messages are written, to flush the buffered messages on time.
+     * \return  The deadline, or <tt>clock::time_point::max()</tt> if nothing
+     *          is buffered.
+     */
+    clock::time_point deadline() const noexcept {
+        return ring.empty() ? clock::time_point::max() : first_time + options.max_delay;
+    }
+
+    /**
+     * \brief   Writes as much of the buffered data as the descriptor accepts
+     *          with a single <tt>writev()</tt>.
+     * \return  true if the buffer was emptied, false otherwise, with errno
+     *          set (to EAGAIN if the descriptor would block).
+     */
+    bool flush() {
+        errno = 0;
+        if (ring.empty()) {
+            return true;
+        }
+        const std::pair<char*, std::size_t> one = ring.array_one();
+        const std::pair<char*, std::size_t> two = ring.array_two();
+        iovec iov[2] = { { one.first, one.second }, { two.first, two.second } };
+        ssize_t n;
+        do {
+            n = writev(fd, iov, two.second > 0 ? 2 : 1);
+        } while (n < 0 && errno == EINTR);
+        written.syscalls++;
+        if (n < 0) {
+            return false;
+        }
+        ring.pop_front(static_cast<std::size_t>(n));
+        written.bytes += static_cast<std::uint64_t>(n);
+        if (!ring.empty()) {
+            errno = EAGAIN;
+            return false;
+        }
+        written.messages += messages;
+        messages = 0;
+        return true;
+    }
+
+    /**
+     * \brief   Retrieves the number of bytes buffered.
+     * \return  The number of bytes.
+     */
+    std::size_t pending_bytes() const noexcept {
+        return ring.len();
+    }
+
+    /**
+     * \brief   Retrieves the counters of the data written so far.
+     * \return  The counters. A message counts as written once the buffer it
+     *          was in has been completely written.
+     */
+    const write_batcher_stats& stats() const noexcept {
+        return written;
+    }
+
+private:
+    bool write_direct(const char* bytes, std::size_t length) {
+        while (length > 0) {
+            const ssize_t n = ::write(fd, bytes, length);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            written.syscalls++;
+            if (n < 0) {
+                if (errno == EAGAIN && length <= ring.capacity()) {
+                    // Buffer the rest for the next flush.
+                    first_time = clock::now();
+                    ring.push_back(bytes, length);
+                    messages++;
+                    return true;
+                }
+                return false;
+            }
+            bytes += n;
+            length -= static_cast<std::size_t>(n);
+            written.bytes += static_cast<std::uint64_t>(n);
+        }
+        written.messages++;
+        return true;
+    }
+
+    const int fd;
+    const write_batcher_options options;
+    /** The buffered bytes. */
+    circular_buffer<char, SIZE + 1> ring;
+    /** The number of messages buffered since the ring was last empty. */
+    std::size_t messages = 0;
+    /** When the first message was buffered since the ring was last empty. */
+    clock::time_point first_time;
+    write_batcher_stats written = {0, 0, 0};
+};
+
+#endif // _COMMON_WRITE_BATCHER_H
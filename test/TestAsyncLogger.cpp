@@ -0,0 +1,265 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "async_logger.h"
+
+/** A temporary file to log to, read back line by line. */
+class log_file {
+public:
+    log_file() : file(std::tmpfile()) {}
+    ~log_file() {
+        std::fclose(file);
+    }
+
+    int fd() const {
+        return fileno(file);
+    }
+
+    /** Every line written so far, including the timestamp prefix. */
+    std::vector<std::string> raw_lines() const {
+        std::string contents;
+        char buf[4096];
+        off_t offset = 0;
+        ssize_t n;
+        while ((n = pread(fd(), buf, sizeof(buf), offset)) > 0) {
+            contents.append(buf, static_cast<std::size_t>(n));
+            offset += n;
+        }
+        std::vector<std::string> out;
+        std::size_t start = 0;
+        std::size_t end;
+        while ((end = contents.find('\n', start)) != std::string::npos) {
+            out.push_back(contents.substr(start, end - start));
+            start = end + 1;
+        }
+        return out;
+    }
+
+    /** Every line written so far, without the timestamp prefix. */
+    std::vector<std::string> lines() const {
+        std::vector<std::string> out = raw_lines();
+        for (std::string& line : out) {
+            line = line.substr(line.find("] ") + 2);
+        }
+        return out;
+    }
+
+private:
+    std::FILE* file;
+};
+
+TEST(AsyncLoggerTest, format) {
+    log_file file;
+    {
+        async_logger logger(file.fd());
+        EXPECT_EQ(true, logger.log("no arguments"));
+        EXPECT_EQ(true, logger.log("%d %u %lld %c", -1, 2u, 3LL, 'x'));
+        EXPECT_EQ(true, logger.log("%.2f %.1f", 1.5, 2.25f));
+        EXPECT_EQ(true, logger.log("%p", static_cast<void*>(nullptr)));
+    }
+    char pointer[32];
+    std::snprintf(pointer, sizeof(pointer), "%p", static_cast<void*>(nullptr));
+    EXPECT_EQ((std::vector<std::string>{"no arguments", "-1 2 3 x", "1.50 2.2", pointer}), file.lines());
+}
+
+TEST(AsyncLoggerTest, timestamps) {
+    // Timestamps are converted from the cycle counter to wall-clock time.
+    log_file file;
+    const std::time_t before = std::time(nullptr);
+    {
+        async_logger logger(file.fd());
+        for (int i = 0; i < 100; i++) {
+            logger.log("%d", i);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    const std::time_t after = std::time(nullptr);
+    const std::vector<std::string> lines = file.raw_lines();
+    ASSERT_EQ(100, lines.size());
+    for (const std::string& line : lines) {
+        ASSERT_EQ('[', line[0]);
+        const std::size_t dot = line.find('.');
+        ASSERT_EQ("] ", line.substr(dot + 10, 2));
+        const long long seconds = std::atoll(line.c_str() + 1);
+        EXPECT_LE(before - 1, seconds);
+        EXPECT_GE(after + 1, seconds);
+    }
+}
+
+TEST(AsyncLoggerTest, strings) {
+    log_file file;
+    {
+        async_logger logger(file.fd());
+        char mutable_text[] = "mutable";
+        const std::string text = "std::string";
+        const std::string empty;
+        logger.log("%s|%s|%s|%s|", "literal", mutable_text, text, empty);
+        // Strings are copied, so may change once logged.
+        mutable_text[0] = 'M';
+        logger.log("%d %s %d", 1, std::string(100, 'x'), 2);
+    }
+    EXPECT_EQ((std::vector<std::string>{"literal|mutable|std::string||",
+                                        "1 " + std::string(100, 'x') + " 2"}), file.lines());
+}
+
+TEST(AsyncLoggerTest, oversized) {
+    // Records larger than half the ring are dropped, even when blocking.
+    log_file file;
+    {
+        async_logger logger(file.fd(), 256, overflow_policy::block);
+        EXPECT_EQ(false, logger.log("%s", std::string(200, 'x')));
+        EXPECT_EQ(1, logger.dropped());
+        EXPECT_EQ(true, logger.log("%s", std::string(50, 'y')));
+    }
+    EXPECT_EQ((std::vector<std::string>{std::string(50, 'y')}), file.lines());
+}
+
+TEST(AsyncLoggerTest, wrap) {
+    // Records of varying size repeatedly straddle the end of a small ring,
+    // so are preceded by padding markers.
+    log_file file;
+    std::vector<std::string> expected;
+    {
+        async_logger logger(file.fd(), 256, overflow_policy::block);
+        for (int i = 0; i < 2000; i++) {
+            const std::string text(static_cast<std::size_t>(i * 7 % 80), static_cast<char>('a' + i % 26));
+            ASSERT_EQ(true, logger.log("%d:%s", i, text));
+            expected.push_back(std::to_string(i) + ":" + text);
+        }
+        EXPECT_EQ(0, logger.dropped());
+    }
+    EXPECT_EQ(expected, file.lines());
+}
+
+TEST(AsyncLoggerTest, drop) {
+    // With the background thread asleep, a full ring drops records.
+    log_file file;
+    std::vector<std::string> expected;
+    std::size_t dropped = 0;
+    {
+        async_logger logger(file.fd(), 256, overflow_policy::drop, std::chrono::milliseconds(200));
+        for (int i = 0; i < 100000 && dropped < 10; i++) {
+            if (logger.log("record %d", i)) {
+                expected.push_back("record " + std::to_string(i));
+            } else {
+                dropped++;
+            }
+        }
+        EXPECT_EQ(10, dropped);
+        EXPECT_EQ(dropped, logger.dropped());
+    }
+    EXPECT_EQ(expected, file.lines());
+}
+
+TEST(AsyncLoggerTest, block) {
+    // A blocking producer waits for the background thread instead.
+    log_file file;
+    {
+        async_logger logger(file.fd(), 256, overflow_policy::block);
+        for (int i = 0; i < 1000; i++) {
+            ASSERT_EQ(true, logger.log("record %d", i));
+        }
+        EXPECT_EQ(0, logger.dropped());
+    }
+    const std::vector<std::string> lines = file.lines();
+    ASSERT_EQ(1000, lines.size());
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ("record " + std::to_string(i), lines[i]);
+    }
+}
+
+TEST(AsyncLoggerTest, flush) {
+    log_file file;
+    async_logger logger(file.fd(), 1 << 16, overflow_policy::drop, std::chrono::milliseconds(50));
+    logger.flush();
+    EXPECT_EQ(true, file.lines().empty());
+    for (int i = 0; i < 3; i++) {
+        logger.log("first %d", i);
+    }
+    logger.flush();
+    EXPECT_EQ((std::vector<std::string>{"first 0", "first 1", "first 2"}), file.lines());
+
+    // Records from every thread are flushed.
+    std::thread other([&logger]() {
+        logger.log("other");
+    });
+    other.join();
+    logger.flush();
+    EXPECT_EQ("other", file.lines().back());
+}
+
+TEST(AsyncLoggerTest, threaded) {
+    // Each thread's records are written in the order it logged them.
+    const int THREADS = 4;
+    const int COUNT = 5000;
+    log_file file;
+    {
+        async_logger logger(file.fd(), 1024, overflow_policy::block);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++) {
+            threads.emplace_back([&logger, t, COUNT]() {
+                for (int i = 0; i < COUNT; i++) {
+                    logger.log("%d %d %s", t, i, std::string(static_cast<std::size_t>(i % 30), 'z'));
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        EXPECT_EQ(0, logger.dropped());
+    }
+    std::vector<int> next(THREADS, 0);
+    const std::vector<std::string> lines = file.lines();
+    ASSERT_EQ(THREADS * COUNT, lines.size());
+    for (const std::string& line : lines) {
+        int t;
+        int i;
+        ASSERT_EQ(2, std::sscanf(line.c_str(), "%d %d", &t, &i));
+        ASSERT_LE(0, t);
+        ASSERT_GT(THREADS, t);
+        ASSERT_EQ(next[t], i);
+        next[t]++;
+    }
+}
+
+TEST(AsyncLoggerTest, several_loggers) {
+    // A thread alternating between more loggers than it caches rings for
+    // must still log each record to the right logger.
+    const int LOGGERS = 6;
+    std::vector<std::unique_ptr<log_file>> files;
+    std::vector<std::string> expected[LOGGERS];
+    {
+        std::vector<std::unique_ptr<async_logger>> loggers;
+        for (int l = 0; l < LOGGERS; l++) {
+            files.emplace_back(new log_file());
+            loggers.emplace_back(new async_logger(files.back()->fd()));
+        }
+        for (int i = 0; i < 300; i++) {
+            const int l = i % 2 == 0 ? i % LOGGERS : (i * 5) % LOGGERS;
+            loggers[l]->log("%d", i);
+            expected[l].push_back(std::to_string(i));
+        }
+        // A logger created after others were destroyed doesn't reuse their
+        // cached rings.
+        loggers.pop_back();
+        files.emplace_back(new log_file());
+        loggers.emplace_back(new async_logger(files.back()->fd()));
+        loggers.back()->log("new");
+    }
+    for (int l = 0; l < LOGGERS; l++) {
+        EXPECT_EQ(expected[l], files[l]->lines());
+    }
+    EXPECT_EQ((std::vector<std::string>{"new"}), files[LOGGERS]->lines());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,10 @@
+#include <algorithm> // sort, is_sorted
 #include <cassert>
+#include <cstdlib>   // rand
+#include <deque>
 #include <stdexcept> // out_of_range
+#include <string>
+#include <vector>
 #include "gtest/gtest.h"
 #include "circular_buffer.h"
 
@@ -251,6 +256,335 @@ TEST(CircularBufferTest, list_initialization) {
     EXPECT_EQ(4, buf[3]);
 }
 
+TEST(CircularBufferTest, memory_usage) {
+    circular_buffer<int, 8> buf{};
+    circular_buffer<int, 8>::memory_usage_info usage = buf.memory_usage();
+    EXPECT_EQ(sizeof(buf), usage.object_bytes);
+    EXPECT_EQ(0, usage.heap_bytes);
+    EXPECT_EQ(0, usage.used_bytes);
+    EXPECT_EQ(8 * sizeof(int), usage.slack_bytes);
+    EXPECT_EQ(0.0, usage.overhead_per_element);
+
+    buf.push_back(1);
+    buf.push_back(2);
+    usage = buf.memory_usage();
+    EXPECT_EQ(2 * sizeof(int), usage.used_bytes);
+    EXPECT_EQ(6 * sizeof(int), usage.slack_bytes);
+    EXPECT_EQ((sizeof(buf) - 2 * sizeof(int)) / 2.0, usage.overhead_per_element);
+}
+
+TEST(CircularBufferTest, copy) {
+    circular_buffer<std::string, 8> buf{};
+    for (int i = 0; i < 10; i++) {
+        buf.push_back(std::to_string(i));
+    }
+    // Non-const lvalues must use the copy constructor, not the element
+    // forwarding constructor.
+    circular_buffer<std::string, 8> copy(buf);
+    EXPECT_EQ(7, copy.len());
+    for (std::size_t i = 0; i < 7; i++) {
+        EXPECT_EQ(std::to_string(i + 3), copy[i]);
+        EXPECT_EQ(buf[i], copy[i]);
+    }
+
+    circular_buffer<std::string, 8> assigned {"a", "b"};
+    assigned = buf;
+    EXPECT_EQ(7, assigned.len());
+    EXPECT_EQ("3", assigned.front());
+    EXPECT_EQ("9", assigned.back());
+    assigned.push_back("10");
+    EXPECT_EQ("4", assigned.front());
+    EXPECT_EQ("10", assigned.back());
+    EXPECT_EQ("3", buf.front());
+}
+
+TEST(CircularBufferTest, move) {
+    circular_buffer<std::string, 8> buf {"a", "b", "c"};
+    buf.pop_front();
+    circular_buffer<std::string, 8> moved(std::move(buf));
+    EXPECT_EQ(2, moved.len());
+    EXPECT_EQ("b", moved.front());
+    EXPECT_EQ("c", moved.back());
+    EXPECT_EQ(true, buf.empty());
+
+    buf = std::move(moved);
+    EXPECT_EQ(2, buf.len());
+    EXPECT_EQ("b", buf.front());
+    EXPECT_EQ(true, moved.empty());
+}
+
+TEST(CircularBufferTest, heap) {
+    heap_circular_buffer<std::string, 8> buf {"a", "b"};
+    EXPECT_EQ(2, buf.len());
+    EXPECT_EQ(8 * sizeof(std::string), buf.memory_usage().heap_bytes);
+    for (int i = 0; i < 10; i++) {
+        buf.push_back(std::to_string(i));
+    }
+    const std::string* storage = &buf.front();
+
+    heap_circular_buffer<std::string, 8> moved(std::move(buf));
+    EXPECT_EQ(storage, &moved.front());
+    EXPECT_EQ(7, moved.len());
+    EXPECT_EQ("3", moved.front());
+
+    heap_circular_buffer<std::string, 8> other {"x"};
+    swap(moved, other);
+    EXPECT_EQ(storage, &other.front());
+    EXPECT_EQ(1, moved.len());
+    EXPECT_EQ("x", moved.front());
+
+    // A moved-from buffer may be assigned to.
+    buf = other;
+    EXPECT_EQ(7, buf.len());
+    EXPECT_EQ("3", buf.front());
+    EXPECT_NE(storage, &buf.front());
+}
+
+TEST(CircularBufferTest, swap) {
+    circular_buffer<int, 4> a {1, 2};
+    circular_buffer<int, 4> b {3};
+    a.swap(b);
+    EXPECT_EQ(1, a.len());
+    EXPECT_EQ(3, a.front());
+    EXPECT_EQ(2, b.len());
+    EXPECT_EQ(1, b.front());
+    EXPECT_EQ(2, b.back());
+}
+
+TEST(CircularBufferTest, swap_wrapped) {
+    // Every combination of lengths and storage offsets, so each buffer may be
+    // wrapped, and either may be the longer.
+    using buffer = circular_buffer<std::string, 5>;
+    const auto make = [](std::size_t offset, std::size_t n, char c, std::deque<std::string>& expected) {
+        buffer buf;
+        for (std::size_t i = 0; i < offset; i++) {
+            buf.push_back("-");
+            buf.pop_front();
+        }
+        for (std::size_t i = 0; i < n; i++) {
+            expected.push_back(std::string(1, c) + std::to_string(i));
+            buf.push_back(expected.back());
+        }
+        return buf;
+    };
+    const auto check = [](const std::deque<std::string>& expected, buffer& buf) {
+        ASSERT_EQ(expected.size(), buf.len());
+        for (std::size_t i = 0; i < expected.size(); i++) {
+            ASSERT_EQ(expected[i], buf[i]);
+        }
+        // The buffer is still usable once swapped.
+        buf.push_back("end");
+        ASSERT_EQ("end", buf.back());
+        buf.pop_back();
+    };
+    for (std::size_t a_offset = 0; a_offset < 5; a_offset++) {
+        for (std::size_t a_len = 0; a_len < 5; a_len++) {
+            for (std::size_t b_offset = 0; b_offset < 5; b_offset++) {
+                for (std::size_t b_len = 0; b_len < 5; b_len++) {
+                    std::deque<std::string> a_expected;
+                    std::deque<std::string> b_expected;
+                    buffer a = make(a_offset, a_len, 'a', a_expected);
+                    buffer b = make(b_offset, b_len, 'b', b_expected);
+                    swap(a, b);
+                    check(b_expected, a);
+                    check(a_expected, b);
+                }
+            }
+        }
+    }
+}
+
+// Returns an iterator to the element at the given index of the buffer.
+template <typename BUF>
+typename BUF::iterator iterator_at(BUF& buf, std::size_t index) {
+    typename BUF::iterator it = buf.begin();
+    for (std::size_t i = 0; i < index; i++) {
+        ++it;
+    }
+    return it;
+}
+
+template <typename BUF>
+void expect_equal(const std::deque<int>& expected, const BUF& buf) {
+    ASSERT_EQ(expected.size(), buf.len());
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(expected[i], buf[i]);
+    }
+}
+
+TEST(CircularBufferTest, insert) {
+    circular_buffer<int, 8> buf {1, 2, 4};
+    auto it = buf.insert(iterator_at(buf, 2), 3);
+    EXPECT_EQ(3, *it);
+    expect_equal({1, 2, 3, 4}, buf);
+    buf.insert(buf.begin(), 0);
+    buf.insert(buf.end(), 5);
+    expect_equal({0, 1, 2, 3, 4, 5}, buf);
+
+    // Inserting into a full buffer discards the oldest element.
+    buf.push_back(6);
+    buf.insert(iterator_at(buf, 3), 100);
+    expect_equal({1, 2, 100, 3, 4, 5, 6}, buf);
+    it = buf.insert(buf.begin(), 200);
+    EXPECT_EQ(true, it == buf.begin());
+    expect_equal({1, 2, 100, 3, 4, 5, 6}, buf);
+}
+
+TEST(CircularBufferTest, erase) {
+    circular_buffer<int, 8> buf {0, 1, 2, 3, 4, 5};
+    auto it = buf.erase(iterator_at(buf, 1));
+    EXPECT_EQ(2, *it);
+    expect_equal({0, 2, 3, 4, 5}, buf);
+    it = buf.erase(iterator_at(buf, 3));
+    EXPECT_EQ(5, *it);
+    expect_equal({0, 2, 3, 5}, buf);
+    it = buf.erase(iterator_at(buf, 1), iterator_at(buf, 3));
+    EXPECT_EQ(5, *it);
+    expect_equal({0, 5}, buf);
+    it = buf.erase(buf.begin(), buf.end());
+    EXPECT_EQ(true, it == buf.end());
+    EXPECT_EQ(true, buf.empty());
+}
+
+TEST(CircularBufferTest, insert_erase_random) {
+    // Compare against a deque over many operations so both sides of the ring
+    // are shifted across the wrap point.
+    circular_buffer<int, 11> buf{};
+    std::deque<int> expected;
+    std::srand(1);
+    for (int op = 0; op < 5000; op++) {
+        const std::size_t index = expected.empty() ? 0 : std::rand() % (expected.size() + 1);
+        switch (std::rand() % 4) {
+        case 0:
+        case 1:
+            if (expected.size() == buf.capacity()) {
+                if (index == 0) {
+                    break;
+                }
+                expected.pop_front();
+                expected.insert(expected.begin() + (index - 1), op);
+            } else {
+                expected.insert(expected.begin() + index, op);
+            }
+            buf.insert(iterator_at(buf, index), op);
+            break;
+        case 2:
+            if (index < expected.size()) {
+                expected.erase(expected.begin() + index);
+                buf.erase(iterator_at(buf, index));
+            }
+            break;
+        case 3: {
+            const std::size_t last = index + std::rand() % (expected.size() - index + 1);
+            expected.erase(expected.begin() + index, expected.begin() + last);
+            buf.erase(iterator_at(buf, index), iterator_at(buf, last));
+            break;
+        }
+        }
+        expect_equal(expected, buf);
+    }
+}
+
+TEST(CircularBufferTest, segments) {
+    circular_buffer<int, 8> buf{};
+    EXPECT_EQ(0, buf.array_one().second);
+    EXPECT_EQ(0, buf.array_two().second);
+    for (int i = 0; i < 5; i++) {
+        buf.push_back(i);
+    }
+    EXPECT_EQ(5, buf.array_one().second);
+    EXPECT_EQ(0, buf.array_one().first[0]);
+    EXPECT_EQ(0, buf.array_two().second);
+
+    // Wrap: the front is 4 and 4..7 are in the first segment, 8..9 in the
+    // second.
+    buf.pop_front(4);
+    EXPECT_EQ(1, buf.len());
+    for (int i = 5; i < 10; i++) {
+        buf.push_back(i);
+    }
+    std::pair<int*, std::size_t> one = buf.array_one();
+    std::pair<int*, std::size_t> two = buf.array_two();
+    ASSERT_EQ(4, one.second);
+    ASSERT_EQ(2, two.second);
+    for (std::size_t i = 0; i < one.second; i++) {
+        EXPECT_EQ(4 + static_cast<int>(i), one.first[i]);
+    }
+    for (std::size_t i = 0; i < two.second; i++) {
+        EXPECT_EQ(8 + static_cast<int>(i), two.first[i]);
+    }
+    buf.pop_front(5);
+    EXPECT_EQ(9, buf.front());
+    EXPECT_EQ(1, buf.len());
+}
+
+TEST(CircularBufferTest, push_back_range) {
+    const int items[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    circular_buffer<int, 8> buf{};
+    buf.push_back(items, 5);
+    EXPECT_EQ(5, buf.len());
+    EXPECT_EQ(0, buf.front());
+    EXPECT_EQ(4, buf.back());
+
+    // Wraps the storage and overwrites the two oldest items.
+    buf.push_back(items + 5, 4);
+    EXPECT_EQ(7, buf.len());
+    for (std::size_t i = 0; i < buf.len(); i++) {
+        EXPECT_EQ(2 + static_cast<int>(i), buf[i]);
+    }
+
+    // Only the last capacity() items of an oversized range are kept.
+    buf.push_back(items, 12);
+    EXPECT_EQ(7, buf.len());
+    for (std::size_t i = 0; i < buf.len(); i++) {
+        EXPECT_EQ(5 + static_cast<int>(i), buf[i]);
+    }
+}
+
+TEST(CircularBufferTest, random_access_iterators) {
+    circular_buffer<int, 8> buf{};
+    for (int i = 0; i < 10; i++) {
+        buf.push_back((i * 5) % 11);
+    }
+    // The elements have wrapped, so iterators cross the end of the storage.
+    circular_buffer<int, 8>::iterator first = buf.begin();
+    EXPECT_EQ(7, buf.end() - first);
+    EXPECT_EQ(buf[3], first[3]);
+    EXPECT_EQ(buf[6], *(buf.end() - 1));
+    EXPECT_EQ(true, first < first + 1);
+    EXPECT_EQ(true, buf.end() == first + 7);
+    EXPECT_EQ(true, (first + 7) - 7 == first);
+
+    std::sort(buf.begin(), buf.end());
+    EXPECT_EQ(true, std::is_sorted(buf.cbegin(), buf.cend()));
+    std::vector<int> reversed(std::reverse_iterator<circular_buffer<int, 8>::iterator>(buf.end()),
+                              std::reverse_iterator<circular_buffer<int, 8>::iterator>(buf.begin()));
+    ASSERT_EQ(7, reversed.size());
+    EXPECT_EQ(buf.back(), reversed[0]);
+    EXPECT_EQ(buf.front(), reversed[6]);
+
+    circular_buffer<int, 8>::const_iterator converted = buf.begin();
+    EXPECT_EQ(true, converted == buf.cbegin());
+
+    // Iterators and const_iterators compare in either order.
+    const circular_buffer<int, 8>::iterator it = buf.begin() + 2;
+    const circular_buffer<int, 8>::const_iterator cit = buf.cbegin() + 2;
+    EXPECT_EQ(true, it == cit);
+    EXPECT_EQ(true, cit == it);
+    EXPECT_EQ(false, it != cit);
+    EXPECT_EQ(false, cit != it);
+    EXPECT_EQ(true, it < cit + 1);
+    EXPECT_EQ(true, cit < it + 1);
+    EXPECT_EQ(true, it + 1 > cit);
+    EXPECT_EQ(true, cit + 1 > it);
+    EXPECT_EQ(true, it <= cit);
+    EXPECT_EQ(true, cit <= it);
+    EXPECT_EQ(true, it >= cit);
+    EXPECT_EQ(true, cit >= it);
+    EXPECT_EQ(2, it - buf.cbegin());
+    EXPECT_EQ(-2, buf.cbegin() - it);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
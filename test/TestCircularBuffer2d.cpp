@@ -0,0 +1,256 @@
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "gtest/gtest.h"
+#include "circular_buffer_2d.h"
+
+static const std::size_t W = 5;
+static const std::size_t H = 3;
+using grid = circular_buffer_2d<int, W, H>;
+
+/** The contents of the window, row by row. */
+static std::vector<std::vector<int>> contents(const grid& g) {
+    std::vector<std::vector<int>> out(H, std::vector<int>(W));
+    for (std::size_t y = 0; y < H; y++) {
+        for (std::size_t x = 0; x < W; x++) {
+            out[y][x] = g(x, y);
+        }
+    }
+    return out;
+}
+
+/** Sets every cell to 10 * y + x. */
+static void number(grid& g) {
+    for (std::size_t y = 0; y < H; y++) {
+        for (std::size_t x = 0; x < W; x++) {
+            g(x, y) = static_cast<int>(10 * y + x);
+        }
+    }
+}
+
+/** The expected contents after scrolling a numbered grid by (dx, dy)
+ *  without filling. */
+static std::vector<std::vector<int>> scrolled(std::ptrdiff_t dx, std::ptrdiff_t dy) {
+    std::vector<std::vector<int>> out(H, std::vector<int>(W));
+    for (std::size_t y = 0; y < H; y++) {
+        for (std::size_t x = 0; x < W; x++) {
+            const std::ptrdiff_t w = static_cast<std::ptrdiff_t>(W);
+            const std::ptrdiff_t h = static_cast<std::ptrdiff_t>(H);
+            const std::size_t sx = static_cast<std::size_t>(((static_cast<std::ptrdiff_t>(x) + dx) % w + w) % w);
+            const std::size_t sy = static_cast<std::size_t>(((static_cast<std::ptrdiff_t>(y) + dy) % h + h) % h);
+            out[y][x] = static_cast<int>(10 * sy + sx);
+        }
+    }
+    return out;
+}
+
+TEST(CircularBuffer2dTest, construct) {
+    grid g;
+    EXPECT_EQ(W, g.width());
+    EXPECT_EQ(H, g.height());
+    EXPECT_EQ(std::vector<std::vector<int>>(H, std::vector<int>(W, 0)), contents(g));
+    number(g);
+    EXPECT_EQ(scrolled(0, 0), contents(g));
+}
+
+TEST(CircularBuffer2dTest, scroll) {
+    // Scrolling in either direction, by any amount, wraps the old contents.
+    for (std::ptrdiff_t dx = -12; dx <= 12; dx++) {
+        for (std::ptrdiff_t dy = -7; dy <= 7; dy++) {
+            grid g;
+            number(g);
+            g.scroll_x(dx);
+            g.scroll_y(dy);
+            ASSERT_EQ(scrolled(dx, dy), contents(g)) << dx << ", " << dy;
+        }
+    }
+    // Scrolling back restores the original window.
+    grid g;
+    number(g);
+    g.scroll_x(3);
+    g.scroll_y(-2);
+    g.scroll_x(-3);
+    g.scroll_y(2);
+    EXPECT_EQ(scrolled(0, 0), contents(g));
+
+    // The most negative offset doesn't overflow. With a 64-bit ptrdiff_t it
+    // is -(2^63), and 2^63 is 3 modulo 5 and 2 modulo 3.
+    if (sizeof(std::ptrdiff_t) == 8) {
+        g.scroll_x(std::numeric_limits<std::ptrdiff_t>::min());
+        g.scroll_y(std::numeric_limits<std::ptrdiff_t>::min());
+        EXPECT_EQ(scrolled(-3, -2), contents(g));
+    }
+}
+
+TEST(CircularBuffer2dTest, scroll_fill) {
+    // Columns and rows scrolled in are filled; the rest keep their contents.
+    for (std::ptrdiff_t dx = -7; dx <= 7; dx++) {
+        grid g;
+        number(g);
+        g.scroll_x(dx, -1);
+        std::vector<std::vector<int>> expected = scrolled(dx, 0);
+        for (std::size_t x = 0; x < W; x++) {
+            const bool filled = dx > 0 ? x + static_cast<std::size_t>(dx) >= W
+                                       : static_cast<std::ptrdiff_t>(x) < -dx;
+            for (std::size_t y = 0; y < H && filled; y++) {
+                expected[y][x] = -1;
+            }
+        }
+        ASSERT_EQ(expected, contents(g)) << dx;
+    }
+    for (std::ptrdiff_t dy = -5; dy <= 5; dy++) {
+        grid g;
+        number(g);
+        g.scroll_y(dy, -1);
+        std::vector<std::vector<int>> expected = scrolled(0, dy);
+        for (std::size_t y = 0; y < H; y++) {
+            const bool filled = dy > 0 ? y + static_cast<std::size_t>(dy) >= H
+                                       : static_cast<std::ptrdiff_t>(y) < -dy;
+            if (filled) {
+                expected[y] = std::vector<int>(W, -1);
+            }
+        }
+        ASSERT_EQ(expected, contents(g)) << dy;
+    }
+}
+
+TEST(CircularBuffer2dTest, row_column_spans) {
+    grid g;
+    number(g);
+    // Without scrolling, rows are one contiguous run and columns one strided
+    // run.
+    grid_line<int> r = g.row(1);
+    EXPECT_EQ(W, r.first.size);
+    EXPECT_EQ(0, r.second.size);
+    EXPECT_EQ(1, r.first.stride);
+    grid_line<int> c = g.column(1);
+    EXPECT_EQ(H, c.first.size);
+    EXPECT_EQ(0, c.second.size);
+    EXPECT_EQ(W, c.first.stride);
+
+    // After scrolling, they wrap around the edge of the storage.
+    g.scroll_x(2);
+    g.scroll_y(1);
+    for (std::size_t y = 0; y < H; y++) {
+        r = g.row(y);
+        ASSERT_EQ(W - 2, r.first.size);
+        ASSERT_EQ(2, r.second.size);
+        ASSERT_EQ(W, r.size());
+        // The first run ends the storage row and the second starts it.
+        EXPECT_EQ(r.first.data + W - 2, r.second.data + W);
+        for (std::size_t x = 0; x < W; x++) {
+            EXPECT_EQ(&g(x, y), &r[x]);
+        }
+    }
+    for (std::size_t x = 0; x < W; x++) {
+        c = g.column(x);
+        ASSERT_EQ(H - 1, c.first.size);
+        ASSERT_EQ(1, c.second.size);
+        ASSERT_EQ(H, c.size());
+        EXPECT_EQ(W, c.second.stride);
+        for (std::size_t y = 0; y < H; y++) {
+            EXPECT_EQ(&g(x, y), &c[y]);
+        }
+    }
+
+    // The const overloads see the same cells.
+    const grid& view = g;
+    const grid_line<const int> const_row = view.row(2);
+    const grid_line<const int> const_column = view.column(4);
+    for (std::size_t x = 0; x < W; x++) {
+        EXPECT_EQ(&g(x, 2), &const_row[x]);
+    }
+    for (std::size_t y = 0; y < H; y++) {
+        EXPECT_EQ(&g(4, y), &const_column[y]);
+    }
+}
+
+TEST(CircularBuffer2dTest, write_row_column) {
+    grid g;
+    number(g);
+    g.scroll_x(3);
+    g.scroll_y(2);
+    const int row_values[W] = {100, 101, 102, 103, 104};
+    g.write_row(1, row_values);
+    const int column_values[H] = {200, 201, 202};
+    g.write_column(3, column_values);
+    std::vector<std::vector<int>> expected = scrolled(3, 2);
+    expected[1] = std::vector<int>(row_values, row_values + W);
+    for (std::size_t y = 0; y < H; y++) {
+        expected[y][3] = column_values[y];
+    }
+    EXPECT_EQ(expected, contents(g));
+}
+
+TEST(CircularBuffer2dTest, push_row) {
+    // Pushing rows keeps the last HEIGHT, oldest first.
+    grid g;
+    for (int r = 0; r < 7; r++) {
+        int values[W];
+        for (std::size_t x = 0; x < W; x++) {
+            values[x] = 10 * r + static_cast<int>(x);
+        }
+        g.push_row(values);
+        const int newest = r;
+        for (std::size_t y = 0; y < H; y++) {
+            const int pushed = newest - static_cast<int>(H - 1 - y);
+            for (std::size_t x = 0; x < W; x++) {
+                ASSERT_EQ(pushed < 0 ? 0 : 10 * pushed + static_cast<int>(x), g(x, y));
+            }
+        }
+    }
+}
+
+TEST(CircularBuffer2dTest, push_column) {
+    // Pushing columns keeps the last WIDTH, oldest first.
+    grid g;
+    for (int c = 0; c < 12; c++) {
+        int values[H];
+        for (std::size_t y = 0; y < H; y++) {
+            values[y] = 10 * c + static_cast<int>(y);
+        }
+        g.push_column(values);
+        for (std::size_t x = 0; x < W; x++) {
+            const int pushed = c - static_cast<int>(W - 1 - x);
+            for (std::size_t y = 0; y < H; y++) {
+                ASSERT_EQ(pushed < 0 ? 0 : 10 * pushed + static_cast<int>(y), g(x, y));
+            }
+        }
+    }
+}
+
+TEST(CircularBuffer2dTest, copy_move) {
+    grid a;
+    number(a);
+    a.scroll_x(1);
+    a.scroll_y(2);
+
+    grid b(a);
+    EXPECT_EQ(contents(a), contents(b));
+    b(0, 0) = -1;
+    EXPECT_EQ(scrolled(1, 2), contents(a));
+
+    grid c;
+    c = a;
+    EXPECT_EQ(contents(a), contents(c));
+    c(1, 1) = -1;
+    EXPECT_EQ(scrolled(1, 2), contents(a));
+
+    grid d(std::move(b));
+    EXPECT_EQ(-1, d(0, 0));
+    grid e;
+    e = std::move(d);
+    EXPECT_EQ(-1, e(0, 0));
+
+    // A moved-from buffer may be assigned to.
+    b = a;
+    EXPECT_EQ(scrolled(1, 2), contents(b));
+    d = std::move(c);
+    EXPECT_EQ(-1, d(1, 1));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,62 @@
+#include <algorithm> // min
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "gtest/gtest.h"
+#include "circular_buffer_hash.h"
+
+TEST(CircularBufferHashTest, crc32c_vectors) {
+    EXPECT_EQ(0u, crc32c("", 0));
+    EXPECT_EQ(0xE3069283u, crc32c("123456789", 9));
+    const unsigned char zeros[32] = {};
+    EXPECT_EQ(0x8A9136AAu, crc32c(zeros, sizeof(zeros)));
+    // Resuming from an earlier checksum.
+    EXPECT_EQ(0xE3069283u, crc32c("6789", 4, crc32c("12345", 5)));
+}
+
+TEST(CircularBufferHashTest, xxhash64_vectors) {
+    EXPECT_EQ(0xEF46DB3751D8E999ull, xxhash64("", 0));
+    EXPECT_EQ(0x44BC2CF5AD770999ull, xxhash64("abc", 3));
+}
+
+TEST(CircularBufferHashTest, incremental) {
+    std::string data;
+    for (int i = 0; i < 1000; i++) {
+        data.push_back(static_cast<char>(i * 7));
+    }
+    const std::uint64_t expected = xxhash64(data.data(), data.size(), 42);
+    for (std::size_t piece = 1; piece < 100; piece += 7) {
+        xxhash64_state state(42);
+        crc32c_state crc;
+        for (std::size_t i = 0; i < data.size(); i += piece) {
+            const std::size_t n = std::min(piece, data.size() - i);
+            state.update(data.data() + i, n);
+            crc.update(data.data() + i, n);
+        }
+        EXPECT_EQ(expected, state.digest());
+        EXPECT_EQ(crc32c(data.data(), data.size()), crc.value());
+    }
+}
+
+TEST(CircularBufferHashTest, buffer) {
+    // Hashing a wrapped buffer matches hashing its contents contiguously.
+    for (std::size_t offset = 0; offset < 64; offset++) {
+        circular_buffer<char, 64> buf{};
+        for (std::size_t i = 0; i < offset; i++) {
+            buf.push_back(0);
+        }
+        buf.pop_front(offset);
+        std::string contents;
+        for (int i = 0; i < 50; i++) {
+            buf.push_back(static_cast<char>('a' + i % 26));
+            contents.push_back(static_cast<char>('a' + i % 26));
+        }
+        ASSERT_EQ(crc32c(contents.data(), contents.size()), crc32c(buf));
+        ASSERT_EQ(xxhash64(contents.data(), contents.size(), 7), xxhash64(buf, 7));
+    }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "circular_buffer_scan.h"
+
+typedef circular_buffer<char, 128> byte_buffer;
+
+/** Fills a buffer with the given contents, starting at the given storage
+ *  offset so the contents wrap. */
+static void fill(byte_buffer& buf, const std::string& contents, std::size_t offset) {
+    for (std::size_t i = 0; i < offset; i++) {
+        buf.push_back(0);
+    }
+    buf.pop_front(offset);
+    for (char c : contents) {
+        buf.push_back(c);
+    }
+}
+
+TEST(CircularBufferScanTest, find) {
+    const std::string contents = std::string(70, 'a') + "x" + std::string(30, 'b') + "y";
+    for (std::size_t offset = 0; offset < 128; offset++) {
+        byte_buffer buf{};
+        fill(buf, contents, offset);
+        ASSERT_EQ(70, find(buf, 'x'));
+        ASSERT_EQ(101, find(buf, 'y'));
+        ASSERT_EQ(buf.len(), find(buf, 'z'));
+        ASSERT_EQ(71, find(buf, 'b', 71));
+        ASSERT_EQ(buf.len(), find(buf, 'x', 71));
+        ASSERT_EQ(70, find_any(buf, "yx", 2));
+        ASSERT_EQ(101, find_any(buf, "zy", 2, 71));
+        ASSERT_EQ(buf.len(), find_any(buf, "cd", 2));
+    }
+}
+
+TEST(CircularBufferScanTest, find_delimiter) {
+    const std::string contents = "ab\rcd\r\nef\r\n";
+    for (std::size_t offset = 0; offset < 128; offset++) {
+        byte_buffer buf{};
+        fill(buf, contents, offset);
+        ASSERT_EQ(5, find(buf, "\r\n", 2));
+        ASSERT_EQ(9, find(buf, "\r\n", 2, 6));
+        ASSERT_EQ(buf.len(), find(buf, "\n\n", 2));
+    }
+}
+
+TEST(CircularBufferScanTest, split_lines) {
+    const std::string contents = "first\r\n\nsecond line\nthird line which is longer\r\npartial";
+    for (std::size_t offset = 0; offset < 128; offset++) {
+        byte_buffer buf{};
+        fill(buf, contents, offset);
+        std::vector<std::string> lines;
+        const std::size_t consumed = split_lines(buf, [&lines](byte_span first, byte_span second) {
+            lines.push_back(std::string(first.data, first.size) + std::string(second.data, second.size));
+        });
+        ASSERT_EQ(contents.size() - 7, consumed);
+        ASSERT_EQ((std::vector<std::string>{"first", "", "second line", "third line which is longer"}), lines);
+        buf.pop_front(consumed);
+        ASSERT_EQ(7, buf.len());
+        ASSERT_EQ('p', buf.front());
+    }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
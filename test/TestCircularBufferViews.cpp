@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "circular_buffer_views.h"
+#include "dynamic_circular_buffer.h"
+
+#if __cplusplus >= 202002L && __has_include(<ranges>)
+#include <ranges>
+#endif
+
+using namespace circular_buffer_views;
+
+// Collects a view by iterating it and checks for_each visits the same
+// elements.
+template <typename V>
+std::vector<typename std::decay<decltype(*std::declval<V>().begin())>::type> collect(const V& view) {
+    std::vector<typename std::decay<decltype(*view.begin())>::type> iterated(view.begin(), view.end());
+    std::vector<typename std::decay<decltype(*view.begin())>::type> visited;
+    view.for_each([&visited](const typename std::decay<decltype(*view.begin())>::type& x) {
+        visited.push_back(x);
+    });
+    EXPECT_EQ(iterated, visited);
+    return iterated;
+}
+
+// Returns a buffer holding 3..9, wrapped around the end of its storage.
+static circular_buffer<int, 8> wrapped() {
+    circular_buffer<int, 8> buf{};
+    for (int i = 0; i < 10; i++) {
+        buf.push_back(i);
+    }
+    return buf;
+}
+
+TEST(CircularBufferViewsTest, transform) {
+    const circular_buffer<int, 8> buf = wrapped();
+    auto squares = buf | transform([](int x) { return x * x; });
+    EXPECT_EQ(7, squares.size());
+    EXPECT_EQ(7, squares.end() - squares.begin());
+    EXPECT_EQ(25, squares.begin()[2]);
+    EXPECT_EQ(std::vector<int>({9, 16, 25, 36, 49, 64, 81}), collect(squares));
+
+    auto names = transform(buf, [](int x) { return std::to_string(x); });
+    EXPECT_EQ("9", *(names.end() - 1));
+}
+
+TEST(CircularBufferViewsTest, filter) {
+    const circular_buffer<int, 8> buf = wrapped();
+    EXPECT_EQ(std::vector<int>({4, 6, 8}), collect(buf | filter([](int x) { return x % 2 == 0; })));
+    EXPECT_EQ(std::vector<int>(), collect(buf | filter([](int x) { return x > 100; })));
+}
+
+TEST(CircularBufferViewsTest, take_last) {
+    const circular_buffer<int, 8> buf = wrapped();
+    EXPECT_EQ(std::vector<int>({7, 8, 9}), collect(buf | take_last(3)));
+    EXPECT_EQ(7, (buf | take_last(100)).size());
+    EXPECT_EQ(std::vector<int>(), collect(buf | take_last(0)));
+}
+
+TEST(CircularBufferViewsTest, stride) {
+    const circular_buffer<int, 8> buf = wrapped();
+    EXPECT_EQ(std::vector<int>({3, 6, 9}), collect(buf | stride(3)));
+    EXPECT_EQ(std::vector<int>({3, 5, 7, 9}), collect(buf | stride(2)));
+    EXPECT_EQ(4, (buf | stride(2)).size());
+}
+
+TEST(CircularBufferViewsTest, compose) {
+    const circular_buffer<int, 8> buf = wrapped();
+    // Every other one of the last five, doubled, then those over 15.
+    auto view = buf | take_last(5) | stride(2) | transform([](int x) { return x * 2; }) |
+                filter([](int x) { return x > 15; });
+    EXPECT_EQ(std::vector<int>({18}), collect(view));
+    EXPECT_EQ(std::vector<int>({14, 18}), collect(buf | take_last(5) | stride(2) |
+                                                 transform([](int x) { return x * 2; }) | take_last(2)));
+
+    dynamic_circular_buffer<int> dynamic(4);
+    for (int i = 0; i < 6; i++) {
+        dynamic.push_back(i);
+    }
+    EXPECT_EQ(std::vector<int>({3, 5}), collect(dynamic | stride(2) | transform([](int x) { return x + 1; })));
+}
+
+#if __cplusplus >= 202002L && __has_include(<ranges>)
+TEST(CircularBufferViewsTest, ranges) {
+    const circular_buffer<int, 8> buf = wrapped();
+    auto view = buf | take_last(4) | transform([](int x) { return x * 10; });
+    static_assert(std::ranges::random_access_range<decltype(view)>);
+    static_assert(std::ranges::view<decltype(view)>);
+    std::vector<int> result;
+    for (int x : view | std::views::reverse | std::views::take(2)) {
+        result.push_back(x);
+    }
+    EXPECT_EQ(std::vector<int>({90, 80}), result);
+    EXPECT_EQ(4, std::ranges::count_if(buf | filter([](int x) { return x > 5; }), [](int) { return true; }));
+}
+#endif
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,101 @@
+#include <algorithm> // sort, is_sorted
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <stdexcept> // out_of_range
+#include "gtest/gtest.h"
+#include "dynamic_circular_buffer.h"
+#include "fast_mod.h"
+
+TEST(FastModTest, matches_modulo) {
+    std::mt19937 rng(1);
+    const std::uint32_t divisors[] = {1, 2, 3, 7, 10, 1000, 65537, 0x7FFFFFFF, 0xFFFFFFFF};
+    for (std::uint32_t d : divisors) {
+        const fast_mod mod(d);
+        EXPECT_EQ(d, mod.divisor());
+        EXPECT_EQ(0u % d, mod(0));
+        EXPECT_EQ(0xFFFFFFFFu % d, mod(0xFFFFFFFFu));
+        for (int i = 0; i < 10000; i++) {
+            const std::uint32_t x = rng();
+            ASSERT_EQ(x % d, mod(x));
+        }
+    }
+    for (int i = 0; i < 10000; i++) {
+        const std::uint32_t d = rng() | 1;
+        const std::uint32_t x = rng();
+        ASSERT_EQ(x % d, fast_mod(d)(x));
+    }
+}
+
+TEST(DynamicCircularBufferTest, push_pop) {
+    dynamic_circular_buffer<int> buf(5);
+    EXPECT_EQ(5, buf.capacity());
+    EXPECT_EQ(true, buf.empty());
+    std::deque<int> expected;
+    for (int i = 0; i < 100; i++) {
+        buf.push_back(i);
+        expected.push_back(i);
+        if (expected.size() > 5) {
+            expected.pop_front();
+        }
+        if (i % 7 == 0) {
+            buf.pop_front();
+            expected.pop_front();
+        }
+        if (i % 11 == 0 && !expected.empty()) {
+            buf.pop_back();
+            expected.pop_back();
+        }
+        ASSERT_EQ(expected.size(), buf.len());
+        for (std::size_t j = 0; j < expected.size(); j++) {
+            ASSERT_EQ(expected[j], buf[j]);
+        }
+        ASSERT_EQ(expected.size() == 5, buf.full());
+    }
+    EXPECT_EQ(expected.front(), buf.front());
+    EXPECT_EQ(expected.back(), buf.back());
+    EXPECT_THROW(buf.at(buf.len()), std::out_of_range);
+    buf.pop_front(buf.len());
+    EXPECT_EQ(true, buf.empty());
+}
+
+TEST(DynamicCircularBufferTest, random_access) {
+    dynamic_circular_buffer<int> buf(13);
+    for (int i = 0; i < 20; i++) {
+        buf.push_back((i * 7) % 20);
+    }
+    dynamic_circular_buffer<int>::iterator it = buf.begin();
+    EXPECT_EQ(13, buf.end() - it);
+    EXPECT_EQ(buf[5], *(it + 5));
+    EXPECT_EQ(buf[12], it[12]);
+    std::sort(buf.begin(), buf.end());
+    EXPECT_EQ(true, std::is_sorted(buf.cbegin(), buf.cend()));
+
+    // Iterators and const_iterators compare in either order.
+    const dynamic_circular_buffer<int>::iterator mutable_it = buf.begin() + 2;
+    const dynamic_circular_buffer<int>::const_iterator const_it = buf.cbegin() + 2;
+    EXPECT_EQ(true, mutable_it == const_it);
+    EXPECT_EQ(true, const_it == mutable_it);
+    EXPECT_EQ(false, mutable_it != const_it);
+    EXPECT_EQ(false, const_it != mutable_it);
+    EXPECT_EQ(true, mutable_it < const_it + 1);
+    EXPECT_EQ(true, const_it < mutable_it + 1);
+    EXPECT_EQ(true, mutable_it + 1 > const_it);
+    EXPECT_EQ(true, const_it + 1 > mutable_it);
+    EXPECT_EQ(true, mutable_it <= const_it);
+    EXPECT_EQ(true, const_it <= mutable_it);
+    EXPECT_EQ(true, mutable_it >= const_it);
+    EXPECT_EQ(true, const_it >= mutable_it);
+    EXPECT_EQ(2, mutable_it - buf.cbegin());
+    EXPECT_EQ(-2, buf.cbegin() - mutable_it);
+
+    const dynamic_circular_buffer<int> copy(buf);
+    EXPECT_EQ(true, std::equal(buf.begin(), buf.end(), copy.begin()));
+    const std::pair<const int*, std::size_t> one = copy.array_one();
+    EXPECT_EQ(13, one.second + copy.array_two().second);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,130 @@
+#include <functional>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "gtest/gtest.h"
+#include "FrozenSet.h"
+#include "SimpleSet.h"
+
+/** Checks that every value in [lo, hi] is in the set exactly when it is in
+ *  the reference. */
+template <class Compare>
+static void expect_matches(const FrozenSet<int, Compare>& set, const std::set<int, Compare>& reference,
+                           int lo, int hi) {
+    ASSERT_EQ(reference.size(), set.size());
+    ASSERT_EQ(reference.empty(), set.empty());
+    for (int v = lo; v <= hi; v++) {
+        ASSERT_EQ(reference.count(v) != 0, set.contains(v)) << v;
+    }
+}
+
+TEST(FrozenSetTest, empty) {
+    const std::vector<int> none;
+    FrozenSet<int> set(none.begin(), none.end());
+    EXPECT_EQ(true, set.empty());
+    EXPECT_EQ(0, set.size());
+    EXPECT_EQ(false, set.contains(0));
+    EXPECT_EQ(false, set.contains(-1));
+    EXPECT_EQ(false, set.contains(1));
+}
+
+TEST(FrozenSetTest, sizes) {
+    // Every size up to 300 (so many incomplete trees, not just powers of
+    // two), queried for present values, gaps and values beyond either end.
+    std::vector<int> values;
+    for (int n = 0; n <= 300; n++) {
+        FrozenSet<int> set(values.begin(), values.end());
+        expect_matches(set, std::set<int>(values.begin(), values.end()), -5, 3 * n + 5);
+        values.push_back(3 * n);
+    }
+}
+
+TEST(FrozenSetTest, duplicates) {
+    std::mt19937 rng(1);
+    for (int trial = 0; trial < 50; trial++) {
+        std::vector<int> values;
+        const int n = static_cast<int>(rng() % 500);
+        for (int i = 0; i < n; i++) {
+            values.push_back(static_cast<int>(rng() % 200) - 100);
+        }
+        FrozenSet<int> set(values.begin(), values.end());
+        expect_matches(set, std::set<int>(values.begin(), values.end()), -110, 110);
+    }
+}
+
+TEST(FrozenSetTest, compare) {
+    const std::vector<int> values {5, 1, 9, 1, 3, 7, 5};
+    FrozenSet<int, std::greater<int>> set(values.begin(), values.end());
+    expect_matches(set, std::set<int, std::greater<int>>(values.begin(), values.end()), -2, 12);
+}
+
+TEST(FrozenSetTest, strings) {
+    // Elements larger than a cache line's share.
+    const std::vector<std::string> words {"pear", "apple", "fig", "apple", "kiwi", "date", "fig"};
+    FrozenSet<std::string> set(words.begin(), words.end());
+    EXPECT_EQ(5, set.size());
+    for (const std::string& word : words) {
+        EXPECT_EQ(true, set.contains(word));
+    }
+    EXPECT_EQ(false, set.contains(""));
+    EXPECT_EQ(false, set.contains("banana"));
+    EXPECT_EQ(false, set.contains("zucchini"));
+}
+
+TEST(FrozenSetTest, from_simple_set) {
+    SimpleSet<int> simple;
+    for (int i = 0; i < 100; i += 7) {
+        simple.insert(i);
+    }
+    FrozenSet<int> set(simple);
+    std::set<int> reference;
+    for (int i = 0; i < 100; i += 7) {
+        reference.insert(i);
+    }
+    expect_matches(set, reference, -1, 101);
+}
+
+TEST(FrozenSetTest, copy_move) {
+    std::vector<int> values;
+    for (int i = 0; i < 37; i++) {
+        values.push_back(2 * i);
+    }
+    const std::set<int> reference(values.begin(), values.end());
+    FrozenSet<int> original(values.begin(), values.end());
+
+    FrozenSet<int> copy(original);
+    expect_matches(copy, reference, -1, 80);
+    expect_matches(original, reference, -1, 80);
+
+    const std::vector<int> other_values {1, 2, 3};
+    FrozenSet<int> assigned(other_values.begin(), other_values.end());
+    assigned = original;
+    expect_matches(assigned, reference, -1, 80);
+    assigned = assigned;
+    expect_matches(assigned, reference, -1, 80);
+
+    // A moved-from set is left empty.
+    FrozenSet<int> moved(std::move(copy));
+    expect_matches(moved, reference, -1, 80);
+    expect_matches(copy, std::set<int>(), -1, 80);
+
+    FrozenSet<int> move_assigned(other_values.begin(), other_values.end());
+    move_assigned = std::move(moved);
+    expect_matches(move_assigned, reference, -1, 80);
+    expect_matches(moved, std::set<int>(), -1, 80);
+
+    // A moved-from set can be copied, and assigned to.
+    FrozenSet<int> copy_of_empty(moved);
+    expect_matches(copy_of_empty, std::set<int>(), -1, 80);
+    moved = original;
+    expect_matches(moved, reference, -1, 80);
+    copy = FrozenSet<int>(other_values.begin(), other_values.end());
+    expect_matches(copy, std::set<int>(other_values.begin(), other_values.end()), -1, 80);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
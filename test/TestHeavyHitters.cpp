@@ -0,0 +1,84 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include "gtest/gtest.h"
+#include "heavy_hitters.h"
+
+TEST(HeavyHittersTest, top) {
+    heavy_hitters<int, 1000, 16> hitters;
+    // Key k occurs (10 - k) * 10 times for k < 10, plus one-off keys.
+    int next_rare = 1000;
+    for (int round = 0; round < 10; round++) {
+        for (int k = 0; k < 10; k++) {
+            for (int i = 0; i < 10 - k; i++) {
+                hitters.push(k);
+            }
+        }
+        for (int i = 0; i < 30; i++) {
+            hitters.push(next_rare++);
+        }
+    }
+    EXPECT_EQ(850, hitters.size());
+    heavy_hitter<int> top[5];
+    ASSERT_EQ(5, hitters.top(top, 5));
+    for (int k = 0; k < 5; k++) {
+        EXPECT_EQ(k, top[k].key);
+        EXPECT_EQ(static_cast<std::uint32_t>((10 - k) * 10), top[k].count);
+    }
+    EXPECT_EQ(100, hitters.estimate(0));
+}
+
+TEST(HeavyHittersTest, window) {
+    heavy_hitters<std::string, 100, 4> hitters;
+    for (int i = 0; i < 100; i++) {
+        hitters.push(i % 2 ? "old" : "both");
+    }
+    heavy_hitter<std::string> top[4];
+    ASSERT_EQ(2, hitters.top(top, 4));
+    EXPECT_EQ(50, top[0].count);
+
+    // Once the window has moved past them, "old" events have expired.
+    for (int i = 0; i < 100; i++) {
+        hitters.push(i % 4 ? "new" : "both");
+    }
+    EXPECT_EQ(0, hitters.estimate("old"));
+    ASSERT_EQ(2, hitters.top(top, 4));
+    EXPECT_EQ("new", top[0].key);
+    EXPECT_EQ(75, top[0].count);
+    EXPECT_EQ("both", top[1].key);
+    EXPECT_EQ(25, top[1].count);
+}
+
+TEST(HeavyHittersTest, skewed) {
+    // Against exact counts of a Zipf-like stream over a sliding window, the
+    // heaviest keys must be found with counts no lower than the truth.
+    const std::size_t WINDOW = 5000;
+    heavy_hitters<std::uint32_t, WINDOW, 32> hitters;
+    circular_buffer<std::uint32_t, WINDOW + 1> events;
+    std::unordered_map<std::uint32_t, std::uint32_t> exact;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    for (int i = 0; i < 50000; i++) {
+        const std::uint32_t key = static_cast<std::uint32_t>(1.0 / (u(rng) + 0.001));
+        if (events.full()) {
+            exact[events.front()]--;
+            events.pop_front();
+        }
+        events.push_back(key);
+        exact[key]++;
+        hitters.push(key);
+    }
+    heavy_hitter<std::uint32_t> top[5];
+    ASSERT_EQ(5, hitters.top(top, 5));
+    for (std::uint32_t k = 1; k <= 5; k++) {
+        EXPECT_EQ(k, top[k - 1].key);
+        EXPECT_LE(exact[k], top[k - 1].count);
+        EXPECT_GE(exact[k] + WINDOW / 200, top[k - 1].count);
+    }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,74 @@
+#include <cstdint>
+#include <limits>
+#include <set>
+#include "gtest/gtest.h"
+#include "IntegerSet.h"
+
+TEST(IntegerSetTest, insert_contains) {
+    IntegerSet<uint32_t> set;
+    EXPECT_EQ(true, set.empty());
+    EXPECT_EQ(true, set.insert(7));
+    EXPECT_EQ(false, set.insert(7));
+    EXPECT_EQ(true, set.insert(0));
+    EXPECT_EQ(2, set.size());
+    EXPECT_EQ(true, set.contains(7));
+    EXPECT_EQ(true, set.contains(0));
+    EXPECT_EQ(false, set.contains(8));
+}
+
+TEST(IntegerSetTest, sentinel_key) {
+    IntegerSet<uint32_t> set;
+    const uint32_t max = std::numeric_limits<uint32_t>::max();
+    EXPECT_EQ(false, set.contains(max));
+    EXPECT_EQ(true, set.insert(max));
+    EXPECT_EQ(false, set.insert(max));
+    EXPECT_EQ(true, set.contains(max));
+    EXPECT_EQ(1, set.size());
+
+    int seen = 0;
+    for (uint32_t key : set) {
+        EXPECT_EQ(max, key);
+        seen++;
+    }
+    EXPECT_EQ(1, seen);
+}
+
+template <class T>
+void check_growth() {
+    IntegerSet<T> set;
+    std::set<T> expected;
+    // Multiples of a power of two collide heavily in the low bits, so this
+    // exercises both probing and wrapping around the table.
+    for (T i = 0; i < 20000; i++) {
+        const T key = (i % 5000) << 12;
+        EXPECT_EQ(expected.insert(key).second, set.insert(key));
+    }
+    EXPECT_EQ(expected.size(), set.size());
+    for (T i = 0; i < 5000; i++) {
+        EXPECT_EQ(true, set.contains(i << 12));
+        EXPECT_EQ(false, set.contains((i << 12) + 1));
+    }
+    std::set<T> iterated(set.begin(), set.end());
+    EXPECT_EQ(expected, iterated);
+}
+
+TEST(IntegerSetTest, growth) {
+    check_growth<uint32_t>();
+    check_growth<uint64_t>();
+    check_growth<uint16_t>();
+}
+
+TEST(IntegerSetTest, reserve) {
+    IntegerSet<uint64_t> set(100);
+    set.reserve(10000);
+    for (uint64_t i = 0; i < 10000; i++) {
+        set.insert(i * 0x100000001ull);
+    }
+    EXPECT_EQ(10000, set.size());
+    EXPECT_EQ(true, set.contains(9999 * 0x100000001ull));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
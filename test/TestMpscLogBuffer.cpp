@@ -0,0 +1,111 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept> // length_error
+#include <string>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "mpsc_log_buffer.h"
+
+static std::vector<std::string> read_all(mpsc_log_buffer& buf) {
+    std::vector<std::string> out;
+    buf.read([&out](const unsigned char* data, std::size_t len) {
+        out.push_back(std::string(reinterpret_cast<const char*>(data), len));
+    });
+    return out;
+}
+
+TEST(MpscLogBufferTest, write_read) {
+    mpsc_log_buffer buf(100);
+    EXPECT_EQ(128, buf.capacity());
+    EXPECT_EQ(56, buf.max_length());
+    const std::string too_long(57, 'x');
+    EXPECT_THROW(buf.write(too_long.data(), too_long.size()), std::length_error);
+
+    buf.write("hello", 5);
+    buf.write("", 0);
+    EXPECT_EQ(true, buf.try_write("world!!!", 8));
+    EXPECT_EQ((std::vector<std::string>{"hello", "", "world!!!"}), read_all(buf));
+    EXPECT_EQ(0, buf.used_bytes());
+    EXPECT_EQ(true, read_all(buf).empty());
+}
+
+TEST(MpscLogBufferTest, full) {
+    mpsc_log_buffer buf(64);
+    const char payload[24] = "abcdefghijklmnopqrstuvw";
+    EXPECT_EQ(true, buf.try_write(payload, 24));
+    EXPECT_EQ(true, buf.try_write(payload, 24));
+    EXPECT_EQ(false, buf.try_write(payload, 1));
+    EXPECT_EQ(1, buf.read([](const unsigned char*, std::size_t) {}, 1));
+    EXPECT_EQ(true, buf.try_write(payload, 24));
+    EXPECT_EQ(2, read_all(buf).size());
+}
+
+TEST(MpscLogBufferTest, wrap) {
+    // Records of varying length repeatedly run past the end of the ring.
+    mpsc_log_buffer buf(256);
+    std::string expected;
+    for (int i = 0; i < 1000; i++) {
+        const std::string record(static_cast<std::size_t>(i % 50), static_cast<char>('a' + i % 26));
+        if (i % 2 == 0) {
+            buf.write(record.data(), record.size());
+        } else {
+            ASSERT_EQ(true, buf.try_write(record.data(), record.size()));
+        }
+        std::vector<std::string> out = read_all(buf);
+        ASSERT_EQ(1, out.size());
+        ASSERT_EQ(record, out[0]);
+    }
+}
+
+TEST(MpscLogBufferTest, threaded) {
+    // Each producer's records must arrive intact and in order.
+    const int PRODUCERS = 4;
+    const std::uint32_t COUNT = 20000;
+    mpsc_log_buffer buf(4096);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&buf, p, COUNT]() {
+            std::uint32_t record[16];
+            for (std::uint32_t i = 0; i < COUNT; i++) {
+                const std::size_t words = 2 + i % 14;
+                for (std::size_t w = 0; w < words; w++) {
+                    record[w] = i;
+                }
+                record[0] = static_cast<std::uint32_t>(p);
+                if (p % 2 == 0) {
+                    buf.write(record, words * sizeof(std::uint32_t));
+                } else {
+                    while (!buf.try_write(record, words * sizeof(std::uint32_t))) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        });
+    }
+    std::vector<std::uint32_t> next(PRODUCERS, 0);
+    std::uint32_t total = 0;
+    while (total < PRODUCERS * COUNT) {
+        total += static_cast<std::uint32_t>(buf.read([&next](const unsigned char* data, std::size_t len) {
+            std::uint32_t record[16];
+            std::memcpy(record, data, len);
+            const std::uint32_t p = record[0];
+            const std::uint32_t i = next[p]++;
+            ASSERT_EQ((2 + i % 14) * sizeof(std::uint32_t), len);
+            for (std::size_t w = 1; w < len / sizeof(std::uint32_t); w++) {
+                ASSERT_EQ(i, record[w]);
+            }
+        }));
+    }
+    for (std::thread& t : producers) {
+        t.join();
+    }
+    for (int p = 0; p < PRODUCERS; p++) {
+        EXPECT_EQ(COUNT, next[p]);
+    }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,148 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "pipeline.h"
+#include "spsc_queue.h"
+#include "wait_strategy.h"
+
+TEST(SpscQueueTest, push_pop) {
+    spsc_queue<int, 4> queue;
+    EXPECT_EQ(3, queue.capacity());
+    EXPECT_EQ(true, queue.empty());
+    EXPECT_EQ(true, queue.try_push(1));
+    EXPECT_EQ(true, queue.try_push(2));
+    EXPECT_EQ(true, queue.try_push(3));
+    EXPECT_EQ(false, queue.try_push(4));
+    EXPECT_EQ(3, queue.size());
+    int item = 0;
+    EXPECT_EQ(true, queue.try_pop(item));
+    EXPECT_EQ(1, item);
+    EXPECT_EQ(true, queue.try_push(4));
+    for (int expected = 2; expected <= 4; expected++) {
+        EXPECT_EQ(true, queue.try_pop(item));
+        EXPECT_EQ(expected, item);
+    }
+    EXPECT_EQ(false, queue.try_pop(item));
+}
+
+TEST(SpscQueueTest, batch) {
+    spsc_queue<int, 8> queue;
+    int in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    int out[10] = {};
+    EXPECT_EQ(7, queue.push_batch(in, 10));
+    EXPECT_EQ(5, queue.pop_batch(out, 5));
+    EXPECT_EQ(3, queue.push_batch(in + 7, 3));
+    EXPECT_EQ(5, queue.pop_batch(out + 5, 10));
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(i, out[i]);
+    }
+    EXPECT_EQ(0, queue.pop_batch(out, 10));
+}
+
+TEST(SpscQueueTest, threaded) {
+    spsc_queue<std::uint64_t, 128> queue;
+    const std::uint64_t COUNT = 200000;
+    std::thread producer([&queue, COUNT]() {
+        std::uint64_t batch[16];
+        std::uint64_t next = 0;
+        while (next < COUNT) {
+            std::size_t n = 0;
+            for (; n < 16 && next + n < COUNT; n++) {
+                batch[n] = next + n;
+            }
+            std::size_t pushed = 0;
+            while ((pushed += queue.push_batch(batch + pushed, n - pushed)) < n) {
+                std::this_thread::yield();
+            }
+            next += n;
+        }
+    });
+    std::uint64_t expected = 0;
+    std::uint64_t item;
+    while (expected < COUNT) {
+        if (queue.try_pop(item)) {
+            ASSERT_EQ(expected, item);
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+}
+
+template <typename WAIT>
+static void blocking_transfer() {
+    spsc_queue<int, 8, WAIT> queue;
+    const int COUNT = 20000;
+    std::thread producer([&queue]() {
+        for (int i = 0; i < COUNT; i++) {
+            queue.push(i);
+        }
+    });
+    for (int i = 0; i < COUNT; i++) {
+        ASSERT_EQ(i, queue.pop());
+    }
+    producer.join();
+}
+
+TEST(SpscQueueTest, blocking) {
+    blocking_transfer<spin_then_yield<>>();
+    blocking_transfer<futex_park<>>();
+    blocking_transfer<futex_park<0>>();
+}
+
+TEST(SpscQueueTest, wait_cancelled) {
+    spsc_queue<int, 4, futex_park<>> queue;
+    std::atomic<bool> stop(false);
+    std::thread consumer([&queue, &stop]() {
+        EXPECT_EQ(false, queue.wait_not_empty([&stop]() { return stop.load(); }));
+    });
+    stop = true;
+    queue.wake();
+    consumer.join();
+}
+
+TEST(PipelineTest, stages) {
+    std::vector<std::string> output;
+    pipeline_options options;
+    options.cpus = {0};
+    auto p = make_pipeline<int, 16>(options,
+            [](int&& x) { return x * 2; },
+            [](int&& x) { return std::to_string(x); },
+            [&output](std::string&& s) { output.push_back(s); });
+    const int COUNT = 10000;
+    for (int i = 0; i < COUNT; i++) {
+        p->push(i);
+    }
+    p->finish();
+    ASSERT_EQ(COUNT, output.size());
+    for (int i = 0; i < COUNT; i++) {
+        ASSERT_EQ(std::to_string(i * 2), output[i]);
+    }
+    std::array<stage_stats, 3> stats = p->stats();
+    for (const stage_stats& s : stats) {
+        EXPECT_EQ(COUNT, s.processed);
+        EXPECT_EQ(0, s.queue_depth);
+        EXPECT_EQ(15, s.queue_capacity);
+    }
+}
+
+TEST(PipelineTest, parked) {
+    std::uint64_t sum = 0;
+    auto p = make_pipeline<int, 16, futex_park<>>(pipeline_options(),
+            [](int&& x) { return static_cast<std::uint64_t>(x); },
+            [&sum](std::uint64_t&& x) { sum += x; });
+    for (int i = 1; i <= 1000; i++) {
+        p->push(i);
+    }
+    p->finish();
+    EXPECT_EQ(500500, sum);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
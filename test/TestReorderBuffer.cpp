@@ -0,0 +1,109 @@
+#include <algorithm> // shuffle
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "reorder_buffer.h"
+
+typedef reorder_buffer<int, 100> buffer_type;
+
+static std::vector<std::uint32_t> release_all(buffer_type& buf) {
+    std::vector<std::uint32_t> out;
+    buf.release([&out](std::uint32_t seq, int&& item) {
+        EXPECT_EQ(static_cast<int>(seq), item);
+        out.push_back(seq);
+    });
+    return out;
+}
+
+TEST(ReorderBufferTest, insert) {
+    buffer_type buf(10);
+    EXPECT_EQ(reorder_result::accepted, buf.insert(11, 11));
+    EXPECT_EQ(reorder_result::duplicate, buf.insert(11, 11));
+    EXPECT_EQ(reorder_result::late, buf.insert(9, 9));
+    EXPECT_EQ(reorder_result::overflow, buf.insert(110, 110));
+    EXPECT_EQ(reorder_result::accepted, buf.insert(109, 109));
+    EXPECT_EQ(2, buf.pending());
+    EXPECT_EQ(true, release_all(buf).empty());
+
+    EXPECT_EQ(reorder_result::accepted, buf.insert(10, 10));
+    EXPECT_EQ((std::vector<std::uint32_t>{10, 11}), release_all(buf));
+    EXPECT_EQ(12, buf.next_sequence());
+    EXPECT_EQ(reorder_result::late, buf.insert(11, 11));
+}
+
+TEST(ReorderBufferTest, shuffled) {
+    // Release in order across many windows and the wrap of the slots.
+    buffer_type buf;
+    std::mt19937 rng(1);
+    std::vector<std::uint32_t> released;
+    for (std::uint32_t base = 0; base < 10000; base += 70) {
+        std::vector<std::uint32_t> seqs;
+        for (std::uint32_t s = base; s < base + 70; s++) {
+            seqs.push_back(s);
+        }
+        std::shuffle(seqs.begin(), seqs.end(), rng);
+        for (std::uint32_t s : seqs) {
+            ASSERT_EQ(reorder_result::accepted, buf.insert(s, static_cast<int>(s)));
+        }
+        std::vector<std::uint32_t> batch = release_all(buf);
+        released.insert(released.end(), batch.begin(), batch.end());
+    }
+    ASSERT_EQ(10010, released.size());
+    for (std::size_t i = 0; i < released.size(); i++) {
+        ASSERT_EQ(i, released[i]);
+    }
+    EXPECT_EQ(true, buf.empty());
+}
+
+TEST(ReorderBufferTest, sequence_wrap) {
+    reorder_buffer<int, 8, std::uint16_t> buf(65534);
+    std::vector<std::uint16_t> out;
+    EXPECT_EQ(reorder_result::accepted, buf.insert(1, 1));
+    EXPECT_EQ(reorder_result::accepted, buf.insert(65535, 0));
+    EXPECT_EQ(reorder_result::accepted, buf.insert(0, 0));
+    EXPECT_EQ(reorder_result::accepted, buf.insert(65534, 0));
+    EXPECT_EQ(4, buf.release([&out](std::uint16_t seq, int&&) { out.push_back(seq); }));
+    EXPECT_EQ((std::vector<std::uint16_t>{65534, 65535, 0, 1}), out);
+    EXPECT_EQ(reorder_result::late, buf.insert(65535, 0));
+}
+
+TEST(ReorderBufferTest, skip_to) {
+    buffer_type buf;
+    buf.insert(1, 1);
+    buf.insert(5, 5);
+    EXPECT_EQ(1, buf.skip_to(3));
+    EXPECT_EQ(2, buf.lost());
+    EXPECT_EQ(true, release_all(buf).empty());
+    buf.insert(3, 3);
+    EXPECT_EQ((std::vector<std::uint32_t>{3}), release_all(buf));
+    EXPECT_EQ(1, buf.skip_to(1000));
+    EXPECT_EQ(true, buf.empty());
+    EXPECT_EQ(reorder_result::accepted, buf.insert(1000, 1000));
+}
+
+TEST(ReorderBufferTest, release_expired) {
+    typedef buffer_type::clock clock;
+    const clock::time_point start = clock::now();
+    const std::chrono::milliseconds timeout(10);
+    buffer_type buf;
+    buf.insert(2, 2, start);
+    buf.insert(3, 3, start);
+    buf.insert(6, 6, start + std::chrono::milliseconds(5));
+
+    std::vector<std::uint32_t> out;
+    auto collect = [&out](std::uint32_t seq, int&&) { out.push_back(seq); };
+    EXPECT_EQ(0, buf.release_expired(start + std::chrono::milliseconds(9), timeout, collect));
+    EXPECT_EQ(2, buf.release_expired(start + std::chrono::milliseconds(10), timeout, collect));
+    EXPECT_EQ((std::vector<std::uint32_t>{2, 3}), out);
+    EXPECT_EQ(4, buf.next_sequence());
+    EXPECT_EQ(1, buf.release_expired(start + std::chrono::milliseconds(15), timeout, collect));
+    EXPECT_EQ(7, buf.next_sequence());
+    EXPECT_EQ(4, buf.lost());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,143 @@
+#include <cmath>
+#include <cstdint>
+#include <set>
+#include <string>
+#include "gtest/gtest.h"
+#include "reservoir_sampler.h"
+
+TEST(ReservoirSamplerTest, fill) {
+    reservoir_sampler<int, 8> sampler(1);
+    for (int i = 0; i < 5; i++) {
+        sampler.offer(i);
+    }
+    ASSERT_EQ(5, sampler.size());
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(i, sampler[i]);
+    }
+    for (int i = 5; i < 1000; i++) {
+        sampler.offer(i);
+    }
+    EXPECT_EQ(8, sampler.size());
+    EXPECT_EQ(1000, sampler.seen());
+    sampler.clear();
+    EXPECT_EQ(0, sampler.size());
+}
+
+TEST(ReservoirSamplerTest, uniform) {
+    // Every tenth of the stream should be sampled equally often.
+    const int TRIALS = 2000;
+    int tenths[10] = {};
+    for (int trial = 0; trial < TRIALS; trial++) {
+        reservoir_sampler<int, 10> sampler(trial);
+        for (int i = 0; i < 10000; i++) {
+            sampler.offer(i);
+        }
+        for (std::size_t i = 0; i < sampler.size(); i++) {
+            tenths[sampler[i] / 1000]++;
+        }
+    }
+    for (int count : tenths) {
+        EXPECT_NEAR(TRIALS, count, TRIALS * 0.1);
+    }
+}
+
+TEST(ReservoirSamplerTest, merge) {
+    // A quarter of the combined stream comes from the first sampler.
+    const int TRIALS = 1000;
+    int from_first = 0;
+    for (int trial = 0; trial < TRIALS; trial++) {
+        reservoir_sampler<int, 20> a(2 * trial);
+        reservoir_sampler<int, 20> b(2 * trial + 1);
+        for (int i = 0; i < 1000; i++) {
+            a.offer(i);
+        }
+        for (int i = 1000; i < 4000; i++) {
+            b.offer(i);
+        }
+        a.merge(b);
+        ASSERT_EQ(20, a.size());
+        ASSERT_EQ(4000, a.seen());
+        for (std::size_t i = 0; i < a.size(); i++) {
+            from_first += a[i] < 1000;
+        }
+        // The merged sampler carries on sampling the combined stream.
+        for (int i = 4000; i < 8000; i++) {
+            a.offer(i);
+        }
+    }
+    EXPECT_NEAR(0.25, from_first / (20.0 * TRIALS), 0.02);
+}
+
+TEST(ReservoirSamplerTest, merge_strings) {
+    // Items which survive the merge in place must keep their values.
+    for (int trial = 0; trial < 200; trial++) {
+        reservoir_sampler<std::string, 4> a(2 * trial);
+        reservoir_sampler<std::string, 4> b(2 * trial + 1);
+        for (int i = 0; i < 100; i++) {
+            a.offer("a" + std::to_string(i));
+            b.offer("b" + std::to_string(i));
+        }
+        a.merge(b);
+        ASSERT_EQ(4, a.size());
+        std::set<std::string> distinct;
+        for (std::size_t i = 0; i < a.size(); i++) {
+            ASSERT_EQ(false, a[i].empty());
+            distinct.insert(a[i]);
+        }
+        EXPECT_EQ(4, distinct.size());
+    }
+}
+
+TEST(ReservoirSamplerTest, weighted) {
+    // Odd items weigh three times as much as even ones.
+    const int TRIALS = 500;
+    int odd = 0;
+    int total = 0;
+    for (int trial = 0; trial < TRIALS; trial++) {
+        weighted_reservoir_sampler<int, 16> sampler(trial);
+        for (int i = 0; i < 10000; i++) {
+            sampler.offer(i, i % 2 ? 3.0 : 1.0);
+        }
+        ASSERT_EQ(16, sampler.size());
+        for (std::size_t i = 0; i < sampler.size(); i++) {
+            odd += sampler[i] % 2;
+        }
+        total += sampler.size();
+    }
+    EXPECT_NEAR(0.75, static_cast<double>(odd) / total, 0.03);
+}
+
+TEST(ReservoirSamplerTest, weighted_merge) {
+    weighted_reservoir_sampler<int, 4> a(1);
+    weighted_reservoir_sampler<int, 4> b(2);
+    for (int i = 0; i < 100; i++) {
+        a.offer(i, 1e-6);
+        b.offer(1000 + i, 1e6);
+    }
+    a.merge(b);
+    ASSERT_EQ(4, a.size());
+    EXPECT_EQ(200, a.seen());
+    for (std::size_t i = 0; i < a.size(); i++) {
+        EXPECT_LE(1000, a[i]);
+    }
+}
+
+TEST(ReservoirSamplerTest, decayed) {
+    // With a half-life of one time unit, the newest of many items is chosen
+    // about half the time.
+    const int TRIALS = 4000;
+    int newest = 0;
+    for (int trial = 0; trial < TRIALS; trial++) {
+        decayed_reservoir_sampler<int, 1> sampler(std::log(2.0), trial);
+        for (int t = 0; t < 1000; t++) {
+            sampler.offer(t, t);
+        }
+        newest += sampler[0] == 999;
+    }
+    EXPECT_NEAR(0.5, static_cast<double>(newest) / TRIALS, 0.03);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
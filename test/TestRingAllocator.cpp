@@ -0,0 +1,153 @@
+#include <cstdint>
+#include <cstdlib>   // rand
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <new>       // bad_alloc
+#include <utility>
+#include "gtest/gtest.h"
+#include "ring_allocator.h"
+#ifdef _COMMON_RING_ALLOCATOR_PMR
+#include <string>
+#include <vector>
+#endif
+
+TEST(RingAllocatorTest, fifo) {
+    ring_allocator ring(1024);
+    EXPECT_EQ(true, ring.empty());
+    void* a = ring.allocate(100);
+    void* b = ring.allocate(100);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(false, ring.empty());
+    std::memset(a, 0xAA, 100);
+    std::memset(b, 0xBB, 100);
+
+    // Freeing b first reclaims nothing as a is older.
+    const std::size_t used = ring.used_bytes();
+    ring.deallocate(b);
+    EXPECT_EQ(used, ring.used_bytes());
+    ring.deallocate(a);
+    EXPECT_EQ(true, ring.empty());
+}
+
+TEST(RingAllocatorTest, alignment) {
+    ring_allocator ring(4096);
+    for (std::size_t alignment = 1; alignment <= 256; alignment *= 2) {
+        void* p = ring.allocate(3, alignment);
+        EXPECT_EQ(0, reinterpret_cast<std::uintptr_t>(p) % alignment);
+    }
+}
+
+TEST(RingAllocatorTest, exhaustion) {
+    ring_allocator ring(256);
+    EXPECT_THROW(ring.allocate(1000), std::bad_alloc);
+    std::deque<void*> live;
+    void* p;
+    while ((p = ring.try_allocate(16)) != nullptr) {
+        live.push_back(p);
+    }
+    EXPECT_LT(0, live.size());
+    EXPECT_THROW(ring.allocate(16), std::bad_alloc);
+    ring.deallocate(live.front());
+    live.pop_front();
+    EXPECT_NE(nullptr, ring.try_allocate(16));
+}
+
+TEST(RingAllocatorTest, wrap) {
+    // Keep a sliding window of live chunks of varying sizes so allocations
+    // repeatedly wrap around the end of the region.
+    ring_allocator ring(2048);
+    std::deque<std::pair<unsigned char*, std::size_t>> live;
+    std::srand(1);
+    for (int i = 0; i < 20000; i++) {
+        const std::size_t size = 1 + std::rand() % 200;
+        unsigned char* p = static_cast<unsigned char*>(ring.try_allocate(size));
+        if (p == nullptr) {
+            ASSERT_EQ(false, live.empty());
+            // Free out of order occasionally.
+            if (live.size() > 1 && std::rand() % 4 == 0) {
+                ring.deallocate(live[1].first);
+                live.erase(live.begin() + 1);
+            } else {
+                ring.deallocate(live.front().first);
+                live.pop_front();
+            }
+            continue;
+        }
+        std::memset(p, static_cast<int>(size), size);
+        live.emplace_back(p, size);
+        for (const std::pair<unsigned char*, std::size_t>& chunk : live) {
+            ASSERT_EQ(static_cast<unsigned char>(chunk.second), chunk.first[0]);
+            ASSERT_EQ(static_cast<unsigned char>(chunk.second), chunk.first[chunk.second - 1]);
+        }
+    }
+    while (!live.empty()) {
+        ring.deallocate(live.back().first);
+        live.pop_back();
+    }
+    EXPECT_EQ(true, ring.empty());
+}
+
+TEST(RingAllocatorTest, oversized) {
+    const std::size_t max = std::numeric_limits<std::size_t>::max();
+    ring_allocator ring(256);
+    EXPECT_EQ(nullptr, ring.try_allocate(ring.capacity() + 1));
+    EXPECT_EQ(nullptr, ring.try_allocate(max));
+    EXPECT_EQ(nullptr, ring.try_allocate(max - 8));
+    EXPECT_EQ(nullptr, ring.try_allocate(max - 64));
+    EXPECT_EQ(nullptr, ring.try_allocate(16, static_cast<std::size_t>(1) << (sizeof(std::size_t) * 8 - 1)));
+    EXPECT_THROW(ring.allocate(max - 8), std::bad_alloc);
+    EXPECT_EQ(true, ring.empty());
+
+    // Still rejected once the head has moved away from the start.
+    void* p = ring.allocate(16);
+    EXPECT_EQ(nullptr, ring.try_allocate(max - 8));
+    EXPECT_EQ(nullptr, ring.try_allocate(ring.capacity()));
+    ring.deallocate(p);
+    EXPECT_EQ(true, ring.empty());
+}
+
+#ifdef _COMMON_RING_ALLOCATOR_PMR
+TEST(RingAllocatorTest, memoryResource) {
+    ring_memory_resource resource(4096);
+    {
+        std::pmr::vector<std::pmr::string> strings(&resource);
+        strings.reserve(20);
+        for (int i = 0; i < 20; i++) {
+            strings.emplace_back(std::string(40, static_cast<char>('a' + i)));
+        }
+        EXPECT_EQ(false, resource.allocator().empty());
+        for (int i = 0; i < 20; i++) {
+            EXPECT_EQ(std::string(40, static_cast<char>('a' + i)), strings[i].c_str());
+        }
+    }
+    EXPECT_EQ(true, resource.allocator().empty());
+
+    EXPECT_THROW(static_cast<void>(resource.allocate(8192)), std::bad_alloc);
+    void* p = resource.allocate(64, 64);
+    EXPECT_EQ(0, reinterpret_cast<std::uintptr_t>(p) % 64);
+    resource.deallocate(p, 64, 64);
+    EXPECT_EQ(true, resource.allocator().empty());
+
+    ring_memory_resource other(256);
+    EXPECT_EQ(true, resource.is_equal(resource));
+    EXPECT_EQ(false, resource.is_equal(other));
+}
+
+TEST(RingAllocatorTest, memoryResourceRegion) {
+    alignas(64) unsigned char region[1024];
+    ring_memory_resource resource(region, sizeof(region));
+    std::pmr::vector<int> values(&resource);
+    for (int i = 0; i < 50; i++) {
+        values.push_back(i);
+    }
+    EXPECT_GE(reinterpret_cast<unsigned char*>(values.data()), region);
+    EXPECT_LT(reinterpret_cast<unsigned char*>(values.data()), region + sizeof(region));
+    EXPECT_EQ(49, values.back());
+}
+#endif
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
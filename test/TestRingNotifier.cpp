@@ -0,0 +1,77 @@
+#include <poll.h>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "ring_notifier.h"
+
+static bool readable(int fd, int timeout_ms = 0) {
+    pollfd p = { fd, POLLIN, 0 };
+    return poll(&p, 1, timeout_ms) == 1 && (p.revents & POLLIN);
+}
+
+static void coalesces(bool use_pipe) {
+    notifying_spsc_queue<int, 256> queue(use_pipe);
+    EXPECT_EQ(false, readable(queue.fd()));
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(true, queue.try_push(i));
+        EXPECT_EQ(true, readable(queue.fd()));
+    }
+    std::vector<int> popped;
+    EXPECT_EQ(100u, queue.drain([&popped](int&& i) { popped.push_back(i); }));
+    EXPECT_EQ(false, readable(queue.fd()));
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(i, popped[i]);
+    }
+
+    // Re-armed, so the next push signals again.
+    EXPECT_EQ(true, queue.try_push(100));
+    EXPECT_EQ(true, readable(queue.fd()));
+}
+
+TEST(RingNotifierTest, eventfd) {
+    coalesces(false);
+}
+
+TEST(RingNotifierTest, pipe) {
+    coalesces(true);
+}
+
+TEST(RingNotifierTest, drain_limit) {
+    notifying_spsc_queue<int, 256> queue;
+    for (int i = 0; i < 200; i++) {
+        queue.try_push(i);
+    }
+    int next = 0;
+    auto check = [&next](int&& i) { EXPECT_EQ(next++, i); };
+    // Stopping early leaves the descriptor readable for the rest.
+    EXPECT_EQ(150u, queue.drain(check, 150));
+    EXPECT_EQ(true, readable(queue.fd()));
+    EXPECT_EQ(50u, queue.drain(check, 150));
+    EXPECT_EQ(false, readable(queue.fd()));
+    EXPECT_EQ(0u, queue.size());
+}
+
+TEST(RingNotifierTest, threaded) {
+    // The consumer only drains when the descriptor is readable, so a lost
+    // notification would hang it.
+    notifying_spsc_queue<int, 64> queue;
+    const int COUNT = 100000;
+    std::thread producer([&queue]() {
+        for (int i = 0; i < COUNT; i++) {
+            while (!queue.try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    int next = 0;
+    while (next < COUNT) {
+        ASSERT_EQ(true, readable(queue.fd(), 5000));
+        queue.drain([&next](int&& i) { ASSERT_EQ(next++, i); });
+    }
+    producer.join();
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
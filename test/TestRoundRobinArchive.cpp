@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include "gtest/gtest.h"
+#include "round_robin_archive.h"
+
+/** The i-th sample of a test series, rising and falling out of order. */
+static double sample(std::size_t i) {
+    return static_cast<double>((i * 7) % 11);
+}
+
+/** Consolidates the raw samples [start, end) as a bucket would. */
+static double consolidate(std::size_t start, std::size_t end, consolidation method) {
+    double value = sample(start);
+    for (std::size_t i = start + 1; i < end; i++) {
+        switch (method) {
+        case consolidation::average:
+            value += sample(i);
+            break;
+        case consolidation::min:
+            value = std::min(value, sample(i));
+            break;
+        case consolidation::max:
+            value = std::max(value, sample(i));
+            break;
+        case consolidation::last:
+            value = sample(i);
+            break;
+        }
+    }
+    return method == consolidation::average ? value / (end - start) : value;
+}
+
+/**
+ * Computes what a level should hold after n samples directly from the raw
+ * samples: the last SIZE complete buckets of the given resolution.
+ */
+static std::vector<double> expected_level(std::size_t n, std::size_t size, std::size_t resolution,
+                                          consolidation method) {
+    std::vector<double> out;
+    const std::size_t complete = n / resolution;
+    const std::size_t first = complete > size ? complete - size : 0;
+    for (std::size_t b = first; b < complete; b++) {
+        out.push_back(consolidate(b * resolution, (b + 1) * resolution, method));
+    }
+    return out;
+}
+
+static void check_consolidation(consolidation method) {
+    // Check every level after every sample, so each level's ring wraps at
+    // every offset and coarse buckets complete at every boundary.
+    round_robin_archive<double, 4, 3, 2> archive(method);
+    EXPECT_EQ(method, archive.method());
+    for (std::size_t n = 1; n <= 60; n++) {
+        archive.push(sample(n - 1));
+        ASSERT_EQ(n, archive.samples());
+        for (std::size_t level = 0; level < archive.LEVELS; level++) {
+            const std::vector<double> expected = expected_level(n, 4, archive.resolution(level), method);
+            const round_robin_archive<double, 4, 3, 2>::level_type& ring = archive.level(level);
+            ASSERT_EQ(expected.size(), ring.len()) << "level " << level << " after " << n;
+            for (std::size_t i = 0; i < expected.size(); i++) {
+                ASSERT_DOUBLE_EQ(expected[i], ring[i]) << "level " << level << " after " << n;
+            }
+        }
+    }
+}
+
+TEST(RoundRobinArchiveTest, resolutions) {
+    round_robin_archive<double, 4, 3, 2> archive;
+    EXPECT_EQ(3, archive.LEVELS);
+    EXPECT_EQ(1, archive.resolution(0));
+    EXPECT_EQ(3, archive.resolution(1));
+    EXPECT_EQ(6, archive.resolution(2));
+    EXPECT_EQ(consolidation::average, archive.method());
+
+    round_robin_archive<int, 3> raw;
+    EXPECT_EQ(1, raw.LEVELS);
+    for (int i = 0; i < 5; i++) {
+        raw.push(i);
+    }
+    ASSERT_EQ(3, raw.level(0).len());
+    EXPECT_EQ(2, raw.level(0)[0]);
+    EXPECT_EQ(4, raw.level(0)[2]);
+}
+
+TEST(RoundRobinArchiveTest, average) {
+    check_consolidation(consolidation::average);
+}
+
+TEST(RoundRobinArchiveTest, min) {
+    check_consolidation(consolidation::min);
+}
+
+TEST(RoundRobinArchiveTest, max) {
+    check_consolidation(consolidation::max);
+}
+
+TEST(RoundRobinArchiveTest, last) {
+    check_consolidation(consolidation::last);
+}
+
+TEST(RoundRobinArchiveTest, integer_average) {
+    // Averages of integer samples are truncated at each level.
+    round_robin_archive<int, 4, 2, 2> archive;
+    for (int i = 1; i <= 8; i++) {
+        archive.push(i);
+    }
+    ASSERT_EQ(4, archive.level(1).len());
+    EXPECT_EQ(1, archive.level(1)[0]);  // (1 + 2) / 2
+    EXPECT_EQ(7, archive.level(1)[3]);  // (7 + 8) / 2
+    ASSERT_EQ(2, archive.level(2).len());
+    EXPECT_EQ(2, archive.level(2)[0]);  // (1 + 3) / 2
+    EXPECT_EQ(6, archive.level(2)[1]);  // (5 + 7) / 2
+}
+
+TEST(RoundRobinArchiveTest, select_level) {
+    // Levels of 4 buckets cover 4, 12 and 24 raw samples.
+    round_robin_archive<double, 4, 3, 2> archive;
+    EXPECT_EQ(0, archive.select_level(0));
+    EXPECT_EQ(0, archive.select_level(1));
+    EXPECT_EQ(0, archive.select_level(4));
+    EXPECT_EQ(1, archive.select_level(5));
+    EXPECT_EQ(1, archive.select_level(12));
+    EXPECT_EQ(2, archive.select_level(13));
+    EXPECT_EQ(2, archive.select_level(24));
+    // Longer spans than any level covers use the coarsest.
+    EXPECT_EQ(2, archive.select_level(25));
+    EXPECT_EQ(2, archive.select_level(1000));
+}
+
+static void check_query(consolidation method) {
+    // Queries over rings which have wrapped at every offset visit the most
+    // recent buckets of the selected level, oldest first, then the bucket it
+    // is building, which covers the finer level's complete buckets since.
+    round_robin_archive<double, 4, 3, 2> archive(method);
+    for (std::size_t n = 1; n <= 60; n++) {
+        archive.push(sample(n - 1));
+        for (std::size_t span = 0; span <= 30; span++) {
+            std::vector<double> visited;
+            const std::size_t level = archive.query(span, [&visited](const double& bucket) {
+                visited.push_back(bucket);
+            });
+            ASSERT_EQ(archive.select_level(span), level);
+            const std::size_t resolution = archive.resolution(level);
+            std::vector<double> expected = expected_level(n, 4, resolution, method);
+            std::size_t buckets = (span + resolution - 1) / resolution;
+            const std::size_t start = n / resolution * resolution;
+            const std::size_t finer = level == 0 ? resolution : archive.resolution(level - 1);
+            const std::size_t end = n / finer * finer;
+            const bool partial = buckets > 0 && end > start;
+            if (partial) {
+                buckets--;
+            }
+            if (expected.size() > buckets) {
+                expected.erase(expected.begin(), expected.end() - buckets);
+            }
+            if (partial) {
+                expected.push_back(consolidate(start, end, method));
+            }
+            ASSERT_EQ(expected.size(), visited.size()) << "span " << span << " after " << n;
+            for (std::size_t i = 0; i < expected.size(); i++) {
+                ASSERT_DOUBLE_EQ(expected[i], visited[i]) << "span " << span << " after " << n;
+            }
+        }
+    }
+}
+
+TEST(RoundRobinArchiveTest, query) {
+    check_query(consolidation::average);
+    check_query(consolidation::min);
+    check_query(consolidation::max);
+    check_query(consolidation::last);
+}
+
+TEST(RoundRobinArchiveTest, query_short_history) {
+    // Fewer buckets are visited than the span needs until the level fills,
+    // and a coarse bucket still being built is visited last.
+    round_robin_archive<int, 4, 3> archive(consolidation::last);
+    for (int i = 0; i < 5; i++) {
+        archive.push(i);
+    }
+    std::vector<int> visited;
+    EXPECT_EQ(1, archive.query(12, [&visited](const int& bucket) {
+        visited.push_back(bucket);
+    }));
+    EXPECT_EQ((std::vector<int>{2, 4}), visited);
+
+    // The partial bucket counts toward the span.
+    visited.clear();
+    for (int i = 5; i < 16; i++) {
+        archive.push(i);
+    }
+    EXPECT_EQ(1, archive.query(6, [&visited](const int& bucket) {
+        visited.push_back(bucket);
+    }));
+    EXPECT_EQ((std::vector<int>{14, 15}), visited);
+
+    visited.clear();
+    round_robin_archive<int, 4, 3> empty;
+    EXPECT_EQ(0, empty.query(4, [&visited](const int& bucket) {
+        visited.push_back(bucket);
+    }));
+    EXPECT_EQ(true, visited.empty());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
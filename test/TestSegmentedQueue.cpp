@@ -0,0 +1,169 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+#include "segmented_queue.h"
+
+// Count every allocation, to check that the queue reuses its blocks.
+static std::atomic<std::size_t> allocations { 0 };
+
+void* operator new(std::size_t size) {
+    allocations++;
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+/** Counts how many instances are alive. */
+struct counted {
+    static int live;
+    int value;
+    counted(int value = 0) : value(value) {
+        live++;
+    }
+    counted(const counted& other) : value(other.value) {
+        live++;
+    }
+    counted& operator=(const counted& other) = default;
+    ~counted() {
+        live--;
+    }
+};
+
+int counted::live = 0;
+
+TEST(SegmentedQueueTest, push_pop) {
+    // Items cross several block boundaries.
+    segmented_queue<int, 4> queue;
+    EXPECT_EQ(true, queue.empty());
+    for (int i = 0; i < 10; i++) {
+        queue.push(i);
+        EXPECT_EQ(false, queue.empty());
+    }
+    int item = -1;
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(true, queue.try_pop(item));
+        EXPECT_EQ(i, item);
+    }
+    EXPECT_EQ(true, queue.empty());
+    EXPECT_EQ(false, queue.try_pop(item));
+}
+
+TEST(SegmentedQueueTest, block_boundary) {
+    // Drain a block exactly, before the producer has linked the next.
+    segmented_queue<int, 4> queue;
+    int item = -1;
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < 4; i++) {
+            queue.push(round * 4 + i);
+        }
+        for (int i = 0; i < 4; i++) {
+            EXPECT_EQ(true, queue.try_pop(item));
+            EXPECT_EQ(round * 4 + i, item);
+        }
+        EXPECT_EQ(true, queue.empty());
+        EXPECT_EQ(false, queue.try_pop(item));
+    }
+    queue.push(100);
+    EXPECT_EQ(false, queue.empty());
+    EXPECT_EQ(true, queue.try_pop(item));
+    EXPECT_EQ(100, item);
+}
+
+TEST(SegmentedQueueTest, emplace_move_only) {
+    segmented_queue<std::unique_ptr<std::string>, 2> queue;
+    queue.emplace(new std::string("a"));
+    queue.push(std::unique_ptr<std::string>(new std::string("b")));
+    queue.emplace(new std::string("c"));
+    std::unique_ptr<std::string> item;
+    for (const char* expected : {"a", "b", "c"}) {
+        EXPECT_EQ(true, queue.try_pop(item));
+        EXPECT_EQ(expected, *item);
+    }
+    EXPECT_EQ(false, queue.try_pop(item));
+}
+
+TEST(SegmentedQueueTest, reuse) {
+    // With a bounded backlog, drained blocks are reused rather than new
+    // ones allocated.
+    segmented_queue<int, 4> queue;
+    int next_push = 0;
+    int next_pop = 0;
+    int item;
+    const auto cycle = [&]() {
+        for (int i = 0; i < 7; i++) {
+            queue.push(next_push++);
+        }
+        while (next_pop < next_push) {
+            ASSERT_EQ(true, queue.try_pop(item));
+            ASSERT_EQ(next_pop++, item);
+        }
+    };
+    for (int i = 0; i < 10; i++) {
+        cycle();
+    }
+    const std::size_t before = allocations.load();
+    for (int i = 0; i < 1000; i++) {
+        cycle();
+    }
+    EXPECT_EQ(before, allocations.load());
+}
+
+TEST(SegmentedQueueTest, destroy_with_items) {
+    // Items left in the queue, across partly drained and full blocks, are
+    // destroyed with it.
+    {
+        segmented_queue<counted, 4> queue;
+        for (int i = 0; i < 11; i++) {
+            queue.emplace(i);
+        }
+        EXPECT_EQ(11, counted::live);
+        counted item;
+        for (int i = 0; i < 5; i++) {
+            EXPECT_EQ(true, queue.try_pop(item));
+            EXPECT_EQ(i, item.value);
+        }
+        EXPECT_EQ(7, counted::live);
+    }
+    EXPECT_EQ(0, counted::live);
+}
+
+TEST(SegmentedQueueTest, threaded) {
+    segmented_queue<std::uint64_t, 64> queue;
+    const std::uint64_t COUNT = 200000;
+    std::thread producer([&queue, COUNT]() {
+        for (std::uint64_t i = 0; i < COUNT; i++) {
+            queue.push(i);
+            if (i % 1000 == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    std::uint64_t expected = 0;
+    std::uint64_t item;
+    while (expected < COUNT) {
+        if (queue.try_pop(item)) {
+            ASSERT_EQ(expected, item);
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_EQ(true, queue.empty());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,105 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "SimpleSet.h"
+#include "tracking_allocator.h"
+
+TEST(SimpleSetTest, insert) {
+    SimpleSet<int> set;
+    EXPECT_EQ(true, set.empty());
+    set.insert(1);
+    set.insert(2);
+    set.insert(1);
+    EXPECT_EQ(2, set.size());
+    EXPECT_EQ(true, set.contains(1));
+    EXPECT_EQ(true, set.contains(2));
+    EXPECT_EQ(false, set.contains(3));
+}
+
+TEST(SimpleSetTest, range_construction) {
+    std::vector<uint32_t> input;
+    for (uint32_t i = 0; i < 300000; i++) {
+        input.push_back(i % 1000);
+    }
+
+    for (unsigned threads = 1; threads <= 4; threads++) {
+        SimpleSet<uint32_t> set(input.begin(), input.end(), threads);
+        EXPECT_EQ(1000, set.size());
+        std::vector<bool> seen(1000, false);
+        for (size_t i = 0; i < set.size(); i++) {
+            ASSERT_LT(set[i], 1000);
+            EXPECT_EQ(false, seen[set[i]]);
+            seen[set[i]] = true;
+        }
+    }
+
+    const std::vector<std::string> words {"a", "b", "a", "c", "b"};
+    SimpleSet<std::string> small(words.begin(), words.end());
+    EXPECT_EQ(3, small.size());
+    EXPECT_EQ(true, small.contains("c"));
+
+    SimpleSet<int> empty(input.end(), input.end());
+    EXPECT_EQ(true, empty.empty());
+}
+
+TEST(SimpleSetTest, const_iteration) {
+    SimpleSet<int> set;
+    for (int i = 0; i < 5; i++) {
+        set.insert(i);
+    }
+    const SimpleSet<int>& cset = set;
+
+    int sum = 0;
+    for (int i : cset) {
+        sum += i;
+    }
+    EXPECT_EQ(10, sum);
+    EXPECT_EQ(5, std::distance(set.begin(), set.end()));
+    EXPECT_EQ(5, std::distance(cset.cbegin(), cset.cend()));
+
+    const int* data = cset.data();
+    for (size_t i = 0; i < cset.size(); i++) {
+        EXPECT_EQ(&cset[i], data + i);
+    }
+
+    static_assert(std::is_same<const int&, decltype(*set.begin())>::value,
+                  "SimpleSet iterators must not permit modification");
+}
+
+struct test_ids {
+    static const char* name() { return "test ids"; }
+};
+
+TEST(SimpleSetTest, memory_usage) {
+    SimpleSet<int, tracking_allocator<int, test_ids>> set;
+    SimpleSet<int, tracking_allocator<int, test_ids>>::MemoryUsage usage = set.memory_usage();
+    EXPECT_EQ(0, usage.heap_bytes);
+    EXPECT_EQ(0.0, usage.overhead_per_element);
+
+    for (int i = 0; i < 5; i++) {
+        set.insert(i);
+    }
+    usage = set.memory_usage();
+    EXPECT_EQ(sizeof(set), usage.object_bytes);
+    EXPECT_EQ(5 * sizeof(int), usage.used_bytes);
+    EXPECT_EQ(usage.heap_bytes, usage.used_bytes + usage.slack_bytes);
+    EXPECT_LT(0.0, usage.overhead_per_element);
+
+    std::vector<tracking_snapshot> snapshot = tracking_registry::snapshot();
+    bool found = false;
+    for (const tracking_snapshot& entry : snapshot) {
+        if (std::string(entry.name) == "test ids") {
+            found = true;
+            EXPECT_EQ(usage.heap_bytes, entry.live_bytes);
+            EXPECT_EQ(1, entry.live_allocations);
+            EXPECT_LE(1, entry.total_allocations);
+        }
+    }
+    EXPECT_EQ(true, found);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
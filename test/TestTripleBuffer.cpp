@@ -0,0 +1,61 @@
+#include <atomic>
+#include <thread>
+#include "gtest/gtest.h"
+#include "triple_buffer.h"
+
+struct snapshot {
+    int sequence;
+    int values[16];
+};
+
+TEST(TripleBufferTest, latest) {
+    triple_buffer<int> buffer(-1);
+    EXPECT_EQ(false, buffer.has_update());
+    EXPECT_EQ(-1, buffer.read());
+
+    buffer.write(1);
+    buffer.write(2);
+    buffer.write(3);
+    EXPECT_EQ(true, buffer.has_update());
+    EXPECT_EQ(true, buffer.update());
+    EXPECT_EQ(3, buffer.read_buffer());
+    EXPECT_EQ(false, buffer.update());
+    EXPECT_EQ(3, buffer.read());
+
+    buffer.write_buffer() = 4;
+    EXPECT_EQ(false, buffer.has_update());
+    buffer.publish();
+    EXPECT_EQ(4, buffer.read());
+}
+
+TEST(TripleBufferTest, threaded) {
+    // Every snapshot read must be internally consistent and sequences must
+    // never go backwards.
+    triple_buffer<snapshot> buffer;
+    const int COUNT = 200000;
+    std::thread writer([&buffer]() {
+        for (int i = 1; i <= COUNT; i++) {
+            snapshot& s = buffer.write_buffer();
+            s.sequence = i;
+            for (int& v : s.values) {
+                v = i;
+            }
+            buffer.publish();
+        }
+    });
+    int last = 0;
+    while (last < COUNT) {
+        const snapshot& s = buffer.read();
+        ASSERT_LE(last, s.sequence);
+        for (int v : s.values) {
+            ASSERT_EQ(s.sequence, v);
+        }
+        last = s.sequence;
+    }
+    writer.join();
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
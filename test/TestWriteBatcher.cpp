@@ -0,0 +1,126 @@
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "write_batcher.h"
+
+class WriteBatcherTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(0, pipe(fds));
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    }
+
+    void TearDown() override {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    std::string drain() {
+        std::string result;
+        char chunk[4096];
+        ssize_t n;
+        while ((n = read(fds[0], chunk, sizeof(chunk))) > 0) {
+            result.append(chunk, n);
+        }
+        return result;
+    }
+
+    int fds[2];
+};
+
+TEST_F(WriteBatcherTest, message_threshold) {
+    write_batcher_options options;
+    options.max_messages = 10;
+    options.max_delay = std::chrono::seconds(10);
+    write_batcher<256> batcher(fds[1], options);
+    std::string expected;
+    for (int i = 0; i < 9; i++) {
+        const std::string message = "message " + std::to_string(i) + ";";
+        expected += message;
+        EXPECT_EQ(true, batcher.write(message.data(), message.size()));
+    }
+    EXPECT_EQ("", drain());
+    EXPECT_EQ(true, batcher.write("last", 4));
+    EXPECT_EQ(expected + "last", drain());
+    EXPECT_EQ(0u, batcher.pending_bytes());
+    EXPECT_EQ(10u, batcher.stats().messages);
+    EXPECT_EQ(1u, batcher.stats().syscalls);
+}
+
+TEST_F(WriteBatcherTest, byte_threshold_and_wrap) {
+    // Messages of 30 bytes flushed every 100 bytes wrap the 128 byte ring, so
+    // flushes must write both of its runs.
+    write_batcher_options options;
+    options.max_bytes = 100;
+    options.max_delay = std::chrono::seconds(10);
+    write_batcher<128> batcher(fds[1], options);
+    std::string expected;
+    std::string received;
+    for (int i = 0; i < 100; i++) {
+        const std::string message = std::string(29, static_cast<char>('a' + i % 26)) + "\n";
+        expected += message;
+        ASSERT_EQ(true, batcher.write(message.data(), message.size()));
+        received += drain();
+    }
+    EXPECT_EQ(true, batcher.flush());
+    received += drain();
+    EXPECT_EQ(expected, received);
+    EXPECT_EQ(25u, batcher.stats().syscalls);
+}
+
+TEST_F(WriteBatcherTest, deadline) {
+    write_batcher_options options;
+    options.max_delay = std::chrono::milliseconds(1);
+    write_batcher<256> batcher(fds[1], options);
+    EXPECT_EQ(write_batcher<256>::clock::time_point::max(), batcher.deadline());
+    EXPECT_EQ(true, batcher.write("abc", 3));
+    EXPECT_EQ(true, batcher.poll(batcher.deadline() - std::chrono::microseconds(1)));
+    EXPECT_EQ("", drain());
+    EXPECT_EQ(true, batcher.poll(batcher.deadline()));
+    EXPECT_EQ("abc", drain());
+
+    // A write after the deadline flushes itself.
+    EXPECT_EQ(true, batcher.write("def", 3));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    EXPECT_EQ(true, batcher.write("ghi", 3));
+    EXPECT_EQ("defghi", drain());
+}
+
+TEST_F(WriteBatcherTest, large_message) {
+    write_batcher_options options;
+    options.max_delay = std::chrono::seconds(10);
+    write_batcher<16> batcher(fds[1], options);
+    EXPECT_EQ(true, batcher.write("head", 4));
+    const std::string large(100, 'x');
+    EXPECT_EQ(true, batcher.write(large.data(), large.size()));
+    EXPECT_EQ("head" + large, drain());
+    EXPECT_EQ(2u, batcher.stats().messages);
+}
+
+TEST_F(WriteBatcherTest, would_block) {
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    write_batcher_options options;
+    options.max_messages = 1;
+    write_batcher<4096> batcher(fds[1], options);
+    // Fill the pipe until the batcher has to hold data back, then drain it
+    // and check nothing was lost or reordered.
+    std::string expected;
+    std::string received;
+    for (int i = 0; batcher.pending_bytes() == 0 && i < 100000; i++) {
+        const std::string message = std::to_string(i) + ",";
+        expected += message;
+        ASSERT_EQ(true, batcher.write(message.data(), message.size()));
+    }
+    EXPECT_NE(0u, batcher.pending_bytes());
+    received += drain();
+    EXPECT_EQ(true, batcher.flush());
+    received += drain();
+    EXPECT_EQ(expected, received);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}